@@ -13,6 +13,9 @@
 #include <unordered_set>
 #include <set>
 
+// Opaque meshes occlude exactly with their own triangles, small ones are cheap enough for the CPU rasterizer
+#define CACHE_OCCLUDER_MAX_TRIANGLES (4096)
+
 // Model cache header structures
 struct CachedMaterial
 {
@@ -648,7 +651,45 @@ std::shared_ptr<Prepath::Cubemap> loadSkybox(std::vector<std::string> faces)
     return Cubemap::generateTexture(data, width, height, nrChannels);
 }
 
-std::shared_ptr<Prepath::Texture> loadTexture(const std::string &path)
+// Import-time resolution tier and size cap applied by loadTexture, every combination gets its own cache entry
+Prepath::TextureQuality textureQuality = Prepath::TextureQuality::Full;
+unsigned int textureMaxDimension = 0; // 0 = unlimited
+
+bool readTextureCache(const std::string &binPath, int &width, int &height, std::vector<unsigned char> &data)
+{
+    std::ifstream binFile(binPath, std::ios::binary);
+    if (!binFile)
+        return false;
+
+    binFile.read(reinterpret_cast<char *>(&width), sizeof(int));
+    binFile.read(reinterpret_cast<char *>(&height), sizeof(int));
+
+    data.resize(width * height * 4);
+    binFile.read(reinterpret_cast<char *>(data.data()), data.size());
+    return bool(binFile);
+}
+
+void writeTextureCache(const std::string &binPath, int width, int height, const unsigned char *data)
+{
+    std::ofstream binFile(binPath, std::ios::binary);
+    if (binFile)
+    {
+        binFile.write(reinterpret_cast<const char *>(&width), sizeof(int));
+        binFile.write(reinterpret_cast<const char *>(&height), sizeof(int));
+        binFile.write(reinterpret_cast<const char *>(data), width * height * 4);
+        binFile.close();
+    }
+    else
+    {
+        PREPATH_LOG_WARN("Failed to write cached texture: {}", binPath.c_str());
+    }
+}
+
+// content picks the space the downscale filters in, maxDimension caps this texture on top of
+// textureMaxDimension (e.g. per material), 0 = global only
+std::shared_ptr<Prepath::Texture> loadTexture(const std::string &path,
+                                              Prepath::TextureContent content = Prepath::TextureContent::Data,
+                                              unsigned int maxDimension = 0)
 {
     using namespace Prepath;
     namespace fs = std::filesystem;
@@ -657,60 +698,134 @@ std::shared_ptr<Prepath::Texture> loadTexture(const std::string &path)
 
     PREPATH_LOG_INFO("Loading texture: {}", newPath.c_str());
 
+    if (textureMaxDimension > 0)
+        maxDimension = maxDimension > 0 ? std::min(maxDimension, textureMaxDimension) : textureMaxDimension;
+
+    // Full quality keeps the plain .bin so existing caches (and loadVirtualTexture) stay valid
     std::string binPath = newPath + ".bin";
+    std::string tierPath = binPath;
+    if (textureQuality != TextureQuality::Full || maxDimension > 0)
+        tierPath = newPath + std::format(".q{}_{}_{}.bin", int(textureQuality), maxDimension, int(content));
+
     int width = 0, height = 0;
+    std::vector<unsigned char> data;
 
     if (!fs::exists(newPath))
     {
         PREPATH_LOG_INFO("Texture doesnt exist: {}", newPath.c_str());
     }
 
-    // --- Try loading cached .bin ---
-    if (fs::exists(binPath))
+    // --- Try loading cached tier ---
+    if (fs::exists(tierPath))
     {
-        std::ifstream binFile(binPath, std::ios::binary);
-        if (!binFile)
-            PREPATH_LOG_FATAL("Failed to open cached texture: {}", binPath.c_str());
-
-        binFile.read(reinterpret_cast<char *>(&width), sizeof(int));
-        binFile.read(reinterpret_cast<char *>(&height), sizeof(int));
-
-        std::vector<unsigned char> data(width * height * 4);
-        binFile.read(reinterpret_cast<char *>(data.data()), data.size());
-        binFile.close();
+        if (!readTextureCache(tierPath, width, height, data))
+            PREPATH_LOG_FATAL("Failed to open cached texture: {}", tierPath.c_str());
 
         return Texture::generateTexture(data.data(), width, height, 4);
     }
 
-    // --- Decode original image ---
-    unsigned char *data = stbi_load(newPath.c_str(), &width, &height, nullptr, 4); // force RGBA
-    if (!data)
+    // --- Full resolution from the cache or the original image ---
+    if (!fs::exists(binPath) || !readTextureCache(binPath, width, height, data))
     {
-        PREPATH_LOG_FATAL("Failed to load texture: {}", newPath.c_str());
-        unsigned char fallback[4] = {255, 0, 255, 255};
-        return Texture::generateTexture(fallback, 1, 1, 4);
+        unsigned char *decoded = stbi_load(newPath.c_str(), &width, &height, nullptr, 4); // force RGBA
+        if (!decoded)
+        {
+            PREPATH_LOG_FATAL("Failed to load texture: {}", newPath.c_str());
+            unsigned char fallback[4] = {255, 0, 255, 255};
+            return Texture::generateTexture(fallback, 1, 1, 4);
+        }
+        data.assign(decoded, decoded + width * height * 4);
+        stbi_image_free(decoded);
     }
 
-    auto tex = Texture::generateTexture(data, width, height, 4);
-
-    // --- Write cache .bin ---
-    std::ofstream binFile(binPath, std::ios::binary);
-    if (binFile)
+    // --- Downscale to the tier ---
+    unsigned int tierWidth = 0, tierHeight = 0;
+    Texture::getQualitySize(width, height, textureQuality, maxDimension, tierWidth, tierHeight);
+    if (tierWidth != unsigned(width) || tierHeight != unsigned(height))
     {
-        binFile.write(reinterpret_cast<const char *>(&width), sizeof(int));
-        binFile.write(reinterpret_cast<const char *>(&height), sizeof(int));
-        binFile.write(reinterpret_cast<const char *>(data), width * height * 4);
-        binFile.close();
+        PREPATH_LOG_INFO("Downscaling texture {}x{} -> {}x{}", width, height, tierWidth, tierHeight);
+        data = Texture::resize(data.data(), width, height, 4, tierWidth, tierHeight, content);
+        width = int(tierWidth);
+        height = int(tierHeight);
     }
-    else
+
+    auto tex = Texture::generateTexture(data.data(), width, height, 4);
+
+    // --- Write cache .bin ---
+    writeTextureCache(tierPath, width, height, data.data());
+    return tex;
+}
+
+// Streams the texture through the virtual texture cache, building a tiled page file next to the source
+std::shared_ptr<Prepath::Texture> loadVirtualTexture(const std::string &path,
+                                                     Prepath::TextureContent content = Prepath::TextureContent::Data)
+{
+    using namespace Prepath;
+    namespace fs = std::filesystem;
+
+    std::string pagePath = path + ".vtpages";
+
+    if (!fs::exists(pagePath))
     {
-        PREPATH_LOG_WARN("Failed to write cached texture: {}", binPath.c_str());
+        PREPATH_LOG_INFO("Building virtual texture pages: {}", pagePath.c_str());
+
+        int width = 0, height = 0;
+        std::vector<unsigned char> data;
+        std::string binPath = path + ".bin";
+        if (fs::exists(binPath))
+        {
+            std::ifstream binFile(binPath, std::ios::binary);
+            binFile.read(reinterpret_cast<char *>(&width), sizeof(int));
+            binFile.read(reinterpret_cast<char *>(&height), sizeof(int));
+            data.resize(width * height * 4);
+            binFile.read(reinterpret_cast<char *>(data.data()), data.size());
+        }
+        else
+        {
+            unsigned char *decoded = stbi_load(path.c_str(), &width, &height, nullptr, 4); // force RGBA
+            if (!decoded)
+            {
+                PREPATH_LOG_FATAL("Failed to load texture: {}", path.c_str());
+                return loadTexture(path, content);
+            }
+            data.assign(decoded, decoded + width * height * 4);
+            stbi_image_free(decoded);
+        }
+
+        if (!VirtualTexture::writePageFile(pagePath, data.data(), width, height))
+            return loadTexture(path, content);
     }
 
-    stbi_image_free(data);
+    auto tex = Texture::generateVirtualTexture(pagePath);
+    if (!tex)
+        return loadTexture(path, content);
     return tex;
 }
 
+// Set before loading models to stream their textures instead of uploading them whole
+bool useVirtualTextures = false;
+
+std::shared_ptr<Prepath::Texture> loadModelTexture(const std::string &path, Prepath::TextureContent content)
+{
+    return useVirtualTextures ? loadVirtualTexture(path, content) : loadTexture(path, content);
+}
+
+// Role of each texture in the model's materials, everything not listed is plain data
+std::unordered_map<std::string, Prepath::TextureContent> getTextureContents(const std::vector<CachedMaterial> &materials)
+{
+    std::unordered_map<std::string, Prepath::TextureContent> contents;
+    for (const auto &material : materials)
+    {
+        if (!material.albedoPath.empty())
+            contents[material.albedoPath] = Prepath::TextureContent::Color;
+        if (!material.emissivePath.empty())
+            contents[material.emissivePath] = Prepath::TextureContent::Color;
+        if (!material.normalPath.empty())
+            contents[material.normalPath] = Prepath::TextureContent::Normal;
+    }
+    return contents;
+}
+
 // VERY SKETCHY METHODS
 
 struct MeshData
@@ -837,9 +952,10 @@ std::pair<std::vector<std::shared_ptr<Prepath::Mesh>>, std::vector<std::shared_p
             // Preload ALL textures (not just used ones)
             PREPATH_LOG_INFO("Preloading {} textures", cachedData.allTexturePaths.size());
             std::unordered_map<std::string, std::shared_ptr<Texture>> textureCache;
+            auto textureContents = getTextureContents(cachedData.materials);
             for (const auto &texPath : cachedData.allTexturePaths)
             {
-                textureCache[texPath] = loadTexture(texPath);
+                textureCache[texPath] = loadModelTexture(texPath, textureContents[texPath]);
             }
 
             // Create materials
@@ -881,6 +997,8 @@ std::pair<std::vector<std::shared_ptr<Prepath::Mesh>>, std::vector<std::shared_p
 
                 if (cachedMesh.materialIndex < materials.size())
                     mesh->material = materials[cachedMesh.materialIndex];
+                if (cachedMesh.positions.size() / 3 <= CACHE_OCCLUDER_MAX_TRIANGLES)
+                    mesh->occluderTriangles = cachedMesh.positions;
 
                 meshes.push_back(mesh);
             }
@@ -942,13 +1060,6 @@ std::pair<std::vector<std::shared_ptr<Prepath::Mesh>>, std::vector<std::shared_p
     }
     PREPATH_LOG_INFO("Found {} lights in model", cachedData.lights.size());
 
-    // Preload all textures
-    std::unordered_map<std::string, std::shared_ptr<Texture>> textureCache;
-    for (const auto &texPath : cachedData.allTexturePaths)
-    {
-        textureCache[texPath] = loadTexture(texPath);
-    }
-
     // Process materials
     std::unordered_map<aiMaterial *, uint32_t> materialIndexMap;
     for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
@@ -958,6 +1069,14 @@ std::pair<std::vector<std::shared_ptr<Prepath::Mesh>>, std::vector<std::shared_p
         cachedData.materials.push_back(createCachedMaterial(aiMat, modelDir));
     }
 
+    // Preload all textures, after the materials so each one knows its role
+    std::unordered_map<std::string, std::shared_ptr<Texture>> textureCache;
+    auto textureContents = getTextureContents(cachedData.materials);
+    for (const auto &texPath : cachedData.allTexturePaths)
+    {
+        textureCache[texPath] = loadModelTexture(texPath, textureContents[texPath]);
+    }
+
     // Process meshes (using your existing logic)
     std::unordered_map<aiMaterial *, MeshData> groupedMeshes;
     processNode(scene->mRootNode, scene, glm::mat4(1.0f), groupedMeshes);
@@ -999,6 +1118,8 @@ std::pair<std::vector<std::shared_ptr<Prepath::Mesh>>, std::vector<std::shared_p
             &meshData.bitangents);
 
         mesh->material = materials[cachedMesh.materialIndex];
+        if (meshData.positions.size() / 3 <= CACHE_OCCLUDER_MAX_TRIANGLES)
+            mesh->occluderTriangles = meshData.positions;
         meshes.push_back(mesh);
     }
 
@@ -84,6 +84,7 @@ void processInput(Prepath::RenderSettings &settings, float deltaTime)
         settings.cam.Pitch = -89.0f;
 
     settings.cam.updateCameraVectors();
+    int previewCascade = 0;
 }
 
 #define DEMO_IMPORT_SPONZA          // Sponza
@@ -95,6 +96,8 @@ void processInput(Prepath::RenderSettings &settings, float deltaTime)
 // #define DEMO_IMPORT_DRAGON // Dragon
 // #define DEMO_IMPORT_GALLERY // Gallery
 #define DEMO_ENABLE_GIZMOS // Gizmos
+#define DEMO_INSTANCES     // Ring of instanced spheres submitted every frame
+// #define DEMO_VIRTUAL_TEXTURES // Stream model textures through the virtual texture cache
 
 void printExtension(const std::string &name, int indent = 1)
 {
@@ -132,6 +135,12 @@ void printExtensions()
 #ifdef DEMO_ENABLE_GIZMOS
     printExtension("Gizmos", 1);
 #endif
+#ifdef DEMO_INSTANCES
+    printExtension("Instances", 1);
+#endif
+#ifdef DEMO_VIRTUAL_TEXTURES
+    printExtension("Virtual Textures", 1);
+#endif
 }
 
 #define VECTOR_APPEND(dst, src) ((dst).insert((dst).end(), (src).begin(), (src).end()))
@@ -170,6 +179,7 @@ int main()
     ctx.setLogger(Prepath::LogLevel::Fatal, [](const std::string &msg)
                   { spdlog::critical("{}", msg); });
     ctx.setShaderPath("shader");
+    ctx.setCachePath("cache");
 
 #ifdef _WIN32
     ImFont *font = io.Fonts->AddFontFromFileTTF("C:/Windows/Fonts/SegoeUI.ttf", 18.0f);
@@ -191,13 +201,27 @@ int main()
     scene.skybox = loadSkybox(faces);*/
     auto settings = Prepath::RenderSettings();
     settings.culling = false;
+    // Renderer paths that default to off are turned on here on purpose, the demo is where they get exercised
+    settings.occlusionCulling = true;
+    settings.clusteredLighting = true;
+    settings.multiDrawIndirect = true;
+    settings.depthPrepass = Prepath::DepthPrepassMode::Auto;
+    settings.gpuTiming = true;
     settings.cam.Position = glm::vec3(0, 1.5f, 4.0f);
     settings.cam.updateCameraVectors();
 
 #ifdef DEMO_ENABLE_GIZMOS
-    auto light_gizmo = loadTexture("textures/gizmo_lightbulb.png");
+    auto light_gizmo = loadTexture("textures/gizmo_lightbulb.png", Prepath::TextureContent::Color);
+#endif
+
+#ifdef DEMO_VIRTUAL_TEXTURES
+    useVirtualTextures = true;
 #endif
 
+    // Half/Quarter cut load time and VRAM 4-16x, loadTexture(path, content, maxDimension) caps single materials
+    textureQuality = Prepath::TextureQuality::Full;
+    textureMaxDimension = 0;
+
 #ifdef DEMO_IMPORT_SPONZA
     bool showSponza = true;
     auto [sponza_meshes, sponza_lights] = loadModelWithCache("models/NewSponza_Main_glTF_003.gltf");
@@ -285,8 +309,8 @@ int main()
 #ifdef DEMO_IMPORT_DRAGON
     bool showDragon = true;
     auto dragon_mat = Prepath::Material::generateMaterial();
-    dragon_mat->albedo = loadTexture("models/textures/marble_0017_color_2k.jpg");
-    dragon_mat->normal = loadTexture("models/textures/marble_0017_normal_opengl_2k.png");
+    dragon_mat->albedo = loadTexture("models/textures/marble_0017_color_2k.jpg", Prepath::TextureContent::Color);
+    dragon_mat->normal = loadTexture("models/textures/marble_0017_normal_opengl_2k.png", Prepath::TextureContent::Normal);
     dragon_mat->roughness = loadTexture("models/textures/marble_0017_roughness_2k.jpg");
     dragon_mat->ao = loadTexture("models/textures/marble_0017_ao_2k.jpg");
     dragon_mat->tint = glm::vec3(152.0f / 255.0f, 241.0f / 255.0f, 115.0f / 255.0f);
@@ -301,6 +325,16 @@ int main()
     }
 #endif
 
+#ifdef DEMO_INSTANCES
+    bool showInstances = true;
+    bool animateInstances = true;
+    float instanceAngle = 0.0f;
+    auto instance_mesh = Prepath::Mesh::generateSphere(0.25f);
+    auto instance_mat = Prepath::Material::generateMaterial();
+    instance_mat->tint = glm::vec3(0.9f, 0.6f, 0.2f);
+    std::vector<glm::mat4> instanceTransforms(64);
+#endif
+
     scene.lightDir = glm::vec3(0.1f, 0.8f, 0.3f);
 
     // ---- RUNTIME CODE ----
@@ -328,7 +362,7 @@ int main()
         ImGui::Begin("Debug");
         ImGui::SeparatorText("Statistics");
         auto stats = renderer.getStatistics();
-        ImGui::Text("Draw Calls: %d", stats.drawCallCount);
+        ImGui::Text("Draw Calls: %d (%d submitted)", stats.drawCallCount, stats.submitCalls);
         {
             std::stringstream ss;
             ss.imbue(std::locale(""));
@@ -341,19 +375,93 @@ int main()
             ss << stats.vertexCount;
             ImGui::Text("Vertices: %s", ss.str().c_str());
         }
+        if (stats.virtualPagesResident > 0)
+        {
+            ImGui::Text("Virtual Pages: %d resident, %d pending, %d uploaded",
+                        stats.virtualPagesResident, stats.virtualPagesPending, stats.virtualPagesUploaded);
+        }
+        ImGui::Text("State Changes: %d (%d avoided), %d object block binds", stats.stateChanges, stats.stateChangesAvoided, stats.uniformBlockBinds);
+        ImGui::Text("GL State Calls: %d issued, %d elided", stats.stateCallsIssued, stats.stateCallsElided);
+        ImGui::Text("Shader Variants: %d (%d compiling)", stats.shaderVariants, stats.shadersCompiling);
+        ImGui::Text("Meshes: %d visible, %d culled (shadow: %d visible, %d culled)",
+                    stats.visibleMeshes, stats.culledMeshes, stats.shadowVisibleMeshes, stats.shadowCulledMeshes);
+        ImGui::Text("Instances: %d visible, %d culled", stats.visibleInstances, stats.culledInstances);
+        ImGui::Text("Occlusion: %d occluded by %d occluders (%d triangles)", stats.occludedMeshes, stats.occluders, stats.occluderTriangles);
+        ImGui::Text("Occlusion Queries: %d occluded, %d issued, %d pending", stats.queryOccludedMeshes, stats.occlusionQueries, stats.occlusionQueriesPending);
+        ImGui::Text("Overdraw: %.2f (depth pre-pass %s)", stats.overdraw, stats.depthPrepass ? "on" : "off");
+        ImGui::Text("Shadow Maps: %d refreshed, %d reused, %d deferred", stats.shadowMapsRefreshed, stats.shadowMapsReused, stats.shadowMapsDeferred);
+        ImGui::Text("Shadow Atlas: %dx%d, %d faces, %d skipped, %d lights dropped",
+                    stats.shadowAtlasSize, stats.shadowAtlasSize, stats.shadowAtlasFaces, stats.shadowAtlasSkippedFaces, stats.shadowAtlasDroppedLights);
+        {
+            const char *pathNames[] = {"Auto", "Geometry Shader", "Vertex Layer", "Single Face"};
+            ImGui::Text("Point Shadow Path: %s", pathNames[int(stats.pointShadowPath)]);
+            ImGui::Text("Dual-Paraboloid Lights: %d", stats.shadowAtlasParaboloidLights);
+        }
+        if (!stats.pointLights.empty() && ImGui::TreeNode("Point Light Shadows"))
+        {
+            for (size_t i = 0; i < stats.pointLights.size(); ++i)
+            {
+                const auto &light = stats.pointLights[i];
+                ImGui::Text("Light %d: %d draws, %d triangles, %d culled", int(i), light.drawCallCount, light.triangleCount, light.culledMeshes);
+            }
+            ImGui::TreePop();
+        }
+        if (settings.clusteredLighting)
+        {
+            ImGui::Text("Light Clusters: %d lights, %d references, max %d per cluster",
+                        stats.clusterLights, stats.clusterLightIndices, stats.clusterMaxLights);
+        }
+        if (settings.deferredShading)
+            ImGui::Text("Light Volumes: %d", stats.lightVolumes);
         ImGui::Text("Delta Time: %.3f ms", deltaTime);
+        if (settings.gpuTiming && ImGui::TreeNode("GPU Timings"))
+        {
+            for (const auto &timing : renderer.getGPUTimings())
+            {
+                ImGui::Text("%*s%s: %.3f ms (avg %.3f, p50 %.3f, p95 %.3f, p99 %.3f)", timing.depth * 2, "", timing.name.c_str(),
+                            timing.lastMs, timing.averageMs, timing.p50Ms, timing.p95Ms, timing.p99Ms);
+            }
+            ImGui::Checkbox("Per-Draw Timing", &settings.perDrawTiming);
+            if (settings.perDrawTiming)
+            {
+                for (const auto &draw : renderer.getDrawTimings())
+                    ImGui::Text("%p: %.3f ms, %d triangles", (const void *)draw.mesh, draw.averageMs, draw.triangles);
+            }
+            ImGui::TreePop();
+        }
         ImGui::SeparatorText("Settings");
         ImGui::Checkbox("Display Wireframe", &settings.wireframe);
         ImGui::Checkbox("Display Bounds", &settings.bounds);
         ImGui::DragInt("Display Textures", &settings.showTexture, 0.1f, 0);
         ImGui::Checkbox("Culling", &settings.culling);
+        ImGui::Checkbox("Frustum Culling", &settings.frustumCulling);
+        ImGui::Checkbox("Occlusion Culling", &settings.occlusionCulling);
+        const char *queryModes[] = {"Off", "Last Frame", "Conditional"};
+        int queryMode = int(settings.occlusionQueries);
+        if (ImGui::Combo("Occlusion Queries", &queryMode, queryModes, IM_ARRAYSIZE(queryModes)))
+            settings.occlusionQueries = Prepath::OcclusionQueryMode(queryMode);
+        ImGui::Checkbox("Shadow Caching", &settings.shadowCaching);
+        ImGui::Checkbox("Multi-Draw Indirect", &settings.multiDrawIndirect);
+        ImGui::Checkbox("GPU Timing", &settings.gpuTiming);
+        const char *prepassModes[] = {"Off", "On", "Auto"};
+        int prepassMode = int(settings.depthPrepass);
+        if (ImGui::Combo("Depth Pre-Pass", &prepassMode, prepassModes, IM_ARRAYSIZE(prepassModes)))
+            settings.depthPrepass = Prepath::DepthPrepassMode(prepassMode);
+        ImGui::SliderInt("Shadow Update Budget", &settings.shadowUpdateBudget, 1, 32);
         ImGui::SeparatorText("Camera");
         ImGui::SliderFloat("Speed", &cameraController.moveSpeed, 10.0f, 50.0f);
         ImGui::Text("Yaw: %.1f, Pitch: %.1f", settings.cam.Yaw, settings.cam.Pitch);
         ImGui::Text("Position: %.1f, %.1f, %.1f", settings.cam.Position.x, settings.cam.Position.y, settings.cam.Position.z);
         ImGui::SeparatorText("Scene");
         ImGui::Checkbox("Has Skylight", &scene.hasSkyLight);
+        ImGui::Checkbox("Image Based Lighting", &settings.imageBasedLighting);
+        ImGui::Checkbox("Clustered Point Lights", &settings.clusteredLighting);
+        ImGui::Checkbox("Deferred Shading", &settings.deferredShading);
         ImGui::Text("Lights: %d", scene.getPointLights().size());
+#ifdef DEMO_INSTANCES
+        ImGui::Checkbox("Show Instances", &showInstances);
+        ImGui::Checkbox("Animate Instances", &animateInstances);
+#endif
 #ifdef DEMO_IMPORT_SPONZA
         if (ImGui::Checkbox("Show Sponza", &showSponza))
         {
@@ -498,8 +606,6 @@ int main()
                 ImGui::DragFloat("Intensity", &light->intensity, 0.3f, 1.0f);
                 ImGui::DragFloat("Range", &light->range, 0.3f, 1.0f);
 
-                ImGui::Image(light->copyCubemapFaceToTexture(PREPATH_CUBEMAP_POSX), {128, 128});
-
                 ImGui::TreePop();
             }
             if (light->hidden)
@@ -510,7 +616,26 @@ int main()
         }
         ImGui::SeparatorText("Shadows");
         ImGui::DragFloat3("Light Direction", glm::value_ptr(scene.lightDir), 0.1f, -1.0f, 1.0f);
-        ImGui::Image(renderer.getDepthTex(), ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::DragFloat("Shadow Distance", &settings.shadowDistance, 1.0f, 10.0f, 512.0f);
+        ImGui::SliderInt("Cascade", &previewCascade, 0, PREPATH_CSM_CASCADES - 1);
+        ImGui::Image(renderer.copyCascadeToTexture(previewCascade), ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::Checkbox("Point Light Shadows", &settings.pointShadows);
+        const char *shadowPaths[] = {"Auto", "Geometry Shader", "Vertex Layer", "Single Face"};
+        int shadowPath = int(settings.pointShadowPath);
+        if (ImGui::Combo("Point Shadow Path", &shadowPath, shadowPaths, IM_ARRAYSIZE(shadowPaths)))
+            settings.pointShadowPath = Prepath::PointShadowPath(shadowPath);
+        const char *depthFormats[] = {"16 Bit", "24 Bit"};
+        int depthFormat = int(settings.pointShadowFormat);
+        if (ImGui::Combo("Atlas Depth", &depthFormat, depthFormats, IM_ARRAYSIZE(depthFormats)))
+            settings.pointShadowFormat = Prepath::ShadowDepthFormat(depthFormat);
+        ImGui::SliderInt("Atlas Budget (MB)", &settings.pointShadowBudget, 2, 256);
+        const char *shadowModes[] = {"Cube", "Dual Paraboloid", "Auto"};
+        int shadowMode = int(settings.pointShadowMode);
+        if (ImGui::Combo("Point Shadow Mode", &shadowMode, shadowModes, IM_ARRAYSIZE(shadowModes)))
+            settings.pointShadowMode = Prepath::PointShadowMode(shadowMode);
+        if (settings.pointShadowMode == Prepath::PointShadowMode::Auto)
+            ImGui::SliderFloat("Paraboloid Below", &settings.paraboloidImportance, 0.0f, 1.0f);
+        ImGui::Image(renderer.getPointShadowAtlas(), ImVec2(256, 256), ImVec2(0, 1), ImVec2(1, 0));
 
 #ifdef DEMO_ENABLE_GIZMOS
         ImGui::SeparatorText("Gizmos");
@@ -521,16 +646,34 @@ int main()
         ImGui::Render();
 
         // ---- Render Code ----
+#ifdef DEMO_INSTANCES
+        // Instances are not part of the scene, they have to be submitted again before every render()
+        if (showInstances)
+        {
+            if (animateInstances)
+                instanceAngle += deltaTime * 0.25f;
+            for (size_t i = 0; i < instanceTransforms.size(); ++i)
+            {
+                float angle = instanceAngle + glm::two_pi<float>() * float(i) / float(instanceTransforms.size());
+                glm::vec3 position(std::cos(angle) * 6.0f, 1.0f + 0.5f * std::sin(angle * 3.0f), std::sin(angle) * 6.0f);
+                instanceTransforms[i] = glm::translate(glm::mat4(1.0f), position);
+            }
+            renderer.submitInstanced(instance_mesh, instance_mat, instanceTransforms);
+        }
+#endif
         renderer.render(scene, settings);
 #ifdef DEMO_ENABLE_GIZMOS
+        std::vector<glm::vec3> gizmoPositions, gizmoTints;
         for (auto light : scene.getPointLights())
         {
             if (!light->hidden)
             {
-                renderer.renderGizmo(light_gizmo, light->position, light->color);
+                gizmoPositions.push_back(light->position);
+                gizmoTints.push_back(light->color);
                 // renderer.renderGizmoSphere(light->position, light->range, light->color);
             }
         }
+        renderer.renderGizmos(light_gizmo, gizmoPositions, gizmoTints);
 #endif
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -538,6 +681,7 @@ int main()
     }
 
     // ---- SHUTDOWN CODE ----
+    Prepath::Context::getGlobalContext().shutdown();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -1,5 +1,6 @@
 #include "Context.h"
 #include "Error.h"
+#include "VirtualTexture.h"
 #include <glad/glad.h>
 
 namespace Prepath
@@ -10,6 +11,11 @@ namespace Prepath
         return instance;
     }
 
+    void Context::shutdown()
+    {
+        VirtualTextureCache::getGlobalCache().release();
+    }
+
     Context::Context()
     {
         m_Loggers[LogLevel::Info] = [](const std::string &msg)
@@ -33,4 +39,43 @@ namespace Prepath
             m_Loggers[level](msg);
         }
     };
+
+    std::string Context::readShader(const std::string &inputName, std::unordered_set<std::string> &included)
+    {
+        std::string filePath = getShaderPath(inputName);
+        std::ifstream file(filePath, std::ios::in | std::ios::binary);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open shader file: " + filePath);
+        }
+        included.insert(inputName);
+
+        std::ostringstream contents;
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                contents << line << "\n";
+                continue;
+            }
+
+            size_t open = line.find('"', start);
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                throw std::runtime_error("Malformed include in shader file: " + filePath);
+            }
+
+            std::string includeName = line.substr(open + 1, close - open - 1);
+            if (!included.contains(includeName))
+                contents << "#line 1\n" << readShader(includeName, included);
+            // Keep compiler errors pointing at the right line of this file
+            contents << "#line " << lineNumber + 1 << "\n";
+        }
+        return contents.str();
+    }
 }
\ No newline at end of file
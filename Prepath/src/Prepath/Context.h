@@ -7,6 +7,8 @@
 #include <filesystem>
 #include <fstream>
 #include <format>
+#include <sstream>
+#include <unordered_set>
 
 namespace Prepath
 {
@@ -26,6 +28,8 @@ namespace Prepath
     public:
         // ---- Context Methods ----
         static Context &getGlobalContext();
+        // Releases the GL objects of the global caches, call while the GL context is still current
+        void shutdown();
 
         // ---- Logging Methods ----
         void info(const std::string &msg) { log(LogLevel::Info, msg); }
@@ -59,27 +63,45 @@ namespace Prepath
             return (std::filesystem::path(m_ShaderPath) / inputName).string();
         }
 
+        // Empty cache path disables on-disk caches
+        void setCachePath(const std::string &path)
+        {
+            std::lock_guard<std::mutex> lock(m_CachePathMutex);
+            std::filesystem::path cwd = std::filesystem::current_path();
+            m_CachePath = (cwd / path).string();
+        }
+
+        std::string getCachePath()
+        {
+            std::lock_guard<std::mutex> lock(m_CachePathMutex);
+            return m_CachePath;
+        }
+
+        std::string getCachePath(const std::string &inputName)
+        {
+            std::lock_guard<std::mutex> lock(m_CachePathMutex);
+            if (m_CachePath.empty())
+                return "";
+            return (std::filesystem::path(m_CachePath) / inputName).string();
+        }
+
+        // Reads a shader and expands #include "file" lines relative to the shader path, each file is included once
         std::string readShader(const std::string &inputName)
         {
-            std::string filePath = getShaderPath(inputName);
-            std::ifstream file(filePath, std::ios::in | std::ios::binary);
-            if (!file)
-            {
-                throw std::runtime_error("Failed to open shader file: " + filePath);
-            }
-
-            std::ostringstream contents;
-            contents << file.rdbuf();
-            return contents.str();
+            std::unordered_set<std::string> included;
+            return readShader(inputName, included);
         }
 
     private:
         Context();
 
         void log(LogLevel level, const std::string &msg);
+        std::string readShader(const std::string &inputName, std::unordered_set<std::string> &included);
 
         std::mutex m_ShaderPathMutex;
         std::string m_ShaderPath = "/NO_PATH";
+        std::mutex m_CachePathMutex;
+        std::string m_CachePath;
         std::mutex m_LoggerMutex;
         std::unordered_map<LogLevel, LogFunction> m_Loggers;
     };
@@ -92,6 +114,9 @@ namespace Prepath
 #define PREPATH_LOG_FATAL(fmt, ...) ::Prepath::Context::getGlobalContext().fatal(std::format(fmt, ##__VA_ARGS__))
 
 #define PREPATH_GET_SHADER(path) ::Prepath::Context::getGlobalContext().getShaderPath(path)
+#define PREPATH_GET_CACHE(path) ::Prepath::Context::getGlobalContext().getCachePath(path)
 #define PREPATH_READ_SHADER(path) ::Prepath::Context::getGlobalContext().readShader(path)
 #define PREPATH_GENERATE_SHADERVF(vertexPath, fragmentPath) Shader::generateShader(PREPATH_READ_SHADER(vertexPath).c_str(), PREPATH_READ_SHADER(fragmentPath).c_str())
-#define PREPATH_GENERATE_SHADERVGF(vertexPath, geometryPath, fragmentPath) Shader::generateShader(PREPATH_READ_SHADER(vertexPath).c_str(), PREPATH_READ_SHADER(geometryPath).c_str(), PREPATH_READ_SHADER(fragmentPath).c_str())
\ No newline at end of file
+#define PREPATH_GENERATE_SHADERVGF(vertexPath, geometryPath, fragmentPath) Shader::generateShader(PREPATH_READ_SHADER(vertexPath).c_str(), PREPATH_READ_SHADER(geometryPath).c_str(), PREPATH_READ_SHADER(fragmentPath).c_str())
+#define PREPATH_GENERATE_SHADERVF_ASYNC(vertexPath, fragmentPath) Shader::generateShaderAsync(PREPATH_READ_SHADER(vertexPath).c_str(), PREPATH_READ_SHADER(fragmentPath).c_str())
+#define PREPATH_GENERATE_SHADERVGF_ASYNC(vertexPath, geometryPath, fragmentPath) Shader::generateShaderAsync(PREPATH_READ_SHADER(vertexPath).c_str(), PREPATH_READ_SHADER(geometryPath).c_str(), PREPATH_READ_SHADER(fragmentPath).c_str())
\ No newline at end of file
@@ -16,6 +16,8 @@ namespace Prepath
         ~Cubemap();
         void setData(unsigned char *data[6], unsigned int width, unsigned int height, int channels);
         unsigned int getID() { return m_ID; }
+        unsigned int getWidth() const { return m_Width; }
+        unsigned int getHeight() const { return m_Height; }
 
         static std::shared_ptr<Cubemap> generateTexture(unsigned char *data[6], unsigned int width, unsigned int height, int channels = 4);
 
@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <glm/glm.hpp>
+
+#include "AABB.h"
+
+namespace Prepath
+{
+    class Frustum
+    {
+    public:
+        Frustum() = default;
+        explicit Frustum(const glm::mat4 &viewProjection) { update(viewProjection); }
+
+        /// Extract the six clip planes (left, right, bottom, top, near, far) from a view-projection matrix
+        void update(const glm::mat4 &viewProjection)
+        {
+            glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+            glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+            glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+            glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+            m_Planes[0] = row3 + row0;
+            m_Planes[1] = row3 - row0;
+            m_Planes[2] = row3 + row1;
+            m_Planes[3] = row3 - row1;
+            m_Planes[4] = row3 + row2;
+            m_Planes[5] = row3 - row2;
+
+            for (auto &plane : m_Planes)
+                plane /= glm::length(glm::vec3(plane));
+        }
+
+        /// Conservative test, only rejects boxes fully behind one plane
+        bool intersects(const AABB &box) const
+        {
+            for (const auto &plane : m_Planes)
+            {
+                // Corner furthest along the plane normal
+                glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                                   plane.y >= 0.0f ? box.max.y : box.min.y,
+                                   plane.z >= 0.0f ? box.max.z : box.min.z);
+                if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                    return false;
+            }
+            return true;
+        }
+
+        bool intersects(const glm::vec3 &center, float radius) const
+        {
+            for (const auto &plane : m_Planes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                    return false;
+            }
+            return true;
+        }
+
+        const std::array<glm::vec4, 6> &getPlanes() const { return m_Planes; }
+
+    private:
+        std::array<glm::vec4, 6> m_Planes{};
+    };
+}
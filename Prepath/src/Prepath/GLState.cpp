@@ -0,0 +1,125 @@
+#include "GLState.h"
+
+namespace Prepath
+{
+    GLState &GLState::getGlobalState()
+    {
+        static GLState instance;
+        return instance;
+    }
+
+    void GLState::setCapability(GLenum capability, Tracked<bool> &current, bool enabled)
+    {
+        if (!changes(current, enabled))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+    void GLState::apply(const PipelineState &state)
+    {
+        setCapability(GL_DEPTH_TEST, m_DepthTest, state.depthTest);
+        if (changes(m_DepthWrite, state.depthWrite))
+            glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+        if (changes(m_DepthFunc, state.depthFunc))
+            glDepthFunc(state.depthFunc);
+
+        setCapability(GL_BLEND, m_Blend, state.blend);
+        if (changes(m_BlendFunc, {state.blendSrc, state.blendDst}))
+            glBlendFunc(state.blendSrc, state.blendDst);
+
+        setCapability(GL_CULL_FACE, m_Cull, state.cull);
+        if (changes(m_CullFace, state.cullFace))
+            glCullFace(state.cullFace);
+        if (changes(m_FrontFace, state.frontFace))
+            glFrontFace(state.frontFace);
+
+        if (changes(m_PolygonMode, state.polygonMode))
+            glPolygonMode(GL_FRONT_AND_BACK, state.polygonMode);
+        if (changes(m_ColorWrite, state.colorWrite))
+            glColorMask(state.colorWrite, state.colorWrite, state.colorWrite, state.colorWrite);
+
+        setCapability(GL_SCISSOR_TEST, m_ScissorTest, state.scissorTest);
+        if (state.scissorTest && changes(m_Scissor, state.scissor))
+            glScissor(state.scissor[0], state.scissor[1], state.scissor[2], state.scissor[3]);
+        setCapability(GL_CLIP_DISTANCE0, m_ClipDistance0, state.clipDistance0);
+    }
+
+    void GLState::useProgram(GLuint program)
+    {
+        if (changes(m_Program, program))
+            glUseProgram(program);
+    }
+
+    void GLState::bindVertexArray(GLuint vertexArray)
+    {
+        if (changes(m_VertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    bool GLState::bindTexture(int unit, GLenum target, GLuint texture)
+    {
+        if (unit >= PREPATH_GL_TEXTURE_UNITS)
+        {
+            m_ActiveUnit.valid = false;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(target, texture);
+            m_Issued += 2;
+            return true;
+        }
+
+        if (!changes(m_Textures[unit], {target, texture}))
+            return false;
+        if (changes(m_ActiveUnit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        return true;
+    }
+
+    void GLState::bindFramebuffer(GLuint framebuffer)
+    {
+        if (changes(m_Framebuffer, framebuffer))
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+    void GLState::viewport(int x, int y, int width, int height)
+    {
+        if (changes(m_Viewport, {x, y, width, height}))
+            glViewport(x, y, width, height);
+    }
+
+    void GLState::viewportIndexed(int index, int x, int y, int width, int height)
+    {
+        if (index == 0)
+        {
+            if (!changes(m_Viewport, {x, y, width, height}))
+                return;
+        }
+        else
+        {
+            m_Issued++;
+        }
+        glViewportIndexedf(GLuint(index), float(x), float(y), float(width), float(height));
+    }
+
+    void GLState::invalidate()
+    {
+        m_DepthTest.valid = m_DepthWrite.valid = m_Blend.valid = m_Cull.valid = m_ColorWrite.valid = false;
+        m_ScissorTest.valid = m_ClipDistance0.valid = m_Scissor.valid = false;
+        m_DepthFunc.valid = m_CullFace.valid = m_FrontFace.valid = m_PolygonMode.valid = false;
+        m_BlendFunc.valid = false;
+        m_Program.valid = m_VertexArray.valid = m_Framebuffer.valid = false;
+        m_Viewport.valid = false;
+        m_ActiveUnit.valid = false;
+        for (auto &texture : m_Textures)
+            texture.valid = false;
+    }
+
+    void GLState::resetStatistics()
+    {
+        m_Issued = 0;
+        m_Elided = 0;
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <utility>
+#include <glad/glad.h>
+
+#define PREPATH_GL_TEXTURE_UNITS (16) // Units shadowed by GLState, binds above this are always issued
+
+namespace Prepath
+{
+    // Fixed-function state of a pass. Passes describe everything they depend on as one value,
+    // GLState::apply then only issues the fields that differ from what is currently set.
+    struct PipelineState
+    {
+        bool depthTest = true;
+        bool depthWrite = true;
+        GLenum depthFunc = GL_LESS;
+        bool blend = false;
+        GLenum blendSrc = GL_SRC_ALPHA;
+        GLenum blendDst = GL_ONE_MINUS_SRC_ALPHA;
+        bool cull = false;
+        GLenum cullFace = GL_BACK;
+        GLenum frontFace = GL_CCW;
+        GLenum polygonMode = GL_FILL;
+        bool colorWrite = true;
+        bool scissorTest = false;
+        std::array<int, 4> scissor{}; // x, y, width, height, only set while scissorTest is on
+        bool clipDistance0 = false;   // gl_ClipDistance[0], used by the paraboloid shadow pass
+    };
+
+    // Shadows the bound program, VAO, textures, framebuffer, viewport and pipeline state of the
+    // context and drops calls that would not change anything
+    class GLState
+    {
+    public:
+        static GLState &getGlobalState();
+
+        GLState(const GLState &) = delete;
+        GLState &operator=(const GLState &) = delete;
+
+        void apply(const PipelineState &state);
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint vertexArray);
+        // Returns true when the bind was issued
+        bool bindTexture(int unit, GLenum target, GLuint texture);
+        void bindFramebuffer(GLuint framebuffer);
+        void viewport(int x, int y, int width, int height);
+        // glViewportIndexedf (GL 4.1), index 0 is the viewport tracked above
+        void viewportIndexed(int index, int x, int y, int width, int height);
+
+        // Forgets the shadowed state so the next call of each kind goes through,
+        // needed after code outside the tracker (uploads, IBL baking, UI) changed bindings
+        void invalidate();
+
+        // ---- Statistics Methods ----
+        int getIssuedCount() const { return m_Issued; }
+        int getElidedCount() const { return m_Elided; }
+        void resetStatistics();
+
+    private:
+        GLState() = default;
+
+        template <typename T>
+        struct Tracked
+        {
+            T value{};
+            bool valid = false; // Unknown until the first call after invalidate
+        };
+
+        // Counts the call and returns whether it has to be issued
+        template <typename T>
+        bool changes(Tracked<T> &current, const T &value)
+        {
+            if (current.valid && current.value == value)
+            {
+                m_Elided++;
+                return false;
+            }
+            current.value = value;
+            current.valid = true;
+            m_Issued++;
+            return true;
+        }
+        void setCapability(GLenum capability, Tracked<bool> &current, bool enabled);
+
+        struct TextureBinding
+        {
+            GLenum target = 0;
+            GLuint texture = 0;
+            bool operator==(const TextureBinding &) const = default;
+        };
+
+        Tracked<bool> m_DepthTest, m_DepthWrite, m_Blend, m_Cull, m_ColorWrite, m_ScissorTest, m_ClipDistance0;
+        Tracked<GLenum> m_DepthFunc, m_CullFace, m_FrontFace, m_PolygonMode;
+        Tracked<std::pair<GLenum, GLenum>> m_BlendFunc;
+        Tracked<GLuint> m_Program, m_VertexArray, m_Framebuffer;
+        Tracked<std::array<int, 4>> m_Viewport, m_Scissor;
+        Tracked<int> m_ActiveUnit;
+        std::array<Tracked<TextureBinding>, PREPATH_GL_TEXTURE_UNITS> m_Textures;
+
+        int m_Issued = 0;
+        int m_Elided = 0;
+    };
+}
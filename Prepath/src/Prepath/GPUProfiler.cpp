@@ -0,0 +1,193 @@
+#include "GPUProfiler.h"
+#include <algorithm>
+
+namespace Prepath
+{
+    GPUProfiler::~GPUProfiler()
+    {
+        for (auto &frame : m_Frames)
+        {
+            if (!frame.queries.empty())
+                glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+        }
+    }
+
+    size_t GPUProfiler::timestamp()
+    {
+        Frame &frame = m_Frames[m_Current];
+        if (frame.used == frame.queries.size())
+        {
+            // Each frame slot keeps its queries, so after the first frames no new ones are created
+            size_t count = std::max(frame.queries.size(), size_t(32));
+            size_t first = frame.queries.size();
+            frame.queries.resize(first + count);
+            glGenQueries(GLsizei(count), frame.queries.data() + first);
+        }
+        glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+        return frame.used++;
+    }
+
+    bool GPUProfiler::isAvailable(const Frame &frame) const
+    {
+        // Timestamps complete in order, the last one stands for the whole frame
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        return available != 0;
+    }
+
+    void GPUProfiler::beginFrame()
+    {
+        while (!m_Stack.empty())
+            endScope();
+
+        // Oldest first, a frame is only ready once every earlier one is
+        m_FrameIndex++;
+        m_Current = m_FrameIndex % PREPATH_PROFILER_FRAMES;
+        for (size_t k = 0; k < PREPATH_PROFILER_FRAMES; ++k)
+        {
+            Frame &frame = m_Frames[(m_Current + k) % PREPATH_PROFILER_FRAMES];
+            if (!frame.pending)
+                continue;
+            if (!isAvailable(frame))
+                break;
+            resolve(frame);
+        }
+
+        Frame &frame = m_Frames[m_Current];
+        if (frame.pending)
+        {
+            // Still in flight after a full ring, reusing its queries discards the results
+            m_DroppedFrames++;
+            frame.pending = false;
+        }
+        frame.used = 0;
+        frame.scopes.clear();
+        frame.draws.clear();
+        frame.drawSample = m_DrawSampling && m_FrameIndex % PREPATH_PROFILER_DRAW_INTERVAL == 0;
+    }
+
+    void GPUProfiler::beginScope(std::string_view name)
+    {
+        if (!m_Enabled)
+            return;
+
+        Frame &frame = m_Frames[m_Current];
+        Scope scope;
+        if (!m_Stack.empty())
+        {
+            const Scope &parent = frame.scopes[m_Stack.back()];
+            scope.path = parent.path + "/";
+            scope.depth = parent.depth + 1;
+        }
+        scope.nameOffset = scope.path.size();
+        scope.path += name;
+        scope.begin = timestamp();
+        scope.end = scope.begin;
+        m_Stack.push_back(frame.scopes.size());
+        frame.scopes.push_back(std::move(scope));
+        frame.pending = true;
+    }
+
+    void GPUProfiler::endScope()
+    {
+        if (m_Stack.empty())
+            return;
+        Frame &frame = m_Frames[m_Current];
+        frame.scopes[m_Stack.back()].end = timestamp();
+        m_Stack.pop_back();
+    }
+
+    void GPUProfiler::beginDraw(const Mesh *mesh)
+    {
+        if (!isSamplingDraws())
+            return;
+        Frame &frame = m_Frames[m_Current];
+        frame.draws.push_back({mesh, timestamp()});
+        frame.pending = true;
+    }
+
+    void GPUProfiler::endDraw()
+    {
+        // The end stamp always directly follows the begin stamp
+        if (isSamplingDraws())
+            timestamp();
+    }
+
+    void GPUProfiler::resolve(Frame &frame)
+    {
+        frame.pending = false;
+        m_Results.resize(frame.used);
+        for (size_t i = 0; i < frame.used; ++i)
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &m_Results[i]);
+        auto elapsedMs = [&](size_t begin, size_t end)
+        { return float(double(m_Results[end] - m_Results[begin]) * 1e-6); };
+
+        // ---- Scopes ----
+        // Scopes opened more than once per frame are summed into their first occurrence
+        std::unordered_map<std::string_view, size_t> firstIndex;
+        std::vector<std::string_view> paths;
+        std::vector<float> frameMs;
+        m_Timings.clear();
+        for (const Scope &scope : frame.scopes)
+        {
+            float ms = scope.end > scope.begin ? elapsedMs(scope.begin, scope.end) : 0.0f;
+            auto [it, inserted] = firstIndex.try_emplace(scope.path, m_Timings.size());
+            if (!inserted)
+            {
+                frameMs[it->second] += ms;
+                continue;
+            }
+            GPUTiming timing;
+            timing.name = scope.path.substr(scope.nameOffset);
+            timing.depth = scope.depth;
+            m_Timings.push_back(std::move(timing));
+            paths.push_back(scope.path);
+            frameMs.push_back(ms);
+        }
+
+        for (size_t i = 0; i < m_Timings.size(); ++i)
+        {
+            History &history = m_History[std::string(paths[i])];
+            history.samples[history.next] = frameMs[i];
+            history.next = (history.next + 1) % PREPATH_PROFILER_HISTORY;
+            history.count = std::min(history.count + 1, size_t(PREPATH_PROFILER_HISTORY));
+
+            m_Sorted.assign(history.samples.begin(), history.samples.begin() + history.count);
+            std::sort(m_Sorted.begin(), m_Sorted.end());
+            float sum = 0.0f;
+            for (float sample : m_Sorted)
+                sum += sample;
+            auto percentile = [&](float p)
+            { return m_Sorted[std::min(size_t(p * float(m_Sorted.size())), m_Sorted.size() - 1)]; };
+
+            GPUTiming &timing = m_Timings[i];
+            timing.lastMs = frameMs[i];
+            timing.averageMs = sum / float(m_Sorted.size());
+            timing.p50Ms = percentile(0.50f);
+            timing.p95Ms = percentile(0.95f);
+            timing.p99Ms = percentile(0.99f);
+        }
+
+        // ---- Draws ----
+        if (frame.draws.empty())
+            return;
+        for (const Draw &draw : frame.draws)
+        {
+            float ms = elapsedMs(draw.begin, draw.begin + 1);
+            auto [it, inserted] = m_DrawHistory.try_emplace(draw.mesh);
+            DrawTiming &timing = it->second;
+            timing.mesh = draw.mesh;
+            timing.triangles = draw.mesh->getTriangleCount();
+            timing.averageMs = inserted ? ms : timing.averageMs * 0.75f + ms * 0.25f;
+        }
+
+        m_DrawTimings.clear();
+        for (const auto &[mesh, timing] : m_DrawHistory)
+            m_DrawTimings.push_back(timing);
+        size_t count = std::min(m_DrawTimings.size(), size_t(PREPATH_PROFILER_DRAW_RESULTS));
+        std::partial_sort(m_DrawTimings.begin(), m_DrawTimings.begin() + count, m_DrawTimings.end(),
+                          [](const DrawTiming &a, const DrawTiming &b)
+                          { return a.averageMs > b.averageMs; });
+        m_DrawTimings.resize(count);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "Mesh.h"
+
+#define PREPATH_PROFILER_FRAMES (4)            // Frames in flight before a frame's timestamps are dropped unread
+#define PREPATH_PROFILER_HISTORY (120)         // Samples per scope behind the averages and percentiles
+#define PREPATH_PROFILER_DRAW_INTERVAL (30)    // Frames between per-draw samples
+#define PREPATH_PROFILER_DRAW_RESULTS (32)     // Most expensive draws kept
+
+namespace Prepath
+{
+    // One scope of the last resolved frame, in the order the scopes were opened
+    struct GPUTiming
+    {
+        std::string name;
+        int depth = 0; // Nesting level, children follow their parent
+        float lastMs = 0.0f;
+        float averageMs = 0.0f; // Over the history
+        float p50Ms = 0.0f;
+        float p95Ms = 0.0f;
+        float p99Ms = 0.0f;
+    };
+
+    struct DrawTiming
+    {
+        const Mesh *mesh = nullptr; // Only an identifier, may have been destroyed since
+        int triangles = 0;
+        float averageMs = 0.0f;     // Moving average over the sampled frames
+    };
+
+    // GPU timings from GL_TIMESTAMP counters. Scopes nest freely because each end is its own timestamp,
+    // a frame's queries are read back PREPATH_PROFILER_FRAMES - 1 frames later at the earliest and never waited on.
+    class GPUProfiler
+    {
+    public:
+        GPUProfiler() = default;
+        ~GPUProfiler();
+
+        GPUProfiler(const GPUProfiler &) = delete;
+        GPUProfiler &operator=(const GPUProfiler &) = delete;
+
+        // Closes the previous frame and collects every finished one, scopes opened after belong to the new frame
+        void beginFrame();
+        void beginScope(std::string_view name);
+        void endScope();
+        // Timestamps around single draws, only recorded on the frames isSamplingDraws reports
+        void beginDraw(const Mesh *mesh);
+        void endDraw();
+
+        void setEnabled(bool enabled) { m_Enabled = enabled; }
+        void setDrawSampling(bool enabled) { m_DrawSampling = enabled; }
+        bool isSamplingDraws() const { return m_Enabled && m_Frames[m_Current].drawSample; }
+
+        const std::vector<GPUTiming> &getTimings() const { return m_Timings; }
+        const std::vector<DrawTiming> &getDrawTimings() const { return m_DrawTimings; }
+        int getDroppedFrames() const { return m_DroppedFrames; }
+
+    private:
+        struct Scope
+        {
+            std::string path; // Names of the parents and this scope, separated by '/'
+            size_t nameOffset = 0;
+            int depth = 0;
+            size_t begin = 0, end = 0; // Query slots
+        };
+
+        struct Draw
+        {
+            const Mesh *mesh = nullptr;
+            size_t begin = 0;
+        };
+
+        struct Frame
+        {
+            std::vector<GLuint> queries;
+            size_t used = 0;
+            std::vector<Scope> scopes;
+            std::vector<Draw> draws;
+            bool pending = false;
+            bool drawSample = false;
+        };
+
+        struct History
+        {
+            std::array<float, PREPATH_PROFILER_HISTORY> samples{};
+            size_t count = 0;
+            size_t next = 0;
+        };
+
+        size_t timestamp();
+        bool isAvailable(const Frame &frame) const;
+        void resolve(Frame &frame);
+
+        bool m_Enabled = true;
+        bool m_DrawSampling = false;
+        uint64_t m_FrameIndex = 0;
+        size_t m_Current = 0;
+        std::array<Frame, PREPATH_PROFILER_FRAMES> m_Frames;
+        std::vector<size_t> m_Stack; // Open scopes of the current frame
+
+        std::unordered_map<std::string, History> m_History;
+        std::unordered_map<const Mesh *, DrawTiming> m_DrawHistory;
+        std::vector<GPUTiming> m_Timings;
+        std::vector<DrawTiming> m_DrawTimings;
+        std::vector<GLuint64> m_Results;
+        std::vector<float> m_Sorted;
+        int m_DroppedFrames = 0;
+    };
+
+    // Scope that closes itself
+    class GPUScope
+    {
+    public:
+        GPUScope(GPUProfiler &profiler, std::string_view name) : m_Profiler(profiler) { m_Profiler.beginScope(name); }
+        ~GPUScope() { m_Profiler.endScope(); }
+
+        GPUScope(const GPUScope &) = delete;
+        GPUScope &operator=(const GPUScope &) = delete;
+
+    private:
+        GPUProfiler &m_Profiler;
+    };
+}
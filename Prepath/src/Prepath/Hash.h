@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#define PREPATH_HASH_SEED (14695981039346656037ull) // FNV-1a offset basis, start value of every hash chain
+
+namespace Prepath
+{
+    // 64-bit FNV-1a, for cache keys and change detection only. Chain calls by passing the previous result.
+    inline uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,508 @@
+#include "IBL.h"
+#include "Error.h"
+#include "ThreadPool.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PREPATH_IBL_SSE
+#include <emmintrin.h>
+#endif
+
+#define PREPATH_IBL_MAGIC (0x42495050) // "PPIB"
+#define PREPATH_IBL_VERSION (1)
+
+namespace Prepath
+{
+    namespace
+    {
+        constexpr float PI = 3.14159265358979f;
+
+        struct alignas(16) Texel
+        {
+            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+        };
+
+        // sum += value * weight
+        inline void madd(Texel &sum, const Texel &value, float weight)
+        {
+#ifdef PREPATH_IBL_SSE
+            _mm_store_ps(&sum.r, _mm_add_ps(_mm_load_ps(&sum.r), _mm_mul_ps(_mm_load_ps(&value.r), _mm_set1_ps(weight))));
+#else
+            sum.r += value.r * weight;
+            sum.g += value.g * weight;
+            sum.b += value.b * weight;
+            sum.a += value.a * weight;
+#endif
+        }
+
+        inline Texel lerp(const Texel &a, const Texel &b, float t)
+        {
+            Texel result;
+#ifdef PREPATH_IBL_SSE
+            __m128 va = _mm_load_ps(&a.r);
+            _mm_store_ps(&result.r, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(&b.r), va), _mm_set1_ps(t))));
+#else
+            result.r = a.r + (b.r - a.r) * t;
+            result.g = a.g + (b.g - a.g) * t;
+            result.b = a.b + (b.b - a.b) * t;
+            result.a = a.a + (b.a - a.a) * t;
+#endif
+            return result;
+        }
+
+        struct CubeImage
+        {
+            unsigned int size = 0;
+            std::vector<Texel> faces[6];
+
+            void resize(unsigned int newSize)
+            {
+                size = newSize;
+                for (auto &face : faces)
+                    face.assign(size_t(size) * size, Texel());
+            }
+
+            const Texel &at(int face, unsigned int x, unsigned int y) const { return faces[face][size_t(y) * size + x]; }
+        };
+
+        // GL cubemap face selection (major axis)
+        void directionToFace(const glm::vec3 &dir, int &face, float &u, float &v)
+        {
+            glm::vec3 a = glm::abs(dir);
+            float sc, tc, ma;
+            if (a.x >= a.y && a.x >= a.z)
+            {
+                face = dir.x > 0.0f ? 0 : 1;
+                ma = a.x;
+                sc = dir.x > 0.0f ? -dir.z : dir.z;
+                tc = -dir.y;
+            }
+            else if (a.y >= a.z)
+            {
+                face = dir.y > 0.0f ? 2 : 3;
+                ma = a.y;
+                sc = dir.x;
+                tc = dir.y > 0.0f ? dir.z : -dir.z;
+            }
+            else
+            {
+                face = dir.z > 0.0f ? 4 : 5;
+                ma = a.z;
+                sc = dir.z > 0.0f ? dir.x : -dir.x;
+                tc = -dir.y;
+            }
+            u = 0.5f * (sc / ma + 1.0f);
+            v = 0.5f * (tc / ma + 1.0f);
+        }
+
+        glm::vec3 faceToDirection(int face, float u, float v)
+        {
+            float sc = 2.0f * u - 1.0f;
+            float tc = 2.0f * v - 1.0f;
+            glm::vec3 dir;
+            switch (face)
+            {
+            case 0:
+                dir = glm::vec3(1.0f, -tc, -sc);
+                break;
+            case 1:
+                dir = glm::vec3(-1.0f, -tc, sc);
+                break;
+            case 2:
+                dir = glm::vec3(sc, 1.0f, tc);
+                break;
+            case 3:
+                dir = glm::vec3(sc, -1.0f, -tc);
+                break;
+            case 4:
+                dir = glm::vec3(sc, -tc, 1.0f);
+                break;
+            default:
+                dir = glm::vec3(-sc, -tc, -1.0f);
+                break;
+            }
+            return glm::normalize(dir);
+        }
+
+        Texel sampleBilinear(const CubeImage &image, const glm::vec3 &dir)
+        {
+            int face;
+            float u, v;
+            directionToFace(dir, face, u, v);
+
+            float fx = std::clamp(u * image.size - 0.5f, 0.0f, float(image.size - 1));
+            float fy = std::clamp(v * image.size - 0.5f, 0.0f, float(image.size - 1));
+            unsigned int x0 = unsigned(fx);
+            unsigned int y0 = unsigned(fy);
+            unsigned int x1 = std::min(x0 + 1, image.size - 1);
+            unsigned int y1 = std::min(y0 + 1, image.size - 1);
+            float tx = fx - x0;
+            float ty = fy - y0;
+
+            return lerp(lerp(image.at(face, x0, y0), image.at(face, x1, y0), tx),
+                        lerp(image.at(face, x0, y1), image.at(face, x1, y1), tx), ty);
+        }
+
+        Texel sampleLod(const std::vector<CubeImage> &mips, const glm::vec3 &dir, float lod)
+        {
+            lod = std::clamp(lod, 0.0f, float(mips.size() - 1));
+            size_t level = size_t(lod);
+            if (level + 1 >= mips.size())
+                return sampleBilinear(mips.back(), dir);
+            return lerp(sampleBilinear(mips[level], dir), sampleBilinear(mips[level + 1], dir), lod - level);
+        }
+
+        CubeImage downsample(const CubeImage &src)
+        {
+            CubeImage dst;
+            dst.resize(std::max(1u, src.size / 2));
+            for (int face = 0; face < 6; ++face)
+            {
+                for (unsigned int y = 0; y < dst.size; ++y)
+                {
+                    for (unsigned int x = 0; x < dst.size; ++x)
+                    {
+                        unsigned int sx = std::min(x * 2, src.size - 1), sy = std::min(y * 2, src.size - 1);
+                        unsigned int sx1 = std::min(sx + 1, src.size - 1), sy1 = std::min(sy + 1, src.size - 1);
+                        Texel sum;
+                        madd(sum, src.at(face, sx, sy), 0.25f);
+                        madd(sum, src.at(face, sx1, sy), 0.25f);
+                        madd(sum, src.at(face, sx, sy1), 0.25f);
+                        madd(sum, src.at(face, sx1, sy1), 0.25f);
+                        dst.faces[face][size_t(y) * dst.size + x] = sum;
+                    }
+                }
+            }
+            return dst;
+        }
+
+        glm::vec2 hammersley(unsigned int i, unsigned int count)
+        {
+            unsigned int bits = i;
+            bits = (bits << 16u) | (bits >> 16u);
+            bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+            bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+            bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+            bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+            return glm::vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10f);
+        }
+
+        // Half vector around +Z
+        glm::vec3 importanceSampleGGX(const glm::vec2 &xi, float roughness)
+        {
+            float a = roughness * roughness;
+            float phi = 2.0f * PI * xi.x;
+            float cosTheta = std::sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            return glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+        }
+
+        float distributionGGX(float NdotH, float roughness)
+        {
+            float a = roughness * roughness;
+            float a2 = a * a;
+            float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+            return a2 / (PI * denom * denom);
+        }
+
+        std::array<glm::vec3, 9> projectIrradianceSH(const CubeImage &image)
+        {
+            std::mutex mutex;
+            std::array<glm::vec3, 9> sh{};
+            ThreadPool::getGlobalPool().parallelFor(6 * size_t(image.size), 8, [&](size_t begin, size_t end)
+                                                    {
+                std::array<glm::vec3, 9> partial{};
+                for (size_t row = begin; row < end; ++row)
+                {
+                    int face = int(row / image.size);
+                    unsigned int y = unsigned(row % image.size);
+                    for (unsigned int x = 0; x < image.size; ++x)
+                    {
+                        float u = (x + 0.5f) / image.size;
+                        float v = (y + 0.5f) / image.size;
+                        float sc = 2.0f * u - 1.0f;
+                        float tc = 2.0f * v - 1.0f;
+                        float solidAngle = 4.0f / (image.size * image.size * std::pow(1.0f + sc * sc + tc * tc, 1.5f));
+
+                        glm::vec3 d = faceToDirection(face, u, v);
+                        const Texel &t = image.at(face, x, y);
+                        glm::vec3 color = glm::vec3(t.r, t.g, t.b) * solidAngle;
+
+                        partial[0] += color * 0.282095f;
+                        partial[1] += color * (0.488603f * d.y);
+                        partial[2] += color * (0.488603f * d.z);
+                        partial[3] += color * (0.488603f * d.x);
+                        partial[4] += color * (1.092548f * d.x * d.y);
+                        partial[5] += color * (1.092548f * d.y * d.z);
+                        partial[6] += color * (0.315392f * (3.0f * d.z * d.z - 1.0f));
+                        partial[7] += color * (1.092548f * d.x * d.z);
+                        partial[8] += color * (0.546274f * (d.x * d.x - d.y * d.y));
+                    }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int i = 0; i < 9; ++i)
+                    sh[i] += partial[i]; });
+
+            // Cosine lobe convolution (pi, 2pi/3, pi/4), divided by pi for Lambert
+            const float band[9] = {1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f};
+            for (int i = 0; i < 9; ++i)
+                sh[i] *= band[i];
+            return sh;
+        }
+
+        std::vector<float> prefilterSpecular(const std::vector<CubeImage> &sourceMips, unsigned int size, float roughness)
+        {
+            struct Sample
+            {
+                glm::vec3 direction; // Tangent space light direction (N = V = +Z)
+                float weight;
+                float lod;
+            };
+
+            // Filtered importance sampling: read coarser source mips for low-pdf samples
+            std::vector<Sample> samples;
+            float texelSolidAngle = 4.0f * PI / (6.0f * sourceMips[0].size * sourceMips[0].size);
+            for (unsigned int i = 0; i < PREPATH_IBL_SPECULAR_SAMPLES; ++i)
+            {
+                glm::vec3 H = importanceSampleGGX(hammersley(i, PREPATH_IBL_SPECULAR_SAMPLES), roughness);
+                glm::vec3 L = 2.0f * H.z * H - glm::vec3(0.0f, 0.0f, 1.0f);
+                if (L.z <= 0.0f)
+                    continue;
+                float pdf = distributionGGX(H.z, roughness) * 0.25f;
+                float sampleSolidAngle = 1.0f / (PREPATH_IBL_SPECULAR_SAMPLES * pdf + 0.0001f);
+                float lod = roughness == 0.0f ? 0.0f : 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+                samples.push_back({L, L.z, lod});
+            }
+
+            std::vector<float> result(size_t(size) * size * 6 * 4);
+            ThreadPool::getGlobalPool().parallelFor(6 * size_t(size), 4, [&](size_t begin, size_t end)
+                                                    {
+                for (size_t row = begin; row < end; ++row)
+                {
+                    int face = int(row / size);
+                    unsigned int y = unsigned(row % size);
+                    for (unsigned int x = 0; x < size; ++x)
+                    {
+                        glm::vec3 N = faceToDirection(face, (x + 0.5f) / size, (y + 0.5f) / size);
+                        glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                        glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+                        glm::vec3 bitangent = glm::cross(N, tangent);
+
+                        Texel sum;
+                        float totalWeight = 0.0f;
+                        for (const auto &sample : samples)
+                        {
+                            glm::vec3 L = tangent * sample.direction.x + bitangent * sample.direction.y + N * sample.direction.z;
+                            madd(sum, sampleLod(sourceMips, L, sample.lod), sample.weight);
+                            totalWeight += sample.weight;
+                        }
+
+                        float *out = &result[((size_t(face) * size + y) * size + x) * 4];
+                        float scale = totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f;
+                        out[0] = sum.r * scale;
+                        out[1] = sum.g * scale;
+                        out[2] = sum.b * scale;
+                        out[3] = 1.0f;
+                    }
+                } });
+            return result;
+        }
+
+        std::vector<float> integrateBRDF()
+        {
+            const unsigned int size = PREPATH_IBL_BRDF_SIZE;
+            std::vector<float> lut(size_t(size) * size * 2);
+            ThreadPool::getGlobalPool().parallelFor(size, 4, [&](size_t begin, size_t end)
+                                                    {
+                for (size_t j = begin; j < end; ++j)
+                {
+                    float roughness = (j + 0.5f) / size;
+                    float k = roughness * roughness * 0.5f;
+                    for (unsigned int i = 0; i < size; ++i)
+                    {
+                        float NdotV = (i + 0.5f) / size;
+                        glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+                        float scale = 0.0f;
+                        float bias = 0.0f;
+                        for (unsigned int s = 0; s < PREPATH_IBL_BRDF_SAMPLES; ++s)
+                        {
+                            glm::vec3 H = importanceSampleGGX(hammersley(s, PREPATH_IBL_BRDF_SAMPLES), roughness);
+                            float VdotH = glm::dot(V, H);
+                            glm::vec3 L = 2.0f * VdotH * H - V;
+                            float NdotL = L.z;
+                            if (NdotL <= 0.0f)
+                                continue;
+                            VdotH = std::max(VdotH, 0.0f);
+                            float G = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+                            float visibility = G * VdotH / (std::max(H.z, 0.0001f) * NdotV);
+                            float fresnel = std::pow(1.0f - VdotH, 5.0f);
+                            scale += (1.0f - fresnel) * visibility;
+                            bias += fresnel * visibility;
+                        }
+                        lut[(j * size + i) * 2 + 0] = scale / PREPATH_IBL_BRDF_SAMPLES;
+                        lut[(j * size + i) * 2 + 1] = bias / PREPATH_IBL_BRDF_SAMPLES;
+                    }
+                } });
+            return lut;
+        }
+
+        CubeImage readCubemap(Cubemap &cubemap)
+        {
+            // Read back a small mip, the prefilter never needs more resolution than that
+            int level = 0;
+            unsigned int size = cubemap.getWidth();
+            while (size > PREPATH_IBL_SOURCE_SIZE)
+            {
+                size = std::max(1u, size / 2);
+                level++;
+            }
+
+            CubeImage image;
+            image.resize(size);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap.getID());
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            for (int face = 0; face < 6; ++face)
+            {
+                glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA, GL_FLOAT, image.faces[face].data());
+                for (auto &texel : image.faces[face])
+                {
+                    // Skyboxes are authored in sRGB, lighting is linear
+                    texel.r = std::pow(texel.r, 2.2f);
+                    texel.g = std::pow(texel.g, 2.2f);
+                    texel.b = std::pow(texel.b, 2.2f);
+                }
+            }
+            return image;
+        }
+    }
+
+    IBL::~IBL()
+    {
+        if (m_Specular)
+            glDeleteTextures(1, &m_Specular);
+        if (m_BRDFLut)
+            glDeleteTextures(1, &m_BRDFLut);
+    }
+
+    void IBL::upload(const std::vector<std::vector<float>> &specularMips, const std::vector<float> &brdfLut)
+    {
+        glGenTextures(1, &m_Specular);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_Specular);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (int mip = 0; mip < PREPATH_IBL_SPECULAR_MIPS; ++mip)
+        {
+            unsigned int size = PREPATH_IBL_SPECULAR_SIZE >> mip;
+            size_t faceFloats = size_t(size) * size * 4;
+            for (int face = 0; face < 6; ++face)
+            {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB16F, size, size, 0,
+                             GL_RGBA, GL_FLOAT, specularMips[mip].data() + face * faceFloats);
+            }
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, PREPATH_IBL_SPECULAR_MIPS - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        glGenTextures(1, &m_BRDFLut);
+        glBindTexture(GL_TEXTURE_2D, m_BRDFLut);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, PREPATH_IBL_BRDF_SIZE, PREPATH_IBL_BRDF_SIZE, 0, GL_RG, GL_FLOAT, brdfLut.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    std::shared_ptr<IBL> IBL::generateIBL(std::shared_ptr<Cubemap> source)
+    {
+        auto ibl = std::make_shared<IBL>();
+        CubeImage image = readCubemap(*source);
+
+        uint64_t key = PREPATH_HASH_SEED;
+        const uint32_t params[] = {PREPATH_IBL_VERSION, PREPATH_IBL_SPECULAR_SIZE, PREPATH_IBL_SPECULAR_MIPS,
+                                   PREPATH_IBL_SPECULAR_SAMPLES, PREPATH_IBL_BRDF_SIZE, PREPATH_IBL_BRDF_SAMPLES, image.size};
+        key = hashBytes(key, params, sizeof(params));
+        for (const auto &face : image.faces)
+            key = hashBytes(key, face.data(), face.size() * sizeof(Texel));
+
+        std::vector<std::vector<float>> specularMips(PREPATH_IBL_SPECULAR_MIPS);
+        std::vector<float> brdfLut(size_t(PREPATH_IBL_BRDF_SIZE) * PREPATH_IBL_BRDF_SIZE * 2);
+        for (int mip = 0; mip < PREPATH_IBL_SPECULAR_MIPS; ++mip)
+        {
+            unsigned int size = PREPATH_IBL_SPECULAR_SIZE >> mip;
+            specularMips[mip].resize(size_t(size) * size * 6 * 4);
+        }
+
+        // ---- Disk Cache ----
+        std::string cachePath = PREPATH_GET_CACHE(std::format("ibl_{:016x}.bin", key));
+        if (!cachePath.empty() && std::filesystem::exists(cachePath))
+        {
+            std::ifstream file(cachePath, std::ios::binary);
+            uint32_t header[2] = {};
+            file.read(reinterpret_cast<char *>(header), sizeof(header));
+            if (file && header[0] == PREPATH_IBL_MAGIC && header[1] == PREPATH_IBL_VERSION)
+            {
+                file.read(reinterpret_cast<char *>(ibl->m_IrradianceSH.data()), sizeof(ibl->m_IrradianceSH));
+                for (auto &mip : specularMips)
+                    file.read(reinterpret_cast<char *>(mip.data()), mip.size() * sizeof(float));
+                file.read(reinterpret_cast<char *>(brdfLut.data()), brdfLut.size() * sizeof(float));
+                if (file)
+                {
+                    PREPATH_LOG_INFO("Loaded IBL from cache: {}", cachePath);
+                    ibl->upload(specularMips, brdfLut);
+                    return ibl;
+                }
+            }
+            PREPATH_LOG_WARN("Ignoring invalid IBL cache: {}", cachePath);
+        }
+
+        // ---- Prefilter ----
+        std::vector<CubeImage> sourceMips;
+        sourceMips.push_back(std::move(image));
+        while (sourceMips.back().size > 1)
+            sourceMips.push_back(downsample(sourceMips.back()));
+
+        // SH projection only needs a coarse image
+        size_t shLevel = 0;
+        while (shLevel + 1 < sourceMips.size() && sourceMips[shLevel].size > 64)
+            shLevel++;
+        ibl->m_IrradianceSH = projectIrradianceSH(sourceMips[shLevel]);
+
+        for (int mip = 0; mip < PREPATH_IBL_SPECULAR_MIPS; ++mip)
+        {
+            float roughness = float(mip) / float(PREPATH_IBL_SPECULAR_MIPS - 1);
+            specularMips[mip] = prefilterSpecular(sourceMips, PREPATH_IBL_SPECULAR_SIZE >> mip, roughness);
+        }
+        brdfLut = integrateBRDF();
+
+        if (!cachePath.empty())
+        {
+            std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path());
+            std::ofstream file(cachePath, std::ios::binary);
+            if (file)
+            {
+                uint32_t header[2] = {PREPATH_IBL_MAGIC, PREPATH_IBL_VERSION};
+                file.write(reinterpret_cast<const char *>(header), sizeof(header));
+                file.write(reinterpret_cast<const char *>(ibl->m_IrradianceSH.data()), sizeof(ibl->m_IrradianceSH));
+                for (const auto &mip : specularMips)
+                    file.write(reinterpret_cast<const char *>(mip.data()), mip.size() * sizeof(float));
+                file.write(reinterpret_cast<const char *>(brdfLut.data()), brdfLut.size() * sizeof(float));
+            }
+            else
+            {
+                PREPATH_LOG_WARN("Failed to write IBL cache: {}", cachePath);
+            }
+        }
+
+        ibl->upload(specularMips, brdfLut);
+        return ibl;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "Context.h"
+#include "Cubemap.h"
+
+#define PREPATH_IBL_SPECULAR_SIZE (128)
+#define PREPATH_IBL_SPECULAR_MIPS (6)
+#define PREPATH_IBL_SPECULAR_SAMPLES (64)
+#define PREPATH_IBL_BRDF_SIZE (128)
+#define PREPATH_IBL_BRDF_SAMPLES (256)
+#define PREPATH_IBL_SOURCE_SIZE (256) // Largest source mip read back for prefiltering
+
+namespace Prepath
+{
+    // Image based lighting prefiltered from a skybox on the CPU:
+    // irradiance as 9 SH coefficients, a GGX prefiltered specular cubemap and a split-sum BRDF LUT
+    class IBL
+    {
+    public:
+        IBL() = default;
+        ~IBL();
+
+        IBL(const IBL &) = delete;
+        IBL &operator=(const IBL &) = delete;
+
+        unsigned int getSpecularID() const { return m_Specular; }
+        unsigned int getBRDFLutID() const { return m_BRDFLut; }
+        int getSpecularMipCount() const { return PREPATH_IBL_SPECULAR_MIPS; }
+        // Already convolved with the cosine lobe and divided by pi, evaluate with the SH basis for diffuse irradiance
+        const std::array<glm::vec3, 9> &getIrradianceSH() const { return m_IrradianceSH; }
+
+        // Uses the on-disk cache (Context cache path) keyed by a hash of the source texels
+        static std::shared_ptr<IBL> generateIBL(std::shared_ptr<Cubemap> source);
+
+    private:
+        void upload(const std::vector<std::vector<float>> &specularMips, const std::vector<float> &brdfLut);
+
+        GLuint m_Specular = 0;
+        GLuint m_BRDFLut = 0;
+        std::array<glm::vec3, 9> m_IrradianceSH{};
+    };
+}
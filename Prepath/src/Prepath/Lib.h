@@ -10,4 +10,19 @@
 #include "Shader.h"
 #include "Material.h"
 #include "AABB.h"
-#include "Texture.h"
\ No newline at end of file
+#include "Frustum.h"
+#include "Texture.h"
+#include "VirtualTexture.h"
+#include "IBL.h"
+#include "ThreadPool.h"
+#include "RenderQueue.h"
+#include "ShadowScheduler.h"
+#include "LightClusters.h"
+#include "UniformBuffer.h"
+#include "MeshArena.h"
+#include "GLState.h"
+#include "Hash.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "GPUProfiler.h"
+#include "ShadowAtlas.h"
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PREPATH_CLUSTER_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Prepath
+{
+    namespace
+    {
+        void createTextureBuffer(GLuint &buffer, GLuint &texture, GLenum format)
+        {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        void uploadTextureBuffer(GLuint buffer, const void *data, size_t size)
+        {
+            // Orphan the old store, texture buffers keep pointing at the buffer object
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, std::max(size, size_t(16)), nullptr, GL_STREAM_DRAW);
+            if (size > 0)
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+
+        float sliceDepth(int slice, float nearPlane, float farPlane)
+        {
+            // Exponential slices keep froxels roughly cubic
+            return nearPlane * std::pow(farPlane / nearPlane, float(slice) / PREPATH_CLUSTER_Z);
+        }
+    }
+
+    LightClusters::LightClusters()
+    {
+        createTextureBuffer(m_LightBuffer, m_LightTexture, GL_RGBA32F);
+        createTextureBuffer(m_ClusterBuffer, m_ClusterTexture, GL_RG32UI);
+        createTextureBuffer(m_IndexBuffer, m_IndexTexture, GL_R32UI);
+        m_SliceIndices.resize(PREPATH_CLUSTER_Z);
+        m_SliceCounts.resize(PREPATH_CLUSTER_Z);
+    }
+
+    LightClusters::~LightClusters()
+    {
+        GLuint textures[3] = {m_LightTexture, m_ClusterTexture, m_IndexTexture};
+        GLuint buffers[3] = {m_LightBuffer, m_ClusterBuffer, m_IndexBuffer};
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    void LightClusters::buildClusterBounds(const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        m_ClusterBounds.resize(PREPATH_CLUSTER_COUNT);
+        for (int z = 0; z < PREPATH_CLUSTER_Z; ++z)
+        {
+            float depthNear = sliceDepth(z, nearPlane, farPlane);
+            float depthFar = sliceDepth(z + 1, nearPlane, farPlane);
+            for (int y = 0; y < PREPATH_CLUSTER_Y; ++y)
+            {
+                for (int x = 0; x < PREPATH_CLUSTER_X; ++x)
+                {
+                    // Tile corners in NDC unprojected onto both slice planes
+                    float ndcX[2] = {-1.0f + 2.0f * x / PREPATH_CLUSTER_X, -1.0f + 2.0f * (x + 1) / PREPATH_CLUSTER_X};
+                    float ndcY[2] = {-1.0f + 2.0f * y / PREPATH_CLUSTER_Y, -1.0f + 2.0f * (y + 1) / PREPATH_CLUSTER_Y};
+                    float depths[2] = {depthNear, depthFar};
+
+                    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+                    for (float depth : depths)
+                    {
+                        for (float nx : ndcX)
+                        {
+                            for (float ny : ndcY)
+                            {
+                                glm::vec3 corner(nx * depth / projection[0][0], ny * depth / projection[1][1], -depth);
+                                boundsMin = glm::min(boundsMin, corner);
+                                boundsMax = glm::max(boundsMax, corner);
+                            }
+                        }
+                    }
+                    m_ClusterBounds[(z * PREPATH_CLUSTER_Y + y) * PREPATH_CLUSTER_X + x] = {boundsMin, boundsMax};
+                }
+            }
+        }
+    }
+
+    void LightClusters::assignSlice(int slice, std::vector<uint32_t> &indices, std::vector<uint32_t> &counts) const
+    {
+        indices.clear();
+        counts.assign(PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y, 0);
+
+        // Lights overlapping this depth slice, padded to a multiple of four with lights that never hit
+        float sliceNear = -sliceDepth(slice, m_Near, m_Far);
+        float sliceFar = -sliceDepth(slice + 1, m_Near, m_Far);
+        std::vector<float> x, y, z, radiusSq;
+        std::vector<uint32_t> lightIndex;
+        for (size_t i = 0; i < m_LightIndex.size(); ++i)
+        {
+            if (m_LightZ[i] - m_LightRadius[i] > sliceNear || m_LightZ[i] + m_LightRadius[i] < sliceFar)
+                continue;
+            x.push_back(m_LightX[i]);
+            y.push_back(m_LightY[i]);
+            z.push_back(m_LightZ[i]);
+            radiusSq.push_back(m_LightRadius[i] * m_LightRadius[i]);
+            lightIndex.push_back(m_LightIndex[i]);
+        }
+        if (lightIndex.empty())
+            return;
+        while (x.size() % 4 != 0)
+        {
+            x.push_back(1e30f);
+            y.push_back(1e30f);
+            z.push_back(1e30f);
+            radiusSq.push_back(0.0f);
+        }
+
+        for (int tile = 0; tile < PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y; ++tile)
+        {
+            const ClusterBounds &bounds = m_ClusterBounds[slice * PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y + tile];
+            uint32_t count = 0;
+
+#ifdef PREPATH_CLUSTER_SSE
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 minX = _mm_set1_ps(bounds.min.x), maxX = _mm_set1_ps(bounds.max.x);
+            const __m128 minY = _mm_set1_ps(bounds.min.y), maxY = _mm_set1_ps(bounds.max.y);
+            const __m128 minZ = _mm_set1_ps(bounds.min.z), maxZ = _mm_set1_ps(bounds.max.z);
+            for (size_t i = 0; i < x.size(); i += 4)
+            {
+                // Squared distance from each sphere center to the box
+                __m128 cx = _mm_loadu_ps(&x[i]), cy = _mm_loadu_ps(&y[i]), cz = _mm_loadu_ps(&z[i]);
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, cx), _mm_sub_ps(cx, maxX)), zero);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, cy), _mm_sub_ps(cy, maxY)), zero);
+                __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), _mm_sub_ps(cz, maxZ)), zero);
+                __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(&radiusSq[i])));
+                for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+                {
+                    if (mask & 1)
+                    {
+                        indices.push_back(lightIndex[i + lane]);
+                        count++;
+                    }
+                }
+            }
+#else
+            for (size_t i = 0; i < lightIndex.size(); ++i)
+            {
+                glm::vec3 center(x[i], y[i], z[i]);
+                glm::vec3 offset = glm::clamp(center, bounds.min, bounds.max) - center;
+                if (glm::dot(offset, offset) <= radiusSq[i])
+                {
+                    indices.push_back(lightIndex[i]);
+                    count++;
+                }
+            }
+#endif
+            counts[tile] = count;
+        }
+    }
+
+    void LightClusters::update(const Scene &scene, const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        if (nearPlane != m_Near || farPlane != m_Far || std::memcmp(&projection, &m_Projection, sizeof(glm::mat4)) != 0)
+        {
+            m_Near = nearPlane;
+            m_Far = farPlane;
+            m_Projection = projection;
+            buildClusterBounds(projection, nearPlane, farPlane);
+        }
+
+        // ---- Lights ----
+        m_LightX.clear();
+        m_LightY.clear();
+        m_LightZ.clear();
+        m_LightRadius.clear();
+        m_LightIndex.clear();
+        m_LightData.clear();
+        const auto &lights = scene.getPointLights();
+        for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+        {
+            const auto &light = lights[lightIndex];
+            if (light->hidden || light->range <= 0.0f)
+                continue;
+
+            glm::vec3 viewPos = glm::vec3(view * glm::vec4(light->position, 1.0f));
+            m_LightX.push_back(viewPos.x);
+            m_LightY.push_back(viewPos.y);
+            m_LightZ.push_back(viewPos.z);
+            m_LightRadius.push_back(light->range);
+            m_LightIndex.push_back(uint32_t(m_LightData.size() / 8));
+
+            glm::vec3 radiance = light->color * light->intensity;
+            float data[8] = {light->position.x, light->position.y, light->position.z, light->range,
+                             radiance.r, radiance.g, radiance.b, float(lightIndex)};
+            m_LightData.insert(m_LightData.end(), data, data + 8);
+        }
+        m_LightCount = int(m_LightIndex.size());
+
+        // ---- Assignment ----
+        ThreadPool::getGlobalPool().parallelFor(PREPATH_CLUSTER_Z, 1, [&](size_t begin, size_t end)
+                                                {
+            for (size_t slice = begin; slice < end; ++slice)
+                assignSlice(int(slice), m_SliceIndices[slice], m_SliceCounts[slice]); });
+
+        m_Indices.clear();
+        m_ClusterData.resize(PREPATH_CLUSTER_COUNT * 2);
+        m_MaxLightsPerCluster = 0;
+        for (int slice = 0; slice < PREPATH_CLUSTER_Z; ++slice)
+        {
+            const auto &counts = m_SliceCounts[slice];
+            uint32_t offset = uint32_t(m_Indices.size());
+            for (int tile = 0; tile < PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y; ++tile)
+            {
+                size_t cluster = size_t(slice) * PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y + tile;
+                m_ClusterData[cluster * 2 + 0] = offset;
+                m_ClusterData[cluster * 2 + 1] = counts[tile];
+                offset += counts[tile];
+                m_MaxLightsPerCluster = std::max(m_MaxLightsPerCluster, int(counts[tile]));
+            }
+            m_Indices.insert(m_Indices.end(), m_SliceIndices[slice].begin(), m_SliceIndices[slice].end());
+        }
+
+        // ---- Upload ----
+        uploadTextureBuffer(m_LightBuffer, m_LightData.data(), m_LightData.size() * sizeof(float));
+        uploadTextureBuffer(m_ClusterBuffer, m_ClusterData.data(), m_ClusterData.size() * sizeof(uint32_t));
+        uploadTextureBuffer(m_IndexBuffer, m_Indices.data(), m_Indices.size() * sizeof(uint32_t));
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#include "Scene.h"
+
+// Froxel grid, must match the CLUSTER_* constants in default.frag
+#define PREPATH_CLUSTER_X (16)
+#define PREPATH_CLUSTER_Y (9)
+#define PREPATH_CLUSTER_Z (24)
+#define PREPATH_CLUSTER_COUNT (PREPATH_CLUSTER_X * PREPATH_CLUSTER_Y * PREPATH_CLUSTER_Z)
+
+namespace Prepath
+{
+    // Clustered forward lighting: assigns point lights to a view-space froxel grid on the CPU and
+    // uploads the lights, per-cluster ranges and the flat index list as texture buffers (GL 3.3)
+    class LightClusters
+    {
+    public:
+        LightClusters();
+        ~LightClusters();
+
+        LightClusters(const LightClusters &) = delete;
+        LightClusters &operator=(const LightClusters &) = delete;
+
+        // Rebuilds the grid for this view and uploads it, call once per frame before the lit pass
+        void update(const Scene &scene, const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane);
+
+        unsigned int getLightTexture() const { return m_LightTexture; }     // RGBA32F, 2 texels per light: position + range, color * intensity + scene index
+        unsigned int getClusterTexture() const { return m_ClusterTexture; } // RG32UI per cluster: offset, count
+        unsigned int getIndexTexture() const { return m_IndexTexture; }     // R32UI light indices
+        float getNear() const { return m_Near; }
+        float getFar() const { return m_Far; }
+
+        // ---- Statistics Methods ----
+        int getLightCount() const { return m_LightCount; }
+        int getIndexCount() const { return int(m_Indices.size()); }
+        int getMaxLightsPerCluster() const { return m_MaxLightsPerCluster; }
+
+    private:
+        struct ClusterBounds
+        {
+            glm::vec3 min;
+            glm::vec3 max;
+        };
+
+        void buildClusterBounds(const glm::mat4 &projection, float nearPlane, float farPlane);
+        void assignSlice(int slice, std::vector<uint32_t> &indices, std::vector<uint32_t> &counts) const;
+
+        GLuint m_LightBuffer = 0, m_LightTexture = 0;
+        GLuint m_ClusterBuffer = 0, m_ClusterTexture = 0;
+        GLuint m_IndexBuffer = 0, m_IndexTexture = 0;
+
+        float m_Near = 0.0f;
+        float m_Far = 0.0f;
+        glm::mat4 m_Projection = glm::mat4(0.0f);
+        std::vector<ClusterBounds> m_ClusterBounds;
+
+        // View-space lights as SoA so four can be tested per SIMD instruction
+        std::vector<float> m_LightX, m_LightY, m_LightZ, m_LightRadius;
+        std::vector<uint32_t> m_LightIndex;
+
+        std::vector<float> m_LightData;
+        std::vector<uint32_t> m_ClusterData;
+        std::vector<uint32_t> m_Indices;
+        std::vector<std::vector<uint32_t>> m_SliceIndices;
+        std::vector<std::vector<uint32_t>> m_SliceCounts;
+
+        int m_LightCount = 0;
+        int m_MaxLightsPerCluster = 0;
+    };
+}
@@ -3,6 +3,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Context.h"
+#include "Shader.h"
 #include "Texture.h"
 
 namespace Prepath
@@ -17,6 +18,37 @@ namespace Prepath
         std::shared_ptr<Texture> metal;
         std::shared_ptr<Texture> ao;
 
+        // Placeholders made by generateMaterial. A slot still holding its placeholder has no map, compared by
+        // pointer so that real single texel maps assigned later are still sampled.
+        struct DefaultMaps
+        {
+            std::shared_ptr<Texture> normal, roughness, metal, ao;
+        } defaults;
+
+        // Bit per texture slot (albedo, normal, roughness, metal, ao) that streams through the virtual texture cache
+        int getVirtualMask() const
+        {
+            int mask = 0;
+            const std::shared_ptr<Texture> *slots[5] = {&albedo, &normal, &roughness, &metal, &ao};
+            for (int i = 0; i < 5; ++i)
+            {
+                if (*slots[i] && (*slots[i])->isVirtual())
+                    mask |= 1 << i;
+            }
+            return mask;
+        }
+
+        // Shader permutation features the textures need, the variants without them use the placeholder values as constants
+        uint32_t getShaderFeatures() const
+        {
+            uint32_t features = 0;
+            if (normal && normal != defaults.normal)
+                features |= PREPATH_SHADER_NORMAL_MAP;
+            if ((roughness && roughness != defaults.roughness) || (metal && metal != defaults.metal) || (ao && ao != defaults.ao))
+                features |= PREPATH_SHADER_ORM_MAPS;
+            return features;
+        }
+
         static inline std::shared_ptr<Material> generateMaterial()
         {
             auto mat = std::make_shared<Material>();
@@ -34,6 +66,8 @@ namespace Prepath
 
             unsigned char defaultAO[1] = {255}; // no occlusion
             mat->ao = Texture::generateTexture(defaultAO, 1, 1, 1);
+
+            mat->defaults = {mat->normal, mat->roughness, mat->metal, mat->ao};
             return mat;
         }
     };
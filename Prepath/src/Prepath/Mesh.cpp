@@ -1,16 +1,8 @@
 #include "Mesh.h"
 #include "Error.h"
+#include "GLState.h"
 #include <iostream>
-
-struct Vertex
-{
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoord;
-    glm::vec3 tangent;
-    glm::vec3 bitangent;
-    int triangleID;
-};
+#include <cstring>
 
 namespace Prepath
 {
@@ -19,20 +11,25 @@ namespace Prepath
 
     Mesh::~Mesh()
     {
-        if (VBO)
-            glDeleteBuffers(1, &VBO);
-        if (VAO)
-            glDeleteVertexArrays(1, &VAO);
+        MeshArena::getGlobalArena().free(firstVertex, vertexCount);
+    }
+
+    const glm::mat4 &Mesh::getNormalMatrix() const
+    {
+        if (std::memcmp(&normalMatrixSource, &modelMatrix, sizeof(glm::mat4)) != 0)
+        {
+            normalMatrixSource = modelMatrix;
+            normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMatrix))));
+        }
+        return normalMatrix;
     }
 
     Mesh::Mesh(Mesh &&other) noexcept
     {
-        VAO = other.VAO;
-        VBO = other.VBO;
+        firstVertex = other.firstVertex;
         vertexCount = other.vertexCount;
 
-        other.VAO = 0;
-        other.VBO = 0;
+        other.firstVertex = 0;
         other.vertexCount = 0;
     }
 
@@ -40,17 +37,12 @@ namespace Prepath
     {
         if (this != &other)
         {
-            if (VBO)
-                glDeleteBuffers(1, &VBO);
-            if (VAO)
-                glDeleteVertexArrays(1, &VAO);
+            MeshArena::getGlobalArena().free(firstVertex, vertexCount);
 
-            VAO = other.VAO;
-            VBO = other.VBO;
+            firstVertex = other.firstVertex;
             vertexCount = other.vertexCount;
 
-            other.VAO = 0;
-            other.VBO = 0;
+            other.firstVertex = 0;
             other.vertexCount = 0;
         }
         return *this;
@@ -60,9 +52,17 @@ namespace Prepath
     {
         if (!hidden)
         {
-            glBindVertexArray(VAO);
-            glDrawArrays(GL_TRIANGLES, 0, vertexCount);
-            glBindVertexArray(0);
+            GLState::getGlobalState().bindVertexArray(MeshArena::getGlobalArena().getVAO());
+            glDrawArrays(GL_TRIANGLES, firstVertex, vertexCount);
+        }
+    }
+
+    void Mesh::drawInstanced(GLsizei count) const
+    {
+        if (!hidden && count > 0)
+        {
+            GLState::getGlobalState().bindVertexArray(MeshArena::getGlobalArena().getVAO());
+            glDrawArraysInstanced(GL_TRIANGLES, firstVertex, vertexCount, count);
         }
     }
 
@@ -163,38 +163,7 @@ namespace Prepath
         this->bounds.min = minBound;
         this->bounds.max = maxBound;
 
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-        // Position
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
-
-        // Normal
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
-
-        // TexCoord
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texCoord));
-
-        // Tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, tangent));
-
-        // Bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, bitangent));
-
-        // Triangle ID
-        glEnableVertexAttribArray(5);
-        glVertexAttribIPointer(5, 1, GL_INT, sizeof(Vertex), (void *)offsetof(Vertex, triangleID));
-
-        glBindVertexArray(0);
+        firstVertex = MeshArena::getGlobalArena().allocate(vertices);
     }
 
     std::shared_ptr<Mesh> Mesh::generateCube(float size)
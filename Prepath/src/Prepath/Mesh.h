@@ -7,6 +7,7 @@
 
 #include "Material.h"
 #include "AABB.h"
+#include "MeshArena.h"
 
 namespace Prepath
 {
@@ -26,6 +27,8 @@ namespace Prepath
         Mesh &operator=(Mesh &&other) noexcept;
 
         void draw() const;
+        // Draws count copies, aDrawID counts the instances from 0 (see object.glsl)
+        void drawInstanced(GLsizei count) const;
 
         // ---- Creation Methods ----
         static std::shared_ptr<Mesh> generateMesh(
@@ -42,19 +45,27 @@ namespace Prepath
         GLsizei getVertexCount() const { return vertexCount; }
         GLsizei getTriangleCount() const { return triangleCount; }
         GLsizei getDrawCallCount() const { return drawCallCount; }
+        GLint getFirstVertex() const { return firstVertex; } // Offset of this mesh's range in the MeshArena
+
+        // Inverse transpose of modelMatrix as a padded mat3, cached until modelMatrix changes
+        const glm::mat4 &getNormalMatrix() const;
 
     public:
         bool hidden = false;
         AABB bounds;
         glm::mat4 modelMatrix = glm::mat4(1.0f);
         std::shared_ptr<Material> material;
+        // Local-space triangle list drawn into the CPU occlusion buffer, must lie inside the rendered surface.
+        // A simplified hull, the full positions or OcclusionCuller::boxTriangles for solid boxes, empty never occludes.
+        std::vector<glm::vec3> occluderTriangles;
 
     private:
-        GLuint VAO = 0;
-        GLuint VBO = 0;
+        GLint firstVertex = 0;
         GLsizei vertexCount = 0;
         GLsizei triangleCount = 0;
         GLsizei drawCallCount = 0;
+        mutable glm::mat4 normalMatrixSource = glm::mat4(1.0f);
+        mutable glm::mat4 normalMatrix = glm::mat4(1.0f);
 
         void setupMesh(
             const std::vector<glm::vec3> &positions,
@@ -0,0 +1,174 @@
+#include "MeshArena.h"
+#include "GLState.h"
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+
+namespace Prepath
+{
+    MeshArena &MeshArena::getGlobalArena()
+    {
+        static MeshArena instance;
+        return instance;
+    }
+
+    MeshArena::~MeshArena()
+    {
+        GLuint buffers[2] = {m_VertexBuffer, m_DrawIDBuffer};
+        glDeleteBuffers(2, buffers);
+        if (m_VAO)
+            glDeleteVertexArrays(1, &m_VAO);
+    }
+
+    bool MeshArena::supportsIndirect()
+    {
+        return GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance);
+    }
+
+    void MeshArena::grow(GLsizei required)
+    {
+        GLsizei capacity = std::max(m_Capacity, GLsizei(PREPATH_ARENA_INITIAL_VERTICES));
+        while (capacity < required)
+            capacity *= 2;
+        if (capacity == m_Capacity)
+            return;
+
+        GLuint buffer = 0;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size_t(capacity) * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        if (m_VertexBuffer)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, m_VertexBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size_t(m_End) * sizeof(Vertex));
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &m_VertexBuffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        m_VertexBuffer = buffer;
+        m_Capacity = capacity;
+
+        if (!m_VAO)
+            glGenVertexArrays(1, &m_VAO);
+
+        // Re-point the attributes at the new store
+        GLState::getGlobalState().bindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+
+        // Position
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+
+        // Normal
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+
+        // TexCoord
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texCoord));
+
+        // Tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, tangent));
+
+        // Bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, bitangent));
+
+        // Triangle ID
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 1, GL_INT, sizeof(Vertex), (void *)offsetof(Vertex, triangleID));
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        reserveDrawIDs(1);
+    }
+
+    GLint MeshArena::allocate(const std::vector<Vertex> &vertices)
+    {
+        GLsizei count = GLsizei(vertices.size());
+        if (count == 0)
+            return 0;
+
+        // First fit from the free list, otherwise append behind the used part
+        GLint first = -1;
+        for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+        {
+            if (it->count < count)
+                continue;
+            first = it->first;
+            it->first += count;
+            it->count -= count;
+            if (it->count == 0)
+                m_FreeRanges.erase(it);
+            break;
+        }
+        if (first < 0)
+        {
+            grow(m_End + count);
+            first = m_End;
+            m_End += count;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, size_t(first) * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_LiveVertices += count;
+        return first;
+    }
+
+    void MeshArena::free(GLint first, GLsizei count)
+    {
+        if (count <= 0)
+            return;
+        m_LiveVertices -= count;
+
+        auto next = std::lower_bound(m_FreeRanges.begin(), m_FreeRanges.end(), first,
+                                     [](const Range &range, GLint value)
+                                     { return range.first < value; });
+        next = m_FreeRanges.insert(next, {first, count});
+
+        // Merge with the following and the preceding range
+        if (next + 1 != m_FreeRanges.end() && next->first + next->count == (next + 1)->first)
+        {
+            next->count += (next + 1)->count;
+            m_FreeRanges.erase(next + 1);
+        }
+        if (next != m_FreeRanges.begin() && (next - 1)->first + (next - 1)->count == next->first)
+        {
+            (next - 1)->count += next->count;
+            next = m_FreeRanges.erase(next) - 1;
+        }
+
+        // A free range at the end just moves the end back
+        if (next->first + next->count == m_End)
+        {
+            m_End = next->first;
+            m_FreeRanges.erase(next);
+        }
+    }
+
+    void MeshArena::reserveDrawIDs(size_t count)
+    {
+        if (count <= m_DrawIDCount || !m_VAO)
+            return;
+
+        size_t capacity = std::max(m_DrawIDCount * 2, std::max(count, size_t(1024)));
+        std::vector<GLint> ids(capacity);
+        std::iota(ids.begin(), ids.end(), 0);
+
+        if (!m_DrawIDBuffer)
+            glGenBuffers(1, &m_DrawIDBuffer);
+        GLState::getGlobalState().bindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_DrawIDBuffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLint), ids.data(), GL_STATIC_DRAW);
+
+        // Draw ID, advances once per instance so base instance picks the draw's entry
+        glEnableVertexAttribArray(6);
+        glVertexAttribIPointer(6, 1, GL_INT, sizeof(GLint), (void *)0);
+        glVertexAttribDivisor(6, 1);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_DrawIDCount = capacity;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#define PREPATH_ARENA_INITIAL_VERTICES (1 << 18) // Doubled whenever an allocation does not fit
+
+namespace Prepath
+{
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texCoord;
+        glm::vec3 tangent;
+        glm::vec3 bitangent;
+        int triangleID;
+    };
+
+    // Layout read by glMultiDrawArraysIndirect
+    struct DrawArraysIndirectCommand
+    {
+        GLuint count = 0;
+        GLuint instanceCount = 1;
+        GLuint first = 0;
+        GLuint baseInstance = 0; // Index of the draw's entry in the per-draw data
+    };
+
+    // One vertex buffer and VAO shared by every Mesh so a whole pass can be submitted with a single
+    // indirect call. Attribute 6 is a per-instance draw index (0, 1, 2, ...), offset by base instance.
+    class MeshArena
+    {
+    public:
+        static MeshArena &getGlobalArena();
+
+        MeshArena(const MeshArena &) = delete;
+        MeshArena &operator=(const MeshArena &) = delete;
+
+        // Copies the vertices into the arena and returns the first vertex of their range
+        GLint allocate(const std::vector<Vertex> &vertices);
+        void free(GLint first, GLsizei count);
+        // Makes sure draw indices up to count can be fetched through attribute 6
+        void reserveDrawIDs(size_t count);
+
+        GLuint getVAO() const { return m_VAO; }
+        // GL 4.3 or ARB_multi_draw_indirect + ARB_base_instance
+        static bool supportsIndirect();
+
+        // ---- Statistics Methods ----
+        GLsizei getCapacity() const { return m_Capacity; }
+        GLsizei getUsedVertices() const { return m_LiveVertices; }
+
+    private:
+        MeshArena() = default;
+        ~MeshArena();
+
+        void grow(GLsizei required);
+
+        struct Range
+        {
+            GLint first;
+            GLsizei count;
+        };
+
+        GLuint m_VAO = 0;
+        GLuint m_VertexBuffer = 0;
+        GLuint m_DrawIDBuffer = 0;
+        GLsizei m_Capacity = 0;
+        GLsizei m_End = 0; // Vertices past this were never handed out
+        GLsizei m_LiveVertices = 0;
+        size_t m_DrawIDCount = 0;
+        std::vector<Range> m_FreeRanges; // Sorted by first, adjacent ranges merged
+    };
+}
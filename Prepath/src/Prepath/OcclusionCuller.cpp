@@ -0,0 +1,402 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PREPATH_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+// AVX2 is compiled per function and only picked when the CPU reports it, the library itself keeps its baseline flags
+#if defined(PREPATH_OCCLUSION_SSE) && (defined(_MSC_VER) || defined(__GNUC__))
+#define PREPATH_OCCLUSION_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PREPATH_TARGET_AVX2
+#else
+#define PREPATH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace Prepath
+{
+    namespace
+    {
+        constexpr float NEAR_W = 1e-4f; // Clip w below this counts as crossing the near plane
+
+        // Edge functions a * x + b * y + c, >= 0 inside, and the depth plane over the pixel bounds of one triangle
+        struct TriangleSetup
+        {
+            float edgeA[3], edgeB[3], edgeC[3];
+            float z0, dzdx, dzdy;
+            int minX, maxX, minY, maxY;
+        };
+
+        void rasterizeScalar(const TriangleSetup &t, float *depth)
+        {
+            for (int y = t.minY; y <= t.maxY; ++y)
+            {
+                float py = float(y) + 0.5f;
+                float *row = depth + size_t(y) * PREPATH_OCCLUSION_WIDTH;
+                for (int x = t.minX; x <= t.maxX; ++x)
+                {
+                    float px = float(x) + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3; ++e)
+                        inside = inside && t.edgeA[e] * px + t.edgeB[e] * py + t.edgeC[e] >= 0.0f;
+                    if (inside)
+                        row[x] = std::min(row[x], t.z0 + t.dzdx * px + t.dzdy * py);
+                }
+            }
+        }
+
+#ifdef PREPATH_OCCLUSION_SSE
+        void rasterizeSSE(const TriangleSetup &t, float *depth)
+        {
+            // Rows start on a multiple of the lane count, lanes past the triangle fail the edge tests
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 a0 = _mm_set1_ps(t.edgeA[0]), a1 = _mm_set1_ps(t.edgeA[1]), a2 = _mm_set1_ps(t.edgeA[2]);
+            const __m128 dzdx = _mm_set1_ps(t.dzdx);
+            for (int y = t.minY; y <= t.maxY; ++y)
+            {
+                float py = float(y) + 0.5f;
+                float *row = depth + size_t(y) * PREPATH_OCCLUSION_WIDTH;
+                const __m128 r0 = _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+                const __m128 r1 = _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+                const __m128 r2 = _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+                const __m128 rz = _mm_set1_ps(t.z0 + t.dzdy * py);
+                for (int x = t.minX & ~3; x <= t.maxX; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero),
+                                                          _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero)),
+                                               _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 z = _mm_add_ps(_mm_mul_ps(dzdx, px), rz);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+                }
+            }
+        }
+#endif
+
+#ifdef PREPATH_OCCLUSION_AVX2
+        PREPATH_TARGET_AVX2 void rasterizeAVX2(const TriangleSetup &t, float *depth)
+        {
+            const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 a0 = _mm256_set1_ps(t.edgeA[0]), a1 = _mm256_set1_ps(t.edgeA[1]), a2 = _mm256_set1_ps(t.edgeA[2]);
+            const __m256 dzdx = _mm256_set1_ps(t.dzdx);
+            for (int y = t.minY; y <= t.maxY; ++y)
+            {
+                float py = float(y) + 0.5f;
+                float *row = depth + size_t(y) * PREPATH_OCCLUSION_WIDTH;
+                const __m256 r0 = _mm256_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+                const __m256 r1 = _mm256_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+                const __m256 r2 = _mm256_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+                const __m256 rz = _mm256_set1_ps(t.z0 + t.dzdy * py);
+                for (int x = t.minX & ~7; x <= t.maxX; x += 8)
+                {
+                    __m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), offsets);
+                    __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a0, px), r0), zero, _CMP_GE_OQ),
+                                                                _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a1, px), r1), zero, _CMP_GE_OQ)),
+                                                  _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(a2, px), r2), zero, _CMP_GE_OQ));
+                    if (_mm256_movemask_ps(inside) == 0)
+                        continue;
+                    __m256 z = _mm256_add_ps(_mm256_mul_ps(dzdx, px), rz);
+                    __m256 old = _mm256_loadu_ps(row + x);
+                    _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+                }
+            }
+        }
+
+        bool cpuSupportsAVX2()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            return osSavesYmm && (info[1] & (1 << 5));
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+    }
+
+    static_assert((PREPATH_OCCLUSION_WIDTH & (PREPATH_OCCLUSION_WIDTH - 1)) == 0 && PREPATH_OCCLUSION_WIDTH % 8 == 0,
+                  "Occlusion buffer width must be a power of two and hold whole AVX2 rows");
+    static_assert((PREPATH_OCCLUSION_HEIGHT & (PREPATH_OCCLUSION_HEIGHT - 1)) == 0, "Occlusion buffer height must be a power of two");
+
+    OcclusionCuller::OcclusionCuller()
+    {
+        size_t offset = 0;
+        for (int width = PREPATH_OCCLUSION_WIDTH, height = PREPATH_OCCLUSION_HEIGHT; width >= 1 && height >= 1; width /= 2, height /= 2)
+        {
+            m_LevelOffsets.push_back(offset);
+            offset += size_t(width) * height;
+        }
+        m_HiZ.assign(offset, 1.0f);
+        m_Backend = getSupportedBackend();
+    }
+
+    OcclusionBackend OcclusionCuller::getSupportedBackend()
+    {
+#ifdef PREPATH_OCCLUSION_AVX2
+        static const bool avx2 = cpuSupportsAVX2();
+        if (avx2)
+            return OcclusionBackend::AVX2;
+#endif
+#ifdef PREPATH_OCCLUSION_SSE
+        return OcclusionBackend::SSE;
+#else
+        return OcclusionBackend::Scalar;
+#endif
+    }
+
+    void OcclusionCuller::setBackend(OcclusionBackend backend)
+    {
+        m_Backend = std::min(backend, getSupportedBackend());
+    }
+
+    const char *OcclusionCuller::getBackendName(OcclusionBackend backend)
+    {
+        switch (backend)
+        {
+        case OcclusionBackend::AVX2:
+            return "AVX2";
+        case OcclusionBackend::SSE:
+            return "SSE";
+        default:
+            return "Scalar";
+        }
+    }
+
+    std::vector<glm::vec3> OcclusionCuller::boxTriangles(const AABB &bounds)
+    {
+        const glm::vec3 &a = bounds.min;
+        const glm::vec3 &b = bounds.max;
+        glm::vec3 corners[8] = {{a.x, a.y, a.z}, {b.x, a.y, a.z}, {a.x, b.y, a.z}, {b.x, b.y, a.z},
+                                {a.x, a.y, b.z}, {b.x, a.y, b.z}, {a.x, b.y, b.z}, {b.x, b.y, b.z}};
+        const int faces[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4}, {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+
+        std::vector<glm::vec3> triangles;
+        triangles.reserve(36);
+        for (const auto &face : faces)
+        {
+            const int quad[6] = {face[0], face[1], face[2], face[0], face[2], face[3]};
+            for (int index : quad)
+                triangles.push_back(corners[index]);
+        }
+        return triangles;
+    }
+
+    void OcclusionCuller::update(const Scene &scene, const glm::mat4 &viewProjection, const glm::vec3 &cameraPos, const Frustum &frustum)
+    {
+        m_ViewProjection = viewProjection;
+        std::fill(m_HiZ.begin(), m_HiZ.begin() + size_t(PREPATH_OCCLUSION_WIDTH) * PREPATH_OCCLUSION_HEIGHT, 1.0f);
+        m_OccluderCount = 0;
+        m_TriangleCount = 0;
+
+        // ---- Occluder Selection ----
+        m_Candidates.clear();
+        for (const auto &mesh : scene.getMeshes())
+        {
+            if (mesh->hidden || mesh->occluderTriangles.size() < 3)
+                continue;
+            AABB worldBounds = mesh->bounds * mesh->modelMatrix;
+            if (!frustum.intersects(worldBounds))
+                continue;
+
+            glm::vec3 center = (worldBounds.min + worldBounds.max) * 0.5f;
+            glm::vec3 extent = (worldBounds.max - worldBounds.min) * 0.5f;
+            glm::vec3 offset = center - cameraPos;
+            float distanceSq = std::max(glm::dot(offset, offset), 1e-4f);
+            m_Candidates.push_back({mesh.get(), glm::dot(extent, extent) / distanceSq});
+        }
+
+        size_t count = std::min(m_Candidates.size(), size_t(PREPATH_OCCLUSION_MAX_OCCLUDERS));
+        std::partial_sort(m_Candidates.begin(), m_Candidates.begin() + count, m_Candidates.end(),
+                          [](const Candidate &a, const Candidate &b)
+                          { return a.score > b.score; });
+
+        // ---- Rasterization ----
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Mesh *mesh = m_Candidates[i].mesh;
+            int triangles = int(mesh->occluderTriangles.size() / 3);
+            if (m_TriangleCount + triangles > PREPATH_OCCLUSION_MAX_TRIANGLES)
+                continue;
+            rasterize(mesh->modelMatrix, mesh->occluderTriangles);
+            m_OccluderCount++;
+            m_TriangleCount += triangles;
+        }
+
+        buildHiZ();
+        m_Ready = true;
+    }
+
+    void OcclusionCuller::rasterize(const glm::mat4 &model, std::span<const glm::vec3> triangles)
+    {
+        glm::mat4 mvp = m_ViewProjection * model;
+        m_Clip.resize(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i)
+            m_Clip[i] = mvp * glm::vec4(triangles[i], 1.0f);
+
+        const float width = float(PREPATH_OCCLUSION_WIDTH);
+        const float height = float(PREPATH_OCCLUSION_HEIGHT);
+        float *depth = getLevel(0);
+        for (size_t i = 0; i + 2 < m_Clip.size(); i += 3)
+        {
+            // Clipping is skipped, dropping a triangle only lets more through
+            glm::vec3 v[3];
+            bool behind = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                const glm::vec4 &clip = m_Clip[i + k];
+                if (clip.w < NEAR_W)
+                {
+                    behind = true;
+                    break;
+                }
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                v[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+            }
+            if (behind)
+                continue;
+
+            // Both windings count, the rasterizer only needs the interior on the positive side
+            float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+            if (std::abs(area) < 1e-8f)
+                continue;
+            if (area < 0.0f)
+            {
+                std::swap(v[1], v[2]);
+                area = -area;
+            }
+
+            TriangleSetup t;
+            t.minX = std::max(int(std::floor(std::min({v[0].x, v[1].x, v[2].x}))), 0);
+            t.maxX = std::min(int(std::ceil(std::max({v[0].x, v[1].x, v[2].x}))), PREPATH_OCCLUSION_WIDTH - 1);
+            t.minY = std::max(int(std::floor(std::min({v[0].y, v[1].y, v[2].y}))), 0);
+            t.maxY = std::min(int(std::ceil(std::max({v[0].y, v[1].y, v[2].y}))), PREPATH_OCCLUSION_HEIGHT - 1);
+            if (t.minX > t.maxX || t.minY > t.maxY)
+                continue;
+
+            for (int e = 0; e < 3; ++e)
+            {
+                const glm::vec3 &a = v[e];
+                const glm::vec3 &b = v[(e + 1) % 3];
+                t.edgeA[e] = a.y - b.y;
+                t.edgeB[e] = b.x - a.x;
+                t.edgeC[e] = -(t.edgeA[e] * a.x + t.edgeB[e] * a.y);
+            }
+
+            // NDC depth is affine in screen space
+            t.dzdx = ((v[1].z - v[0].z) * (v[2].y - v[0].y) - (v[2].z - v[0].z) * (v[1].y - v[0].y)) / area;
+            t.dzdy = ((v[2].z - v[0].z) * (v[1].x - v[0].x) - (v[1].z - v[0].z) * (v[2].x - v[0].x)) / area;
+            t.z0 = v[0].z - t.dzdx * v[0].x - t.dzdy * v[0].y;
+
+            switch (m_Backend)
+            {
+#ifdef PREPATH_OCCLUSION_AVX2
+            case OcclusionBackend::AVX2:
+                rasterizeAVX2(t, depth);
+                break;
+#endif
+#ifdef PREPATH_OCCLUSION_SSE
+            case OcclusionBackend::SSE:
+                rasterizeSSE(t, depth);
+                break;
+#endif
+            default:
+                rasterizeScalar(t, depth);
+                break;
+            }
+        }
+    }
+
+    void OcclusionCuller::buildHiZ()
+    {
+        // Each texel keeps the farthest depth below it, a box nearer than that is in front of every occluder pixel
+        int width = PREPATH_OCCLUSION_WIDTH;
+        int height = PREPATH_OCCLUSION_HEIGHT;
+        for (size_t level = 1; level < m_LevelOffsets.size(); ++level)
+        {
+            const float *src = getLevel(int(level) - 1);
+            float *dst = getLevel(int(level));
+            int srcWidth = width;
+            width /= 2;
+            height /= 2;
+            for (int y = 0; y < height; ++y)
+            {
+                const float *row0 = src + size_t(2 * y) * srcWidth;
+                const float *row1 = row0 + srcWidth;
+                for (int x = 0; x < width; ++x)
+                    dst[size_t(y) * width + x] = std::max(std::max(row0[2 * x], row0[2 * x + 1]), std::max(row1[2 * x], row1[2 * x + 1]));
+            }
+        }
+    }
+
+    bool OcclusionCuller::isOccluded(const AABB &worldBounds) const
+    {
+        if (!m_Ready || m_OccluderCount == 0)
+            return false;
+
+        // ---- Screen Rectangle ----
+        glm::vec3 ndcMin(std::numeric_limits<float>::max());
+        glm::vec3 ndcMax(-std::numeric_limits<float>::max());
+        for (int i = 0; i < 8; ++i)
+        {
+            glm::vec3 corner((i & 1) ? worldBounds.max.x : worldBounds.min.x,
+                             (i & 2) ? worldBounds.max.y : worldBounds.min.y,
+                             (i & 4) ? worldBounds.max.z : worldBounds.min.z);
+            glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w < NEAR_W)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+
+        float left = (ndcMin.x * 0.5f + 0.5f) * PREPATH_OCCLUSION_WIDTH;
+        float right = (ndcMax.x * 0.5f + 0.5f) * PREPATH_OCCLUSION_WIDTH;
+        float bottom = (ndcMin.y * 0.5f + 0.5f) * PREPATH_OCCLUSION_HEIGHT;
+        float top = (ndcMax.y * 0.5f + 0.5f) * PREPATH_OCCLUSION_HEIGHT;
+        if (right < 0.0f || left > PREPATH_OCCLUSION_WIDTH || top < 0.0f || bottom > PREPATH_OCCLUSION_HEIGHT)
+            return false;
+
+        int x0 = std::clamp(int(std::floor(left)), 0, PREPATH_OCCLUSION_WIDTH - 1);
+        int x1 = std::clamp(int(std::floor(right)), 0, PREPATH_OCCLUSION_WIDTH - 1);
+        int y0 = std::clamp(int(std::floor(bottom)), 0, PREPATH_OCCLUSION_HEIGHT - 1);
+        int y1 = std::clamp(int(std::floor(top)), 0, PREPATH_OCCLUSION_HEIGHT - 1);
+        float nearest = ndcMin.z * 0.5f + 0.5f;
+
+        // ---- HiZ Test ----
+        int level = 0;
+        while (level + 1 < int(m_LevelOffsets.size()) &&
+               std::max((x1 >> level) - (x0 >> level), (y1 >> level) - (y0 >> level)) >= PREPATH_OCCLUSION_TEST_TEXELS)
+            level++;
+
+        const float *texels = getLevel(level);
+        int levelWidth = PREPATH_OCCLUSION_WIDTH >> level;
+        for (int y = y0 >> level; y <= (y1 >> level); ++y)
+        {
+            for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            {
+                if (texels[size_t(y) * levelWidth + x] >= nearest)
+                    return false;
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "Frustum.h"
+
+#define PREPATH_OCCLUSION_WIDTH (256)             // CPU depth buffer, powers of two so every HiZ level halves evenly
+#define PREPATH_OCCLUSION_HEIGHT (128)
+#define PREPATH_OCCLUSION_MAX_OCCLUDERS (64)      // Largest on screen occluders rasterized per frame
+#define PREPATH_OCCLUSION_MAX_TRIANGLES (65536)   // Occluder triangle budget per frame
+#define PREPATH_OCCLUSION_TEST_TEXELS (4)         // HiZ texels per axis an occludee test reads at most
+
+namespace Prepath
+{
+    enum class OcclusionBackend
+    {
+        Scalar,
+        SSE,
+        AVX2
+    };
+
+    // Software occlusion culling: rasterizes the occluder geometry of the largest visible meshes into a small
+    // depth buffer on the CPU, builds a max-depth pyramid over it and rejects bounds that lie behind it.
+    // Makes no GL calls, so it also runs without a context.
+    class OcclusionCuller
+    {
+    public:
+        OcclusionCuller();
+
+        // Rebuilds the depth buffer for this view, call once per frame before testing
+        void update(const Scene &scene, const glm::mat4 &viewProjection, const glm::vec3 &cameraPos, const Frustum &frustum);
+        // Conservative, bounds crossing the near plane or outside the screen are never occluded
+        bool isOccluded(const AABB &worldBounds) const;
+
+        // Fastest backend the CPU supports unless a slower one is requested
+        void setBackend(OcclusionBackend backend);
+        OcclusionBackend getBackend() const { return m_Backend; }
+        static OcclusionBackend getSupportedBackend();
+        static const char *getBackendName(OcclusionBackend backend);
+
+        // Triangle list of a box, for meshes whose bounds are solid enough to occlude as a box
+        static std::vector<glm::vec3> boxTriangles(const AABB &bounds);
+
+        const float *getDepth() const { return m_HiZ.data(); } // Level 0, row 0 at the bottom, 1 = no occluder
+
+        // ---- Statistics Methods ----
+        int getOccluderCount() const { return m_OccluderCount; }
+        int getTriangleCount() const { return m_TriangleCount; }
+
+    private:
+        struct Candidate
+        {
+            const Mesh *mesh = nullptr;
+            float score = 0.0f; // Squared bounds radius over squared distance, larger on screen first
+        };
+
+        void rasterize(const glm::mat4 &model, std::span<const glm::vec3> triangles);
+        void buildHiZ();
+        float *getLevel(int level) { return m_HiZ.data() + m_LevelOffsets[level]; }
+        const float *getLevel(int level) const { return m_HiZ.data() + m_LevelOffsets[level]; }
+
+        OcclusionBackend m_Backend = OcclusionBackend::Scalar;
+        glm::mat4 m_ViewProjection = glm::mat4(1.0f);
+        bool m_Ready = false;
+
+        std::vector<float> m_HiZ; // Every level back to back, level 0 is the rasterized depth
+        std::vector<size_t> m_LevelOffsets;
+        std::vector<Candidate> m_Candidates;
+        std::vector<glm::vec4> m_Clip;
+
+        int m_OccluderCount = 0;
+        int m_TriangleCount = 0;
+    };
+}
@@ -0,0 +1,123 @@
+#include "OcclusionQueries.h"
+#include <algorithm>
+
+namespace Prepath
+{
+    OcclusionQueries::~OcclusionQueries()
+    {
+        if (!m_Pool.empty())
+            glDeleteQueries(GLsizei(m_Pool.size()), m_Pool.data());
+    }
+
+    GLenum OcclusionQueries::getTarget()
+    {
+        return GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_ES3_compatibility ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+    }
+
+    GLuint OcclusionQueries::acquire()
+    {
+        if (m_Free.empty())
+        {
+            // Grow in blocks, the pool is sized by the meshes actually tested rather than the whole scene
+            size_t count = std::max(m_Pool.size(), size_t(64));
+            size_t first = m_Pool.size();
+            m_Pool.resize(first + count);
+            glGenQueries(GLsizei(count), m_Pool.data() + first);
+            m_Free.insert(m_Free.end(), m_Pool.begin() + first, m_Pool.end());
+        }
+        GLuint query = m_Free.back();
+        m_Free.pop_back();
+        return query;
+    }
+
+    void OcclusionQueries::resolve()
+    {
+        m_Frame++;
+        m_IssuedCount = 0;
+        m_PendingCount = 0;
+        for (auto it = m_Meshes.begin(); it != m_Meshes.end();)
+        {
+            MeshQuery &state = it->second;
+            if (state.pending)
+            {
+                GLuint available = 0;
+                glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint samples = 0;
+                    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &samples);
+                    state.occluded = samples == 0;
+                    state.pending = false;
+                }
+                else
+                {
+                    m_PendingCount++;
+                }
+            }
+
+            if (!state.pending && m_Frame - state.lastUsed > PREPATH_QUERY_EVICT_FRAMES)
+            {
+                if (state.query)
+                    m_Free.push_back(state.query);
+                it = m_Meshes.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void OcclusionQueries::reset()
+    {
+        m_Meshes.clear();
+        m_Free = m_Pool;
+        m_PendingCount = 0;
+    }
+
+    bool OcclusionQueries::isOccluded(const Mesh *mesh) const
+    {
+        auto it = m_Meshes.find(mesh);
+        return it != m_Meshes.end() && it->second.occluded;
+    }
+
+    GLuint OcclusionQueries::getQuery(const Mesh *mesh) const
+    {
+        auto it = m_Meshes.find(mesh);
+        return it != m_Meshes.end() ? it->second.query : 0;
+    }
+
+    bool OcclusionQueries::beginQuery(const Mesh *mesh)
+    {
+        MeshQuery &state = m_Meshes[mesh];
+        state.lastUsed = m_Frame;
+        if (state.pending)
+            return false;
+
+        if (!state.query)
+            state.query = acquire();
+        glBeginQuery(getTarget(), state.query);
+        state.pending = true;
+        m_IssuedCount++;
+        return true;
+    }
+
+    void OcclusionQueries::endQuery()
+    {
+        glEndQuery(getTarget());
+    }
+
+    void OcclusionQueries::markVisible(const Mesh *mesh)
+    {
+        MeshQuery &state = m_Meshes[mesh];
+        state.lastUsed = m_Frame;
+        if (state.pending)
+            return;
+
+        // The old result would still drive conditional rendering, so the query goes back to the pool
+        state.occluded = false;
+        if (state.query)
+            m_Free.push_back(state.query);
+        state.query = 0;
+    }
+}
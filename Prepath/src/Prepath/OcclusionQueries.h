@@ -0,0 +1,66 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "Mesh.h"
+
+#define PREPATH_QUERY_EVICT_FRAMES (120) // Queries of meshes not tested for this long go back to the pool
+
+namespace Prepath
+{
+    // Hardware occlusion queries against mesh bounds. Every mesh owns at most one query from a shared pool and
+    // is only tested again once its previous result arrived, so results trail the frame by the GPU latency and
+    // reading them back never waits.
+    class OcclusionQueries
+    {
+    public:
+        OcclusionQueries() = default;
+        ~OcclusionQueries();
+
+        OcclusionQueries(const OcclusionQueries &) = delete;
+        OcclusionQueries &operator=(const OcclusionQueries &) = delete;
+
+        // Collects finished results and recycles stale queries, call once per frame before the camera passes
+        void resolve();
+        // Returns every query to the pool and forgets all results
+        void reset();
+
+        // Last result of the mesh, false until a query on it finished
+        bool isOccluded(const Mesh *mesh) const;
+        // Query last issued for the mesh, 0 when none, for glBeginConditionalRender
+        GLuint getQuery(const Mesh *mesh) const;
+        // Starts a query unless one is still in flight for the mesh, end it with endQuery after drawing its bounds
+        bool beginQuery(const Mesh *mesh);
+        void endQuery();
+        // Meshes the bounds test can't judge, e.g. with the camera inside, count as visible
+        void markVisible(const Mesh *mesh);
+
+        // ANY_SAMPLES_PASSED_CONSERVATIVE on GL 4.3, ANY_SAMPLES_PASSED otherwise
+        static GLenum getTarget();
+
+        // ---- Statistics Methods ----
+        int getIssuedCount() const { return m_IssuedCount; }
+        int getPendingCount() const { return m_PendingCount; }
+        int getPoolSize() const { return int(m_Pool.size()); }
+
+    private:
+        struct MeshQuery
+        {
+            GLuint query = 0;
+            bool pending = false;
+            bool occluded = false;
+            uint64_t lastUsed = 0;
+        };
+
+        GLuint acquire();
+
+        uint64_t m_Frame = 0;
+        std::unordered_map<const Mesh *, MeshQuery> m_Meshes;
+        std::vector<GLuint> m_Pool;     // Every query ever created
+        std::vector<GLuint> m_Free;
+
+        int m_IssuedCount = 0;
+        int m_PendingCount = 0;
+    };
+}
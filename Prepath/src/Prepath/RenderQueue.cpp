@@ -0,0 +1,112 @@
+#include "RenderQueue.h"
+#include "Hash.h"
+#include <cstring>
+
+namespace Prepath
+{
+    namespace
+    {
+        // The last value of a field is shared by every key that arrives once the others are taken, and never stored
+        template <typename Key>
+        uint32_t assignID(std::unordered_map<Key, uint32_t> &ids, const Key &key, int bits)
+        {
+            uint32_t shared = (uint32_t(1) << bits) - 1;
+            auto it = ids.find(key);
+            if (it != ids.end())
+                return it->second;
+            if (ids.size() >= shared)
+                return shared;
+            return ids.emplace(key, uint32_t(ids.size())).first->second;
+        }
+    }
+
+    void RenderQueue::clear()
+    {
+        m_Items.clear();
+        if (m_ShaderIDs.size() >= (size_t(1) << PREPATH_KEY_SHADER_BITS) - 1)
+            m_ShaderIDs.clear();
+        if (m_MaterialIDs.size() >= (size_t(1) << PREPATH_KEY_MATERIAL_BITS) - 1)
+            m_MaterialIDs.clear();
+        if (m_TextureSetIDs.size() >= (size_t(1) << PREPATH_KEY_TEXTURES_BITS) - 1)
+            m_TextureSetIDs.clear();
+    }
+
+    uint32_t RenderQueue::quantizeDepth(float depth)
+    {
+        // Positive floats order like their bit patterns, keep sign-free exponent and top mantissa bits
+        if (!(depth > 0.0f))
+            return 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - PREPATH_KEY_DEPTH_BITS);
+    }
+
+    uint32_t RenderQueue::getShaderID(const Shader *shader)
+    {
+        return assignID(m_ShaderIDs, shader, PREPATH_KEY_SHADER_BITS);
+    }
+
+    uint32_t RenderQueue::getMaterialID(const Material *material)
+    {
+        return assignID(m_MaterialIDs, material, PREPATH_KEY_MATERIAL_BITS);
+    }
+
+    uint32_t RenderQueue::getTextureSetID(const Material *material)
+    {
+        if (!material)
+            return 0;
+
+        // Keyed by the bound texture names
+        const std::shared_ptr<Texture> *slots[5] = {&material->albedo, &material->normal, &material->roughness, &material->metal, &material->ao};
+        unsigned int names[5];
+        for (int i = 0; i < 5; ++i)
+            names[i] = *slots[i] ? (*slots[i])->getID() : 0;
+        uint64_t hash = hashBytes(PREPATH_HASH_SEED, names, sizeof(names));
+
+        return assignID(m_TextureSetIDs, hash, PREPATH_KEY_TEXTURES_BITS);
+    }
+
+    void RenderQueue::push(Mesh *mesh, RenderPass pass, Shader *shader, float depth, uint32_t layerMask)
+    {
+        const Material *material = mesh->material.get();
+
+        uint64_t key = 0;
+        key |= uint64_t(pass) << PREPATH_KEY_PASS_SHIFT;
+        key |= uint64_t(getShaderID(shader)) << PREPATH_KEY_SHADER_SHIFT;
+        if (pass == RenderPass::Opaque) // Depth-only passes are untextured and sorted strictly front to back
+        {
+            key |= uint64_t(getMaterialID(material)) << PREPATH_KEY_MATERIAL_SHIFT;
+            key |= uint64_t(getTextureSetID(material)) << PREPATH_KEY_TEXTURES_SHIFT;
+        }
+        key |= uint64_t(quantizeDepth(depth)) << PREPATH_KEY_DEPTH_SHIFT;
+        m_Items.push_back({key, mesh, shader, layerMask});
+    }
+
+    void RenderQueue::sort()
+    {
+        if (m_Items.size() < 2)
+            return;
+
+        // Bits that differ anywhere in the queue, digits without any are skipped
+        uint64_t first = m_Items[0].key;
+        uint64_t varying = 0;
+        for (const auto &item : m_Items)
+            varying |= item.key ^ first;
+
+        m_Scratch.resize(m_Items.size());
+        for (int shift = 0; shift < 64; shift += 16)
+        {
+            if (((varying >> shift) & 0xFFFF) == 0)
+                continue;
+
+            m_Offsets.assign(65536 + 1, 0);
+            for (const auto &item : m_Items)
+                m_Offsets[((item.key >> shift) & 0xFFFF) + 1]++;
+            for (size_t i = 1; i < m_Offsets.size(); ++i)
+                m_Offsets[i] += m_Offsets[i - 1];
+            for (const auto &item : m_Items)
+                m_Scratch[m_Offsets[(item.key >> shift) & 0xFFFF]++] = item;
+            m_Items.swap(m_Scratch);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Material.h"
+
+// Sort key layout, most significant first: pass | shader | material | texture set | depth
+#define PREPATH_KEY_PASS_BITS (4)
+#define PREPATH_KEY_SHADER_BITS (8)
+#define PREPATH_KEY_MATERIAL_BITS (16)
+#define PREPATH_KEY_TEXTURES_BITS (16)
+#define PREPATH_KEY_DEPTH_BITS (20)
+
+#define PREPATH_KEY_DEPTH_SHIFT (0)
+#define PREPATH_KEY_TEXTURES_SHIFT (PREPATH_KEY_DEPTH_SHIFT + PREPATH_KEY_DEPTH_BITS)
+#define PREPATH_KEY_MATERIAL_SHIFT (PREPATH_KEY_TEXTURES_SHIFT + PREPATH_KEY_TEXTURES_BITS)
+#define PREPATH_KEY_SHADER_SHIFT (PREPATH_KEY_MATERIAL_SHIFT + PREPATH_KEY_MATERIAL_BITS)
+#define PREPATH_KEY_PASS_SHIFT (PREPATH_KEY_SHADER_SHIFT + PREPATH_KEY_SHADER_BITS)
+
+namespace Prepath
+{
+    enum class RenderPass : uint8_t
+    {
+        Shadow = 0,
+        PointShadow = 1,
+        Opaque = 2,
+        DepthPrepass = 3
+    };
+
+    struct RenderItem
+    {
+        uint64_t key = 0;
+        Mesh *mesh = nullptr;
+        Shader *shader = nullptr;  // Program or permutation variant the draw is submitted with
+        uint32_t layerMask = 0x3F; // Cubemap faces the mesh touches (point light shadows)
+    };
+
+    class RenderQueue
+    {
+    public:
+        // ---- Queue Methods ----
+        // Ids are only recycled here, so every key of one queue names a single shader, material and texture set
+        void clear();
+        // depth is the non-negative distance from the viewer, nearer draws sort first
+        void push(Mesh *mesh, RenderPass pass, Shader *shader, float depth, uint32_t layerMask = 0x3F);
+        // LSD radix sort on the keys, skips digits that are equal across the whole queue
+        void sort();
+
+        const std::vector<RenderItem> &getItems() const { return m_Items; }
+        size_t size() const { return m_Items.size(); }
+
+        // ---- Key Methods ----
+        static uint64_t getField(uint64_t key, int shift, int bits) { return (key >> shift) & ((uint64_t(1) << bits) - 1); }
+        static uint64_t getMaterialBits(uint64_t key) { return getField(key, PREPATH_KEY_MATERIAL_SHIFT, PREPATH_KEY_MATERIAL_BITS); }
+        static uint64_t getTextureBits(uint64_t key) { return getField(key, PREPATH_KEY_TEXTURES_SHIFT, PREPATH_KEY_TEXTURES_BITS); }
+        static uint64_t getShaderBits(uint64_t key) { return getField(key, PREPATH_KEY_SHADER_SHIFT, PREPATH_KEY_SHADER_BITS); }
+        static uint32_t quantizeDepth(float depth);
+        // Field value shared by everything pushed after the field ran out of ids, binds must not be elided on it
+        static bool isSharedTextureBits(uint64_t bits) { return bits == (uint64_t(1) << PREPATH_KEY_TEXTURES_BITS) - 1; }
+
+    private:
+        // Ids stay stable across frames so keys (and the sort) are coherent frame to frame
+        uint32_t getShaderID(const Shader *shader);
+        uint32_t getMaterialID(const Material *material);
+        uint32_t getTextureSetID(const Material *material);
+
+        std::vector<RenderItem> m_Items;
+        std::vector<RenderItem> m_Scratch;
+        std::vector<uint32_t> m_Offsets;
+        std::unordered_map<const Shader *, uint32_t> m_ShaderIDs;
+        std::unordered_map<const Material *, uint32_t> m_MaterialIDs;
+        std::unordered_map<uint64_t, uint32_t> m_TextureSetIDs;
+    };
+}
@@ -5,20 +5,98 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
 #include <string>
+#include <cmath>
+#include <bit>
+#include <cstring>
+#include <algorithm>
 
 namespace Prepath
 {
+    namespace
+    {
+        // ---- Pipeline States ----
+        constexpr PipelineState DEFAULT_STATE = {.blend = true}; // Left set for gizmos and UI drawn after render()
+        constexpr PipelineState DIRECTIONAL_SHADOW_STATE = {.cull = true, .cullFace = GL_FRONT};
+        constexpr PipelineState POINT_SHADOW_STATE = {};
+        constexpr PipelineState FEEDBACK_STATE = {};
+        constexpr PipelineState BOUNDS_STATE = {.depthTest = false, .blend = true, .polygonMode = GL_LINE};
+        constexpr PipelineState SKYBOX_STATE = {.depthWrite = false, .depthFunc = GL_LEQUAL, .blend = true};
+        constexpr PipelineState GIZMO_STATE = {.depthTest = false, .blend = true};
+        constexpr PipelineState GIZMO_SPHERE_STATE = {.blend = true, .polygonMode = GL_LINE};
+        constexpr PipelineState DEFERRED_DIRECTIONAL_STATE = {.depthTest = false};
+        constexpr PipelineState DEFERRED_VOLUME_STATE = {.depthTest = false, .blend = true, .blendSrc = GL_ONE, .blendDst = GL_ONE, .cull = true, .cullFace = GL_FRONT};
+        constexpr PipelineState DEFERRED_COMPOSITE_STATE = {.depthFunc = GL_ALWAYS}; // Writes the G-buffer depth back
+        constexpr PipelineState OCCLUSION_QUERY_STATE = {.depthWrite = false, .depthFunc = GL_LEQUAL, .colorWrite = false};
+
+        // Unit cube (m_BoundsMesh) stretched over the box
+        glm::mat4 boxModel(const AABB &bounds)
+        {
+            return glm::translate(glm::mat4(1.0f), (bounds.min + bounds.max) * 0.5f) * glm::scale(glm::mat4(1.0f), bounds.max - bounds.min);
+        }
+
+        // ---- Pass Traits ----
+        // What a renderScene pass submits besides geometry, fixed per instantiation so depth-only passes
+        // carry no per-draw material branches at all
+        struct MaterialPassTraits
+        {
+            static constexpr bool materials = true;   // Textures, tint, virtual texture mask and normal matrix per draw
+            static constexpr bool colorOutput = true; // Clears color along with depth
+            static constexpr bool drawQueries = true; // Conditional render and per-draw timings
+        };
+
+        struct DepthPassTraits
+        {
+            static constexpr bool materials = false;
+            static constexpr bool colorOutput = false;
+            static constexpr bool drawQueries = false;
+        };
+
+        // Sky light and image based ambient are compiled into the lit shaders instead of branching on uniforms
+        uint32_t lightingFeatures(const Scene &scene, bool ibl)
+        {
+            return (scene.hasSkyLight ? PREPATH_SHADER_SKY_LIGHT : 0u) | (ibl ? PREPATH_SHADER_IBL : 0u);
+        }
+
+        // Dual-paraboloid hemispheres the bounds reach, split at the light's z like pointlight_paraboloid.vert
+        uint32_t hemisphereMask(const glm::vec3 &lightPos, const AABB &bounds)
+        {
+            return (bounds.max.z >= lightPos.z ? 1u : 0u) | (bounds.min.z <= lightPos.z ? 2u : 0u);
+        }
+    }
+
     Renderer::Renderer()
     {
         unsigned char whiteData[3] = {255, 255, 255}; // white
         m_WhiteTex = Texture::generateTexture(whiteData, 1, 1, 3);
 
-        m_Shader = PREPATH_GENERATE_SHADERVF("default.vert", "default.frag");
-        m_DirectionalLightShader = PREPATH_GENERATE_SHADERVF("depth.vert", "depth.frag");
-        m_PointLightShader = PREPATH_GENERATE_SHADERVGF("pointlight.vert", "pointlight.geom", "pointlight.frag");
-        m_BoundsShader = PREPATH_GENERATE_SHADERVF("bounds.vert", "bounds.frag");
-        m_SkyboxShader = PREPATH_GENERATE_SHADERVF("skybox.vert", "skybox.frag");
-        m_GizmoShader = PREPATH_GENERATE_SHADERVF("gizmo.vert", "gizmo.frag");
+        m_Shader = PREPATH_GENERATE_SHADERVF_ASYNC("default.vert", "default.frag");
+        m_DirectionalLightShader = PREPATH_GENERATE_SHADERVF_ASYNC("depth.vert", "depth.frag");
+        m_DepthPrepassShader = PREPATH_GENERATE_SHADERVF_ASYNC("prepass.vert", "depth.frag");
+        m_PointLightShader = PREPATH_GENERATE_SHADERVGF_ASYNC("pointlight.vert", "pointlight.geom", "pointlight.frag");
+        m_PointLightFaceShader = PREPATH_GENERATE_SHADERVF_ASYNC("pointlight_face.vert", "pointlight.frag");
+        m_PointLightParaboloidShader = PREPATH_GENERATE_SHADERVF_ASYNC("pointlight_paraboloid.vert", "pointlight.frag");
+        m_BoundsShader = PREPATH_GENERATE_SHADERVF_ASYNC("bounds.vert", "bounds.frag");
+        m_SkyboxShader = PREPATH_GENERATE_SHADERVF_ASYNC("skybox.vert", "skybox.frag");
+        m_GizmoShader = PREPATH_GENERATE_SHADERVF_ASYNC("gizmo.vert", "gizmo.frag");
+        m_FeedbackShader = PREPATH_GENERATE_SHADERVF_ASYNC("feedback.vert", "feedback.frag");
+        m_GBufferShader = PREPATH_GENERATE_SHADERVF_ASYNC("default.vert", "gbuffer.frag");
+        m_DeferredDirectionalShader = PREPATH_GENERATE_SHADERVF_ASYNC("deferred.vert", "deferred_directional.frag");
+        m_DeferredPointLightShader = PREPATH_GENERATE_SHADERVF_ASYNC("deferred_pointlight.vert", "deferred_pointlight.frag");
+        m_DeferredCompositeShader = PREPATH_GENERATE_SHADERVF_ASYNC("deferred.vert", "deferred_composite.frag");
+
+        // ---- Shader Warmup ----
+        // Material permutations are submitted with the passes so the driver builds them all in parallel,
+        // debug views are left to the first frame that asks for them
+        const uint32_t materialFeatures[] = {0, PREPATH_SHADER_NORMAL_MAP, PREPATH_SHADER_ORM_MAPS, PREPATH_SHADER_NORMAL_MAP | PREPATH_SHADER_ORM_MAPS};
+        const uint32_t lighting[] = {0, PREPATH_SHADER_SKY_LIGHT, PREPATH_SHADER_IBL, PREPATH_SHADER_SKY_LIGHT | PREPATH_SHADER_IBL};
+        for (uint32_t features : materialFeatures)
+        {
+            for (uint32_t light : lighting)
+                m_Shader->submitVariant(features | light);
+            m_GBufferShader->submitVariant(features);
+        }
+        for (uint32_t light : lighting)
+            m_DeferredDirectionalShader->submitVariant(light);
 
         m_BoundsMesh = Mesh::generateCube(0.5f);
         m_SkyboxMesh = Mesh::generateCube(1.0f);
@@ -54,93 +132,194 @@ namespace Prepath
 
         glGenFramebuffers(1, &m_DepthFBO);
         glGenTextures(1, &m_DepthTex);
-        glBindTexture(GL_TEXTURE_2D, m_DepthTex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-                     PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_DepthTex);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24,
+                     PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE, PREPATH_CSM_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float borderColor[] = {1.0f, 1.0f, 1.0f, 1.0f}; // Outside a cascade = unshadowed
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
 
         glBindFramebuffer(GL_FRAMEBUFFER, m_DepthFBO);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthTex, 0);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTex, 0, 0);
         glDrawBuffer(GL_NONE);
         glReadBuffer(GL_NONE);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // Prefiltered specular mips are sampled across face edges
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        glGenQueries(1, &m_OverdrawQuery);
+
+        // Instanced draws only need texture buffers (GL 3.1), multi-draw indirect adds the command buffer
+        glGenBuffers(1, &m_ObjectDataBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_ObjectDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(ObjectUniforms), nullptr, GL_STREAM_DRAW);
+        glGenTextures(1, &m_ObjectDataTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, m_ObjectDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32I, m_ObjectDataBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        if (MeshArena::supportsIndirect())
+        {
+            glGenBuffers(1, &m_IndirectBuffer);
+        }
+        else
+        {
+            PREPATH_LOG_INFO("Multi-draw indirect unavailable, drawing one mesh per call");
+        }
+
+        m_ViewportArrays = GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_viewport_array;
+        m_VertexViewportIndex = m_ViewportArrays && (GLAD_GL_ARB_shader_viewport_layer_array || GLAD_GL_AMD_vertex_shader_viewport_index);
+        if (!m_VertexViewportIndex)
+            PREPATH_LOG_INFO("Vertex shader viewport index unavailable, point shadows render one face per pass");
     }
 
     Renderer::~Renderer()
     {
+        if (m_FeedbackFBO)
+        {
+            glDeleteFramebuffers(1, &m_FeedbackFBO);
+            glDeleteTextures(1, &m_FeedbackColor);
+            glDeleteRenderbuffers(1, &m_FeedbackDepth);
+            glDeleteBuffers(PREPATH_VT_FEEDBACK_READBACKS, m_FeedbackReadbacks.data());
+        }
+        for (GLsync fence : m_FeedbackFences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        if (m_GBufferFBO)
+        {
+            GLuint framebuffers[2] = {m_GBufferFBO, m_LightingFBO};
+            GLuint textures[5] = {m_GBufferAlbedo, m_GBufferNormal, m_GBufferORM, m_GBufferDepth, m_LightingTex};
+            glDeleteFramebuffers(2, framebuffers);
+            glDeleteTextures(5, textures);
+        }
+        if (m_IndirectBuffer)
+            glDeleteBuffers(1, &m_IndirectBuffer);
+        glDeleteBuffers(1, &m_ObjectDataBuffer);
+        glDeleteTextures(1, &m_ObjectDataTexture);
+        glDeleteQueries(1, &m_OverdrawQuery);
     }
 
     void Renderer::renderGizmo(std::shared_ptr<Texture> texture, const glm::vec3 &position, const glm::vec3 &tint)
     {
-        glDisable(GL_DEPTH_TEST);
-        glm::mat4 view = m_LastView;
-        glm::mat4 projection = m_LastProjection;
+        renderGizmos(texture, std::span(&position, 1), std::span(&tint, 1));
+    }
 
-        glm::mat4 rotationOnly = view;
+    void Renderer::renderGizmos(std::shared_ptr<Texture> texture, std::span<const glm::vec3> positions, std::span<const glm::vec3> tints)
+    {
+        if (!m_ShadersReady)
+            return;
+        auto &state = GLState::getGlobalState();
+        state.apply(GIZMO_STATE);
+
+        glm::mat4 rotationOnly = m_LastView;
         rotationOnly[3] = glm::vec4(0, 0, 0, 1);
 
         glm::mat4 billboardRotation = glm::inverse(rotationOnly);
 
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), position) * billboardRotation;
-        model = glm::scale(model, glm::vec3(0.5f));
+        m_ImmediateObjects.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            ObjectUniforms &object = m_ImmediateObjects[i];
+            object.model = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]) * billboardRotation, glm::vec3(0.5f));
+            object.tint = glm::vec4(i < tints.size() ? tints[i] : glm::vec3(1.0f), 1.0f);
+        }
 
+        GPUScope scope(m_Profiler, "Gizmos");
         m_GizmoShader->bind();
-        m_GizmoShader->setUniformMat4f("uView", view);
-        m_GizmoShader->setUniformMat4f("uProjection", projection);
-        m_GizmoShader->setUniformMat4f("uModel", model);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture->getID());
+        state.bindTexture(0, GL_TEXTURE_2D, texture->getID());
         m_GizmoShader->setUniform1i("uTexture", 0);
-        m_GizmoShader->setUniform3f("uTint", tint);
-
-        m_GizmoMesh->draw();
-
-        m_Statistics.drawCallCount += m_GizmoMesh->getDrawCallCount();
-        m_Statistics.triangleCount += m_GizmoMesh->getTriangleCount();
-        m_Statistics.vertexCount += m_GizmoMesh->getVertexCount();
-        glEnable(GL_DEPTH_TEST);
+        drawObjects(m_GizmoShader, *m_GizmoMesh, m_ImmediateObjects);
     }
 
     void Renderer::renderGizmoSphere(const glm::vec3 &position, const float &size, const glm::vec3 &tint)
     {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-        glm::mat4 view = m_LastView;
-        glm::mat4 projection = m_LastProjection;
+        if (!m_ShadersReady)
+            return;
+        auto &state = GLState::getGlobalState();
+        state.apply(GIZMO_SPHERE_STATE);
 
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
-        model = glm::scale(model, glm::vec3(size));
+        m_ImmediateObjects.assign(1, ObjectUniforms());
+        m_ImmediateObjects[0].model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(size));
+        m_ImmediateObjects[0].tint = glm::vec4(tint, 1.0f);
 
+        GPUScope scope(m_Profiler, "Gizmos");
         m_GizmoShader->bind();
-        m_GizmoShader->setUniformMat4f("uView", view);
-        m_GizmoShader->setUniformMat4f("uProjection", projection);
-        m_GizmoShader->setUniformMat4f("uModel", model);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_WhiteTex->getID());
+        state.bindTexture(0, GL_TEXTURE_2D, m_WhiteTex->getID());
         m_GizmoShader->setUniform1i("uTexture", 0);
-        m_GizmoShader->setUniform3f("uTint", tint);
+        drawObjects(m_GizmoShader, *m_SphereMesh, m_ImmediateObjects);
+    }
 
-        m_SphereMesh->draw();
+    void Renderer::submitInstanced(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, std::span<const glm::mat4> transforms)
+    {
+        if (!mesh || transforms.empty())
+            return;
 
-        m_Statistics.drawCallCount += m_GizmoMesh->getDrawCallCount();
-        m_Statistics.triangleCount += m_GizmoMesh->getTriangleCount();
-        m_Statistics.vertexCount += m_GizmoMesh->getVertexCount();
+        InstanceBatch batch;
+        batch.mesh = std::move(mesh);
+        batch.material = std::move(material);
+        batch.first = m_InstanceTransforms.size();
+        batch.count = transforms.size();
+        m_InstanceTransforms.insert(m_InstanceTransforms.end(), transforms.begin(), transforms.end());
+        m_InstanceBatches.push_back(std::move(batch));
+    }
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    void Renderer::uploadObjectData(const std::vector<ObjectUniforms> &objects)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_ObjectDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(objects.size(), size_t(1)) * sizeof(ObjectUniforms), objects.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        GLState::getGlobalState().bindTexture(12, GL_TEXTURE_BUFFER, m_ObjectDataTexture);
+    }
+
+    void Renderer::drawObjects(const std::shared_ptr<Shader> &shader, const Mesh &mesh, const std::vector<ObjectUniforms> &objects)
+    {
+        if (objects.empty())
+            return;
+
+        uploadObjectData(objects);
+        shader->setUniform1i("uObjectData", 12);
+        shader->setUniform1i("uUseObjectData", 1);
+        shader->setUniform1i("uObjectBase", 0);
+        MeshArena::getGlobalArena().reserveDrawIDs(objects.size());
+        mesh.drawInstanced(GLsizei(objects.size()));
+
+        m_Statistics.drawCallCount += mesh.getDrawCallCount();
+        m_Statistics.triangleCount += mesh.getTriangleCount() * int(objects.size());
+        m_Statistics.vertexCount += mesh.getVertexCount() * int(objects.size());
     }
 
     void Renderer::render(const Scene &scene, const RenderSettings &settings)
     {
-        // Depth
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
+        // Anything outside the renderer may have touched the context since the last frame
+        auto &state = GLState::getGlobalState();
+        state.invalidate();
+        state.resetStatistics();
+
+        // ---- Shader Warmup ----
+        // Frames are only cleared until every pass program has linked, permutations fall back to the base program instead
+        if (!updateShaderWarmup())
+        {
+            state.apply(DEFAULT_STATE);
+            state.bindFramebuffer(0);
+            state.viewport(0, 0, settings.width, settings.height);
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            m_InstanceBatches.clear();
+            m_InstanceTransforms.clear();
+            return;
+        }
 
-        // Blending
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // Collects timings of earlier frames, gizmos drawn after the last render() still count towards that frame
+        m_Profiler.setEnabled(settings.gpuTiming);
+        m_Profiler.setDrawSampling(settings.perDrawTiming);
+        m_Profiler.beginFrame();
 
         glm::mat4 view = settings.cam.getViewMatrix();
         glm::mat4 projection = settings.cam.getProjectionMatrix(float(settings.width) / settings.height);
@@ -148,9 +327,46 @@ namespace Prepath
         m_LastView = view;
         m_LastProjection = projection;
 
+        m_Statistics.drawCallCount = 0;
+        m_Statistics.triangleCount = 0;
+        m_Statistics.vertexCount = 0;
+        m_Statistics.stateChanges = 0;
+        m_Statistics.stateChangesAvoided = 0;
+        m_Statistics.uniformBlockBinds = 0;
+        m_Statistics.submitCalls = 0;
+        m_Statistics.visibleMeshes = 0;
+        m_Statistics.culledMeshes = 0;
+        m_Statistics.shadowVisibleMeshes = 0;
+        m_Statistics.shadowCulledMeshes = 0;
+        m_Statistics.visibleInstances = 0;
+        m_Statistics.culledInstances = 0;
+        m_Statistics.occludedMeshes = 0;
+        m_Statistics.queryOccludedMeshes = 0;
+        m_Statistics.pointLights.assign(scene.getPointLights().size(), PointLightStatistics());
+        // Sampled draws need their own timestamps, so those frames go through the per-draw loop
+        m_MultiDrawIndirect = settings.multiDrawIndirect && m_IndirectBuffer != 0 && !m_Profiler.isSamplingDraws();
+
+        // ---- VIRTUAL TEXTURES ----
+        auto &virtualTextures = VirtualTextureCache::getGlobalCache();
+        if (virtualTextures.hasTextures())
+        {
+            virtualTextures.update();
+            state.invalidate(); // Page uploads bind textures directly
+            GPUScope scope(m_Profiler, "VT Feedback");
+            renderVirtualTextureFeedback(scene, projection, view, settings);
+            m_Statistics.virtualPagesResident = virtualTextures.getResidentPageCount();
+            m_Statistics.virtualPagesPending = virtualTextures.getPendingPageCount();
+            m_Statistics.virtualPagesUploaded = virtualTextures.getUploadedPageCount();
+        }
+
+        {
+            GPUScope scope(m_Profiler, "Image Based Lighting");
+            updateImageBasedLighting(scene, settings);
+        }
+
         AABB worldBounds = scene.bounds; // Assuming scene has overall bounds
 
-        // Calculate light space matrix based on scene bounds
+        // Eye used to sort directional shadow casters
         glm::vec3 sceneCenter = (worldBounds.min + worldBounds.max) * 0.5f;
         glm::vec3 sceneSize = worldBounds.max - worldBounds.min;
 
@@ -158,195 +374,1362 @@ namespace Prepath
         float lightDistance = glm::length(sceneSize) * 0.5f; // Distance from scene center
         glm::vec3 lightPos = sceneCenter + glm::normalize(scene.lightDir) * lightDistance;
 
-        glm::mat4 lightView = glm::lookAt(lightPos,
-                                          sceneCenter, // Look at scene center
-                                          glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum cameraFrustum(projection * view);
 
-        // Create orthographic projection that encompasses the entire scene
-        float maxExtent = glm::max(glm::max(sceneSize.x, sceneSize.y), sceneSize.z) * 0.5f;
-        float padding = maxExtent * 0.1f; // 10% padding to avoid edge artifacts
-        float orthoSize = maxExtent + padding;
+        // Moved atlas tiles mark their lights dirty, so this runs before the scheduler
+        m_PointShadows = settings.pointShadows;
+        m_PointShadowPath = settings.pointShadowPath;
+        if (m_PointShadowPath == PointShadowPath::Auto)
+            m_PointShadowPath = m_VertexViewportIndex ? PointShadowPath::VertexLayer : PointShadowPath::SingleFace;
+        if ((m_PointShadowPath == PointShadowPath::VertexLayer && !m_VertexViewportIndex) ||
+            (m_PointShadowPath == PointShadowPath::GeometryShader && !m_ViewportArrays))
+            m_PointShadowPath = PointShadowPath::SingleFace;
+        m_Statistics.pointShadowPath = m_PointShadowPath;
+        updateShadowAtlas(scene, settings, projection, settings.cam.Position, cameraFrustum);
 
-        float near_plane = 0.1f;
-        float far_plane = lightDistance + maxExtent + padding;
+        // Cascades follow the camera, a changed fit means the directional map has to be redrawn
+        if (updateCascades(scene, settings, projection, view))
+            m_ShadowScheduler.invalidateDirectional();
+        if (!settings.shadowCaching)
+            m_ShadowScheduler.invalidate();
+        for (const InstanceBatch &batch : m_InstanceBatches)
+            m_ShadowScheduler.trackInstances(batch.mesh.get(), std::span(m_InstanceTransforms).subspan(batch.first, batch.count));
+        m_ShadowScheduler.update(scene, cameraFrustum, settings.cam.Position, settings.shadowCaching ? settings.shadowUpdateBudget : -1);
+        m_Statistics.shadowMapsRefreshed = m_ShadowScheduler.getRefreshedCount();
+        m_Statistics.shadowMapsReused = m_ShadowScheduler.getReusedCount();
+        m_Statistics.shadowMapsDeferred = m_ShadowScheduler.getDeferredCount();
 
-        glm::mat4 lightProjection = glm::ortho(-orthoSize, orthoSize,
-                                               -orthoSize, orthoSize,
-                                               near_plane, far_plane);
-        glm::mat4 lightSpaceMatrix = lightProjection * lightView;
+        // ---- Frame Uniforms ----
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+        frame.inverseViewProjection = glm::inverse(frame.viewProjection);
+        frame.cameraPos = settings.cam.Position;
+        frame.lightDir = scene.lightDir;
+        frame.screenSize = glm::vec2(float(settings.width), float(settings.height));
+        m_FrameUniforms.update(frame);
 
         // ---- SHADOWS ----
-        if (scene.hasSkyLight)
+        if (m_ShadowScheduler.shouldRefreshDirectional())
         {
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            glViewport(0, 0, PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE);
-            glBindFramebuffer(GL_FRAMEBUFFER, m_DepthFBO);
-            glClear(GL_DEPTH_BUFFER_BIT);
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_FRONT);
-            glFrontFace(GL_CCW);
-            renderScene(scene, projection, view, lightSpaceMatrix, m_DirectionalLightShader);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            GPUScope scope(m_Profiler, "Directional Shadow");
+            state.apply(DIRECTIONAL_SHADOW_STATE);
+            state.viewport(0, 0, PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE);
+            state.bindFramebuffer(m_DepthFBO);
+            for (int cascade = 0; cascade < PREPATH_CSM_CASCADES; ++cascade)
+            {
+                // Each cascade only draws the casters inside its own light volume
+                GPUScope cascadeScope(m_Profiler, std::format("Cascade {}", cascade));
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTex, 0, cascade);
+                Frustum cascadeFrustum(m_CascadeMatrices[cascade]);
+                renderScene(scene, projection, view, m_CascadeMatrices[cascade], m_DirectionalLightShader, lightPos, 0,
+                            settings.frustumCulling ? &cascadeFrustum : nullptr);
+            }
         }
 
         // ---- Point Lights ----
-        for (auto light : scene.getPointLights())
+        m_Profiler.beginScope("Point Shadows");
+        if (m_PointShadows)
         {
-            float aspect = (float)PREPATH_SHADOWMAP_SIZE / (float)PREPATH_SHADOWMAP_SIZE;
-            float near = 0.1f;
-            float far = light->range;
-            auto pointLightPos = light->position;
-            glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, light->range);
+            state.bindFramebuffer(m_ShadowAtlas.getFramebuffer());
+            for (size_t lightIndex = 0; lightIndex < scene.getPointLights().size(); ++lightIndex)
+            {
+                auto &light = scene.getPointLights()[lightIndex];
+                if (light->hidden || !m_ShadowScheduler.shouldRefreshPointLight(lightIndex))
+                    continue;
 
-            std::vector<glm::mat4> shadowTransforms = {
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(1, 0, 0), glm::vec3(0, -1, 0)),  // +X
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0)), // -X
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 1, 0), glm::vec3(0, 0, 1)),   // +Y
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)), // -Y
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 0, 1), glm::vec3(0, -1, 0)),  // +Z
-                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0))  // -Z
-            };
-            glBindFramebuffer(GL_FRAMEBUFFER, light->m_DepthFramebuffer);
-            auto NULL_MATRIX = glm::mat4(0.0f);
-            m_PointLightShader->bind();
-            m_PointLightShader->setUniformMat4fArray("uShadowMatrices", shadowTransforms);
-            m_PointLightShader->setUniform1f("uRange", light->range);
-            renderScene(scene, NULL_MATRIX, NULL_MATRIX, NULL_MATRIX, m_PointLightShader, light->position, 0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                // Nothing to draw when no face holds casters or the light did not fit
+                const ShadowAtlas::Allocation &allocation = m_ShadowAtlas.getAllocation(lightIndex);
+                if (allocation.faceMask == 0)
+                {
+                    m_ShadowAtlas.markRendered(lightIndex);
+                    continue;
+                }
+
+                GPUScope scope(m_Profiler, std::format("Point Light {}", lightIndex));
+                PipelineState shadowState = POINT_SHADOW_STATE;
+                shadowState.clipDistance0 = allocation.paraboloid;
+                state.apply(shadowState);
+
+                // Only this light's tiles are cleared, the rest of the atlas still holds cached lights
+                auto NULL_MATRIX = glm::mat4(0.0f);
+                PointLightCulling &culling = m_PointLightCulling[lightIndex];
+                // Paraboloid hemispheres are always separate passes, the projection lives in the vertex shader
+                bool singleFace = m_PointShadowPath == PointShadowPath::SingleFace || allocation.paraboloid;
+                std::shared_ptr<Shader> faceShader = allocation.paraboloid ? m_PointLightParaboloidShader : m_PointLightFaceShader;
+                for (int face = 0; face < 6; ++face)
+                {
+                    if ((allocation.faceMask & (1u << face)) == 0)
+                        continue;
+                    const glm::ivec2 &tile = allocation.tiles[face];
+                    if (singleFace)
+                        state.viewport(tile.x, tile.y, allocation.faceSize, allocation.faceSize);
+                    else
+                        state.viewportIndexed(face, tile.x, tile.y, allocation.faceSize, allocation.faceSize);
+                    PipelineState clearState = shadowState;
+                    clearState.scissorTest = true;
+                    clearState.scissor = {tile.x, tile.y, allocation.faceSize, allocation.faceSize};
+                    state.apply(clearState);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                    state.apply(shadowState);
+
+                    // Each face culls against its own frustum only
+                    if (singleFace)
+                    {
+                        culling.face = face;
+                        renderScene(scene, NULL_MATRIX, NULL_MATRIX, NULL_MATRIX, faceShader, light->position, 0,
+                                    nullptr, &culling, 0);
+                    }
+                }
+                culling.face = -1;
+
+                if (!singleFace)
+                {
+                    renderScene(scene, NULL_MATRIX, NULL_MATRIX, NULL_MATRIX,
+                                m_PointShadowPath == PointShadowPath::GeometryShader ? m_PointLightShader : m_PointLightFaceShader,
+                                light->position, 0, nullptr, &culling, 0);
+                }
+                m_ShadowAtlas.markRendered(lightIndex);
+            }
         }
+        m_ShadowAtlas.upload();
+        m_Profiler.endScope();
+
+        // Debug views live in the forward shader
+        bool deferred = settings.deferredShading && settings.showTexture == 0;
+        bool prepass = !deferred && updateDepthPrepass(settings);
+        m_Statistics.depthPrepass = prepass;
+
+        // ---- Light Clusters ----
+        m_ClusteredLighting = settings.clusteredLighting && !deferred;
+        if (m_ClusteredLighting)
+        {
+            // Recover the clip planes from the projection so the grid matches whatever the camera uses
+            float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+            float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+            m_LightClusters.update(scene, view, projection, nearPlane, farPlane);
+            m_Statistics.clusterLights = m_LightClusters.getLightCount();
+            m_Statistics.clusterLightIndices = m_LightClusters.getIndexCount();
+            m_Statistics.clusterMaxLights = m_LightClusters.getMaxLightsPerCluster();
+        }
+        else
+        {
+            m_Statistics.clusterLights = 0;
+            m_Statistics.clusterLightIndices = 0;
+            m_Statistics.clusterMaxLights = 0;
+        }
+
+        // ---- Occlusion ----
+        m_OcclusionCulling = settings.occlusionCulling;
+        if (m_OcclusionCulling)
+            m_OcclusionCuller.update(scene, projection * view, settings.cam.Position, cameraFrustum);
+        m_Statistics.occluders = m_OcclusionCulling ? m_OcclusionCuller.getOccluderCount() : 0;
+        m_Statistics.occluderTriangles = m_OcclusionCulling ? m_OcclusionCuller.getTriangleCount() : 0;
+
+        // ---- Occlusion Queries ----
+        if (settings.occlusionQueries != OcclusionQueryMode::Off)
+            m_OcclusionQueries.resolve();
+        else if (m_OcclusionQueryMode != OcclusionQueryMode::Off)
+            m_OcclusionQueries.reset();
+        m_OcclusionQueryMode = settings.occlusionQueries;
+        // Conditional rendering needs one draw per mesh, and the pre-pass and shaded pass could see different results
+        if (m_OcclusionQueryMode == OcclusionQueryMode::Conditional && (m_MultiDrawIndirect || prepass))
+            m_OcclusionQueryMode = OcclusionQueryMode::LastFrame;
+        m_QueryCandidates.clear();
 
         // ---- SCENE ----
         {
-            if (settings.culling)
+            state.apply({.cull = settings.culling, .polygonMode = GLenum(settings.wireframe ? GL_LINE : GL_FILL)});
+            state.bindFramebuffer(0);
+            state.viewport(0, 0, settings.width, settings.height);
+            if (deferred)
             {
-                glEnable(GL_CULL_FACE);
-                glFrontFace(GL_CCW);
+                GPUScope scope(m_Profiler, "Deferred");
+                renderDeferred(scene, settings, projection, view, cameraFrustum);
             }
             else
             {
-                glDisable(GL_CULL_FACE);
+                GPUScope scope(m_Profiler, "Forward");
+                m_Statistics.lightVolumes = 0;
+                const Frustum *frustum = settings.frustumCulling ? &cameraFrustum : nullptr;
+                PipelineState forwardState = {.cull = settings.culling, .polygonMode = GLenum(settings.wireframe ? GL_LINE : GL_FILL)};
+
+                // Overdraw is sampled on whichever pass lays down depth, a query is only started once the last one was read
+                bool measure = !m_OverdrawQueryPending;
+                if (measure)
+                {
+                    GLint samples = 0;
+                    glGetIntegerv(GL_SAMPLES, &samples);
+                    m_OverdrawPixels = float(settings.width) * float(settings.height) * float(std::max(samples, 1));
+                    glBeginQuery(GL_SAMPLES_PASSED, m_OverdrawQuery);
+                }
+
+                if (prepass)
+                {
+                    // Same vertex transform as default.vert, so the shaded pass can test for equality
+                    PipelineState prepassState = forwardState;
+                    prepassState.colorWrite = false;
+                    state.apply(prepassState);
+                    m_Profiler.beginScope("Depth Pre-Pass");
+                    renderScene(scene, projection, view, m_CascadeMatrices[0], m_DepthPrepassShader, settings.cam.Position, 0,
+                                frustum, nullptr, GL_DEPTH_BUFFER_BIT);
+                    m_Profiler.endScope();
+                    if (measure)
+                        glEndQuery(GL_SAMPLES_PASSED);
+
+                    forwardState.depthWrite = false;
+                    forwardState.depthFunc = GL_EQUAL;
+                    state.apply(forwardState);
+                    GPUScope shadingScope(m_Profiler, "Shading");
+                    renderScene(scene, projection, view, m_CascadeMatrices[0], m_Shader, settings.cam.Position, settings.showTexture,
+                                frustum, nullptr, GL_COLOR_BUFFER_BIT);
+                }
+                else
+                {
+                    renderScene(scene, projection, view, m_CascadeMatrices[0], m_Shader, settings.cam.Position, settings.showTexture,
+                                frustum);
+                    if (measure)
+                        glEndQuery(GL_SAMPLES_PASSED);
+                }
+                m_OverdrawQueryPending = m_OverdrawQueryPending || measure;
             }
-            if (settings.wireframe)
-                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            else
-                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            glViewport(0, 0, settings.width, settings.height);
-            glCullFace(GL_BACK);
-            renderScene(scene, projection, view, lightSpaceMatrix, m_Shader, settings.cam.Position, settings.showTexture);
         }
 
+        m_Statistics.overdraw = m_Overdraw;
+
+        // Tested against this frame's depth, the results decide from a later frame on
+        if (m_OcclusionQueryMode != OcclusionQueryMode::Off)
+        {
+            GPUScope scope(m_Profiler, "Occlusion Queries");
+            issueOcclusionQueries(projection, settings.cam.Position);
+        }
+        m_Statistics.occlusionQueries = m_OcclusionQueries.getIssuedCount();
+        m_Statistics.occlusionQueriesPending = m_OcclusionQueries.getPendingCount();
+
         // ---- BOUNDS ----
         if (settings.bounds)
         {
-            m_BoundsShader->bind();
-            m_BoundsShader->setUniformMat4f("uView", view);             // View Matrix
-            m_BoundsShader->setUniformMat4f("uProjection", projection); // Projection Matrix
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-            glDisable(GL_CULL_FACE);
-            glDisable(GL_DEPTH_TEST);
-            for (auto mesh : scene.getMeshes())
+            m_ImmediateObjects.clear();
+            for (auto &mesh : scene.getMeshes())
+                m_ImmediateObjects.emplace_back().model = boxModel(mesh->bounds * mesh->modelMatrix);
+            for (const InstanceBatch &batch : m_InstanceBatches)
             {
-                const AABB &bounds = mesh->bounds;
-
-                glm::vec3 worldMin = glm::vec3(mesh->modelMatrix * glm::vec4(mesh->bounds.min, 1.0f));
-                glm::vec3 worldMax = glm::vec3(mesh->modelMatrix * glm::vec4(mesh->bounds.max, 1.0f));
-
-                glm::vec3 center = (worldMin + worldMax) * 0.5f;
-                glm::vec3 size = (worldMax - worldMin);
-
-                glm::mat4 model = glm::translate(glm::mat4(1.0f), center) * glm::scale(glm::mat4(1.0f), size);
-                m_BoundsShader->setUniformMat4f("uModel", model);
-
-                m_BoundsMesh->draw();
-
-                m_Statistics.drawCallCount += m_BoundsMesh->getDrawCallCount();
-                m_Statistics.triangleCount += m_BoundsMesh->getTriangleCount();
-                m_Statistics.vertexCount += m_BoundsMesh->getVertexCount();
+                for (size_t i = batch.first; i < batch.first + batch.count; ++i)
+                    m_ImmediateObjects.emplace_back().model = boxModel(batch.mesh->bounds * m_InstanceTransforms[i]);
             }
-            glEnable(GL_DEPTH_TEST);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+            GPUScope scope(m_Profiler, "Bounds");
+            state.apply(BOUNDS_STATE);
+            m_BoundsShader->bind();
+            drawObjects(m_BoundsShader, *m_BoundsMesh, m_ImmediateObjects);
         }
 
         // ---- SKYBOX ----
         {
-            glDepthFunc(GL_LEQUAL);
-            glDepthMask(GL_FALSE);
-            glDisable(GL_CULL_FACE);
+            GPUScope scope(m_Profiler, "Skybox");
+            state.apply(SKYBOX_STATE);
             m_SkyboxShader->bind();
             glm::mat4 viewNoTranslation = glm::mat4(glm::mat3(view));
             m_SkyboxShader->setUniformMat4f("uView", viewNoTranslation);
             m_SkyboxShader->setUniformMat4f("uProjection", projection);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, scene.skybox->getID());
+            state.bindTexture(0, GL_TEXTURE_CUBE_MAP, scene.skybox->getID());
             m_SkyboxShader->setUniform1i("uSkybox", 0);
             m_SkyboxMesh->draw();
-            glDepthMask(GL_TRUE);
             m_Statistics.drawCallCount += m_SkyboxMesh->getDrawCallCount();
             m_Statistics.triangleCount += m_SkyboxMesh->getTriangleCount();
             m_Statistics.vertexCount += m_SkyboxMesh->getVertexCount();
         }
+
+        // Instances are submitted per frame
+        m_InstanceBatches.clear();
+        m_InstanceTransforms.clear();
+
+        state.apply(DEFAULT_STATE);
+        m_Statistics.stateCallsIssued = state.getIssuedCount();
+        m_Statistics.stateCallsElided = state.getElidedCount();
+        m_Statistics.shaderVariants = int(m_Shader->getVariantCount() + m_GBufferShader->getVariantCount() + m_DeferredDirectionalShader->getVariantCount());
+    }
+
+    bool Renderer::updateShaderWarmup()
+    {
+        // Every program is polled each frame so the ones that finished release their shader objects early
+        Shader *programs[] = {m_Shader.get(), m_DirectionalLightShader.get(), m_DepthPrepassShader.get(), m_PointLightShader.get(),
+                              m_PointLightFaceShader.get(), m_PointLightParaboloidShader.get(), m_BoundsShader.get(),
+                              m_SkyboxShader.get(), m_GizmoShader.get(), m_FeedbackShader.get(), m_GBufferShader.get(),
+                              m_DeferredDirectionalShader.get(), m_DeferredPointLightShader.get(), m_DeferredCompositeShader.get()};
+        int compiling = 0;
+        if (!m_ShadersReady)
+        {
+            for (Shader *program : programs)
+            {
+                if (!program->isReady())
+                    compiling++;
+            }
+            m_ShadersReady = compiling == 0;
+        }
+        compiling += int(m_Shader->pollVariants() + m_GBufferShader->pollVariants() + m_DeferredDirectionalShader->pollVariants());
+        m_Statistics.shadersCompiling = compiling;
+        return m_ShadersReady;
     }
 
     void Renderer::renderScene(const Scene &scene, const glm::mat4 &projection,
                                const glm::mat4 &view, const glm::mat4 &lightSpace,
-                               std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos, int uDebugTexture)
+                               std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos, int uDebugTexture, const Frustum *frustum, const PointLightCulling *pointLight, GLbitfield clearMask)
     {
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        shader->bind();
-        shader->setUniformMat4f("uView", view);             // View Matrix
-        shader->setUniformMat4f("uProjection", projection); // Projection Matrix
-        shader->setUniformMat4f("uLightSpace", lightSpace); // Light Space Matrix (LView * LProjection)
-        shader->setUniform3f("uLightDir", scene.lightDir);  // Light Dir [-1->1]
+        RenderPass pass = RenderPass::Shadow;
+        if (shader == m_Shader || shader == m_GBufferShader)
+            pass = RenderPass::Opaque;
+        else if (shader == m_PointLightShader || shader == m_PointLightFaceShader || shader == m_PointLightParaboloidShader)
+            pass = RenderPass::PointShadow;
+        else if (shader == m_DepthPrepassShader)
+            pass = RenderPass::DepthPrepass;
 
-        m_Statistics.drawCallCount = 0;
-        m_Statistics.triangleCount = 0;
-        m_Statistics.vertexCount = 0;
+        if (pass == RenderPass::Opaque)
+            renderPass<MaterialPassTraits>(pass, scene, projection, view, lightSpace, shader, uCameraPos, uDebugTexture, frustum, pointLight, clearMask);
+        else
+            renderPass<DepthPassTraits>(pass, scene, projection, view, lightSpace, shader, uCameraPos, uDebugTexture, frustum, pointLight, clearMask);
+    }
+
+    template <typename Traits>
+    void Renderer::renderPass(RenderPass pass, const Scene &scene, const glm::mat4 &projection,
+                              const glm::mat4 &view, const glm::mat4 &lightSpace,
+                              std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos, int uDebugTexture, const Frustum *frustum, const PointLightCulling *pointLight, GLbitfield clearMask)
+    {
+        auto &state = GLState::getGlobalState();
+        if constexpr (!Traits::colorOutput)
+            clearMask &= ~GLbitfield(GL_COLOR_BUFFER_BIT); // Shadow and pre-pass targets hold depth only
+        if (clearMask)
+        {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(clearMask);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_DepthTex);
-        shader->setUniform1i("uDepthMap", 0);
-        shader->setUniform1i("uSkyLight", scene.hasSkyLight);
-        shader->setUniform1i("uDebugTexture", uDebugTexture);
-        shader->setUniform3f("uCameraPos", uCameraPos);
+        // ---- Pass Uniforms ----
+        PassUniforms passUniforms;
+        passUniforms.viewProjection = pass == RenderPass::Shadow ? lightSpace : projection * view;
+        if (pointLight)
+        {
+            for (int face = 0; face < 6; ++face)
+                passUniforms.shadowMatrices[face] = pointLight->shadowMatrices[face];
+            passUniforms.range = pointLight->range;
+        }
+        passUniforms.eye = uCameraPos;
+        passUniforms.debugTexture = uDebugTexture;
+        m_PassRing.bind(m_PassRing.upload(&passUniforms, sizeof(PassUniforms), 1), sizeof(PassUniforms));
 
-        for (auto mesh : scene.getMeshes())
+        // ---- Permutations ----
+        // Lighting and debug view hold for the whole pass, the material adds the maps it actually has
+        uint32_t passFeatures = 0;
+        if (shader == m_Shader)
+        {
+            passFeatures |= lightingFeatures(scene, m_IBLEnabled);
+            passFeatures |= uint32_t(std::clamp(uDebugTexture, 0, 15)) << PREPATH_SHADER_DEBUG_SHIFT;
+        }
+        auto selectProgram = [&](const Material *material) -> Shader *
+        {
+            if constexpr (Traits::materials)
+            {
+                // A variant that is still compiling draws with the base program for a few frames instead of stalling
+                Shader *variant = shader->requestVariant(passFeatures | (material ? material->getShaderFeatures() : 0));
+                return variant ? variant : shader.get();
+            }
+            else
+                return shader.get();
+        };
+
+        // Returns false when the bounds are outside the pass, faceMask receives the cubemap faces they touch
+        bool occlusion = m_OcclusionCulling && (pass == RenderPass::Opaque || pass == RenderPass::DepthPrepass);
+        int occluded = 0;
+        auto isVisible = [&](const AABB &worldBounds, uint32_t &faceMask)
+        {
+            faceMask = pointLight && pointLight->face >= 0 ? 1u << pointLight->face : 0x3F;
+            if (frustum && !frustum->intersects(worldBounds))
+                return false;
+            if (occlusion && m_OcclusionCuller.isOccluded(worldBounds))
+            {
+                occluded++;
+                return false;
+            }
+
+            if (pointLight && pointLight->cull)
+            {
+                // Range sphere first, then the faces the mesh actually projects into
+                glm::vec3 closest = glm::clamp(pointLight->position, worldBounds.min, worldBounds.max);
+                glm::vec3 offset = closest - pointLight->position;
+                faceMask = 0;
+                if (glm::dot(offset, offset) <= pointLight->range * pointLight->range)
+                {
+                    if (pointLight->paraboloid)
+                        faceMask = hemisphereMask(pointLight->position, worldBounds);
+                    else
+                    {
+                        for (int face = 0; face < 6; ++face)
+                        {
+                            if ((pointLight->face < 0 || pointLight->face == face) && pointLight->faces[face].intersects(worldBounds))
+                                faceMask |= 1u << face;
+                        }
+                    }
+                    if (pointLight->paraboloid && pointLight->face >= 0)
+                        faceMask &= 1u << pointLight->face;
+                }
+                return faceMask != 0;
+            }
+            return true;
+        };
+
+        bool queryCulling = m_OcclusionQueryMode == OcclusionQueryMode::LastFrame && (pass == RenderPass::Opaque || pass == RenderPass::DepthPrepass);
+        int queryOccluded = 0;
+
+        int visible = 0;
+        int culled = 0;
+        m_RenderQueue.clear();
+        for (auto &mesh : scene.getMeshes())
         {
-            if (!mesh->hidden)
+            if (mesh->hidden)
+                continue;
+            AABB worldBounds = mesh->bounds * mesh->modelMatrix;
+            uint32_t faceMask;
+            if (!isVisible(worldBounds, faceMask))
             {
-                shader->setUniformMat4f("uModel", mesh->modelMatrix);
-                glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(mesh->modelMatrix)));
-                shader->setUniformMat3f("uNormalMatrix", normalMatrix);
-                if (mesh->material)
+                culled++;
+                continue;
+            }
+
+            // Hidden meshes keep being tested, otherwise they could never come back
+            if (pass == RenderPass::Opaque && m_OcclusionQueryMode != OcclusionQueryMode::Off)
+                m_QueryCandidates.push_back(mesh.get());
+            if (queryCulling && m_OcclusionQueries.isOccluded(mesh.get()))
+            {
+                culled++;
+                queryOccluded++;
+                continue;
+            }
+
+            visible++;
+            glm::vec3 center = (worldBounds.min + worldBounds.max) * 0.5f;
+            m_RenderQueue.push(mesh.get(), pass, selectProgram(mesh->material.get()), glm::length(center - uCameraPos), faceMask);
+        }
+        m_RenderQueue.sort();
+
+        if (pass == RenderPass::Opaque)
+        {
+            m_Statistics.visibleMeshes += visible;
+            m_Statistics.culledMeshes += culled;
+            m_Statistics.queryOccludedMeshes += queryOccluded;
+        }
+        else if (pass == RenderPass::Shadow)
+        {
+            m_Statistics.shadowVisibleMeshes += visible;
+            m_Statistics.shadowCulledMeshes += culled;
+        }
+
+        PointLightStatistics *lightStatistics = nullptr;
+        if (pointLight && pointLight->statisticsIndex < m_Statistics.pointLights.size())
+        {
+            lightStatistics = &m_Statistics.pointLights[pointLight->statisticsIndex];
+            lightStatistics->culledMeshes += culled;
+        }
+
+        // ---- Object Uniforms ----
+        const auto &items = m_RenderQueue.getItems();
+        m_ObjectUniforms.resize(items.size());
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const Mesh *mesh = items[i].mesh;
+            ObjectUniforms &object = m_ObjectUniforms[i];
+            object.model = mesh->modelMatrix;
+            if constexpr (Traits::materials)
+            {
+                object.normalMatrix = mesh->getNormalMatrix();
+                object.tint = glm::vec4(mesh->material ? mesh->material->tint : glm::vec3(1.0f), 1.0f);
+                object.virtualMask = mesh->material ? mesh->material->getVirtualMask() : 0;
+            }
+            object.faceMask = int(items[i].layerMask);
+        }
+
+        // ---- Instances ----
+        // Surviving copies are appended behind the queued draws, each batch then reads its run through uObjectBase
+        m_InstanceDraws.clear();
+        int visibleInstances = 0;
+        int culledInstances = 0;
+        size_t maxInstances = 0;
+        for (const InstanceBatch &batch : m_InstanceBatches)
+        {
+            if (batch.mesh->hidden)
+                continue;
+
+            InstanceDraw draw;
+            draw.batch = &batch;
+            draw.program = selectProgram(batch.material.get());
+            draw.firstObject = m_ObjectUniforms.size();
+            glm::vec4 tint = glm::vec4(batch.material ? batch.material->tint : glm::vec3(1.0f), 1.0f);
+            int virtualMask = batch.material ? batch.material->getVirtualMask() : 0;
+            for (size_t i = batch.first; i < batch.first + batch.count; ++i)
+            {
+                const glm::mat4 &transform = m_InstanceTransforms[i];
+                uint32_t faceMask;
+                if (!isVisible(batch.mesh->bounds * transform, faceMask))
+                {
+                    culledInstances++;
+                    continue;
+                }
+
+                ObjectUniforms &object = m_ObjectUniforms.emplace_back();
+                object.model = transform;
+                if constexpr (Traits::materials)
                 {
-                    auto mat = mesh->material;
-                    shader->setUniform3f("uTint", mat->tint);
+                    object.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(transform))));
+                    object.tint = tint;
+                    object.virtualMask = virtualMask;
+                }
+                object.faceMask = int(faceMask);
+                draw.count++;
+                draw.faces += std::popcount(faceMask);
+            }
+            visibleInstances += draw.count;
+            if (draw.count > 0)
+            {
+                maxInstances = std::max(maxInstances, size_t(draw.count));
+                m_InstanceDraws.push_back(draw);
+            }
+        }
+        if (pass == RenderPass::Opaque)
+        {
+            m_Statistics.visibleInstances += visibleInstances;
+            m_Statistics.culledInstances += culledInstances;
+            m_Statistics.occludedMeshes += occluded;
+        }
 
-                    glActiveTexture(GL_TEXTURE0 + 1);
-                    glBindTexture(GL_TEXTURE_2D, mat->albedo->getID());
-                    shader->setUniform1i("uAlbedoMap", 1);
+        // Multi-draw indirect reads every draw's block from a texture buffer through base instance,
+        // the fallback uploads them in one go and a draw then only rebinds its range
+        bool indirect = m_MultiDrawIndirect && !items.empty();
+        // Queued draws get one instance per face in their mask, instance batches six per copy
+        bool faceInstances = shader == m_PointLightFaceShader;
+        size_t instanceFaces = faceInstances ? 6 : 1;
+        bool objectData = indirect || !m_InstanceDraws.empty();
+        if (objectData)
+        {
+            uploadObjectData(m_ObjectUniforms);
+            size_t indirectIDs = indirect ? items.size() + (faceInstances ? 6 : 0) : 0;
+            MeshArena::getGlobalArena().reserveDrawIDs(std::max(indirectIDs, maxInstances * instanceFaces));
+        }
 
-                    glActiveTexture(GL_TEXTURE0 + 2);
-                    glBindTexture(GL_TEXTURE_2D, mat->normal->getID());
-                    shader->setUniform1i("uNormalMap", 2);
+        size_t objectOffset = 0;
+        size_t objectStride = 0;
+        if (indirect)
+        {
+            m_IndirectCommands.resize(items.size());
+            for (size_t i = 0; i < items.size(); ++i)
+            {
+                DrawArraysIndirectCommand &command = m_IndirectCommands[i];
+                command.count = GLuint(items[i].mesh->getVertexCount());
+                command.instanceCount = faceInstances ? GLuint(std::popcount(items[i].layerMask)) : 1;
+                command.first = GLuint(items[i].mesh->getFirstVertex());
+                command.baseInstance = GLuint(i);
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, m_IndirectCommands.size() * sizeof(DrawArraysIndirectCommand), m_IndirectCommands.data(), GL_STREAM_DRAW);
+        }
+        else if (!items.empty())
+        {
+            objectOffset = m_ObjectRing.upload(m_ObjectUniforms.data(), sizeof(ObjectUniforms), items.size());
+            objectStride = m_ObjectRing.getStride(sizeof(ObjectUniforms));
+        }
 
-                    glActiveTexture(GL_TEXTURE0 + 3);
-                    glBindTexture(GL_TEXTURE_2D, mat->roughness->getID());
-                    shader->setUniform1i("uRoughnessMap", 3);
+        // ---- Programs ----
+        // Every variant gets the pass state the first time it is bound, the sort key keeps a variant's draws together
+        m_PassPrograms.clear();
+        Shader *boundProgram = nullptr;
+        auto bindProgram = [&](Shader *program, bool instanced)
+        {
+            program->bind();
+            boundProgram = program;
+            if (std::find(m_PassPrograms.begin(), m_PassPrograms.end(), program) == m_PassPrograms.end())
+            {
+                m_PassPrograms.push_back(program);
+                if constexpr (Traits::materials)
+                {
+                    state.bindTexture(6, GL_TEXTURE_2D, VirtualTextureCache::getGlobalCache().getPhysicalTextureID());
+                    program->setUniform1i("uPhysicalCache", 6);
+                    program->setUniform1i("uAlbedoMap", 1);
+                    program->setUniform1i("uNormalMap", 2);
+                    program->setUniform1i("uRoughnessMap", 3);
+                    program->setUniform1i("uMetallicMap", 4);
+                    program->setUniform1i("uAOMap", 5);
+                }
 
-                    glActiveTexture(GL_TEXTURE0 + 4);
-                    glBindTexture(GL_TEXTURE_2D, mat->metal->getID());
-                    shader->setUniform1i("uMetallicMap", 4);
+                if (shader == m_Shader)
+                {
+                    state.bindTexture(0, GL_TEXTURE_2D_ARRAY, m_DepthTex);
+                    program->setUniform1i("uDepthMap", 0);
+                    setLightingUniforms(*program);
 
-                    glActiveTexture(GL_TEXTURE0 + 5);
-                    glBindTexture(GL_TEXTURE_2D, mat->ao->getID());
-                    shader->setUniform1i("uAOMap", 5);
+                    setPointShadowUniforms(*program);
+                    program->setUniform1i("uClusteredLighting", m_ClusteredLighting);
+                    if (m_ClusteredLighting)
+                    {
+                        state.bindTexture(9, GL_TEXTURE_BUFFER, m_LightClusters.getLightTexture());
+                        program->setUniform1i("uLightData", 9);
+                        state.bindTexture(10, GL_TEXTURE_BUFFER, m_LightClusters.getClusterTexture());
+                        program->setUniform1i("uClusterGrid", 10);
+                        state.bindTexture(11, GL_TEXTURE_BUFFER, m_LightClusters.getIndexTexture());
+                        program->setUniform1i("uLightIndices", 11);
+                        program->setUniform1f("uClusterNear", m_LightClusters.getNear());
+                        program->setUniform1f("uClusterFar", m_LightClusters.getFar());
+                    }
+                }
+
+                if (faceInstances)
+                    program->setUniform1i("uLayered", m_PointShadowPath == PointShadowPath::VertexLayer);
+                if (objectData)
+                    program->setUniform1i("uObjectData", 12);
+            }
+            program->setUniform1i("uUseObjectData", instanced || indirect);
+            program->setUniform1i("uObjectBase", 0);
+            if (faceInstances)
+                program->setUniform1i("uInstanceFaces", instanced ? 6 : 0);
+        };
+
+        // Textures are only rebound when the texture set part of the key changes
+        bool first = true;
+        uint64_t boundTextureSet = 0;
+        auto bindTextures = [&](const Material *mat, uint64_t textureBits)
+        {
+            if constexpr (!Traits::materials)
+                return;
+            if (!mat)
+                return;
+            if (first || textureBits != boundTextureSet || RenderQueue::isSharedTextureBits(textureBits))
+            {
+                const std::shared_ptr<Texture> *slots[5] = {&mat->albedo, &mat->normal, &mat->roughness, &mat->metal, &mat->ao};
+                for (int i = 0; i < 5; ++i)
+                {
+                    if (state.bindTexture(1 + i, GL_TEXTURE_2D, (*slots[i])->getID()))
+                        m_Statistics.stateChanges++;
+                    else
+                        m_Statistics.stateChangesAvoided++;
                 }
+            }
+            else
+            {
+                m_Statistics.stateChangesAvoided += 5;
+            }
+
+            boundTextureSet = textureBits;
+            first = false;
+        };
+
+        bool conditional = Traits::drawQueries && m_OcclusionQueryMode == OcclusionQueryMode::Conditional;
+        bool sampleDraws = Traits::drawQueries && m_Profiler.isSamplingDraws();
+        for (size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
+        {
+            const RenderItem &item = items[itemIndex];
+            Mesh *mesh = item.mesh;
+            m_Statistics.drawCallCount += mesh->getDrawCallCount();
+            m_Statistics.triangleCount += mesh->getTriangleCount();
+            m_Statistics.vertexCount += mesh->getVertexCount();
+            if (lightStatistics)
+            {
+                lightStatistics->drawCallCount += mesh->getDrawCallCount();
+                lightStatistics->triangleCount += mesh->getTriangleCount() * std::popcount(item.layerMask);
+            }
+            if (indirect)
+                continue;
+
+            if (item.shader != boundProgram)
+                bindProgram(item.shader, false);
+            m_ObjectRing.bind(objectOffset + itemIndex * objectStride, sizeof(ObjectUniforms));
+            m_Statistics.uniformBlockBinds++;
+            if constexpr (Traits::materials)
+                bindTextures(mesh->material.get(), RenderQueue::getTextureBits(item.key));
+            // No-wait: draws as usual while the query is still in flight
+            GLuint condition = conditional ? m_OcclusionQueries.getQuery(mesh) : 0;
+            if (condition)
+                glBeginConditionalRender(condition, GL_QUERY_NO_WAIT);
+            if (sampleDraws)
+                m_Profiler.beginDraw(mesh);
+            if (faceInstances)
+                mesh->drawInstanced(GLsizei(std::popcount(item.layerMask)));
+            else
                 mesh->draw();
-                m_Statistics.drawCallCount += mesh->getDrawCallCount();
-                m_Statistics.triangleCount += mesh->getTriangleCount();
-                m_Statistics.vertexCount += mesh->getVertexCount();
+            if (sampleDraws)
+                m_Profiler.endDraw();
+            if (condition)
+                glEndConditionalRender();
+            m_Statistics.submitCalls++;
+        }
+
+        if (indirect)
+        {
+            // Runs of draws sharing a variant and texture set go out as one call, untextured passes as a single call
+            state.bindVertexArray(MeshArena::getGlobalArena().getVAO());
+            size_t begin = 0;
+            while (begin < items.size())
+            {
+                size_t end = begin + 1;
+                if constexpr (Traits::materials)
+                {
+                    uint64_t textureBits = RenderQueue::getTextureBits(items[begin].key);
+                    while (end < items.size() && items[end].shader == items[begin].shader && !RenderQueue::isSharedTextureBits(textureBits) &&
+                           RenderQueue::getTextureBits(items[end].key) == textureBits)
+                        end++;
+                }
+                else
+                {
+                    end = items.size();
+                }
+
+                if (items[begin].shader != boundProgram)
+                    bindProgram(items[begin].shader, false);
+                bindTextures(items[begin].mesh->material.get(), RenderQueue::getTextureBits(items[begin].key));
+                glMultiDrawArraysIndirect(GL_TRIANGLES, (void *)(begin * sizeof(DrawArraysIndirectCommand)), GLsizei(end - begin), 0);
+                m_Statistics.submitCalls++;
+                begin = end;
+            }
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        // One instanced call per batch, instance materials are not part of the queue's texture set keys
+        boundProgram = nullptr;
+        for (const InstanceDraw &draw : m_InstanceDraws)
+        {
+            const Mesh &mesh = *draw.batch->mesh;
+            if (draw.program != boundProgram)
+                bindProgram(draw.program, true);
+            if constexpr (Traits::materials)
+            {
+                first = true;
+                bindTextures(draw.batch->material.get(), 0);
+            }
+            boundProgram->setUniform1i("uObjectBase", int(draw.firstObject));
+            mesh.drawInstanced(GLsizei(draw.count * instanceFaces));
+
+            m_Statistics.drawCallCount += mesh.getDrawCallCount();
+            m_Statistics.triangleCount += mesh.getTriangleCount() * draw.count;
+            m_Statistics.vertexCount += mesh.getVertexCount() * draw.count;
+            m_Statistics.submitCalls++;
+            if (lightStatistics)
+            {
+                lightStatistics->drawCallCount += mesh.getDrawCallCount();
+                lightStatistics->triangleCount += mesh.getTriangleCount() * draw.faces;
+            }
+        }
+    }
+
+    void Renderer::issueOcclusionQueries(const glm::mat4 &projection, const glm::vec3 &cameraPos)
+    {
+        // A box the near plane cuts open can't be judged by its faces, it counts as visible
+        float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        float margin = nearPlane * 2.0f;
+
+        m_ImmediateObjects.clear();
+        size_t tested = 0;
+        for (const Mesh *mesh : m_QueryCandidates)
+        {
+            AABB bounds = mesh->bounds * mesh->modelMatrix;
+            if (glm::length(glm::clamp(cameraPos, bounds.min, bounds.max) - cameraPos) <= margin)
+            {
+                m_OcclusionQueries.markVisible(mesh);
+                continue;
+            }
+            m_QueryCandidates[tested++] = mesh;
+            m_ImmediateObjects.emplace_back().model = boxModel(bounds);
+        }
+        m_QueryCandidates.resize(tested);
+        if (tested == 0)
+            return;
+
+        auto &state = GLState::getGlobalState();
+        state.apply(OCCLUSION_QUERY_STATE);
+        m_BoundsShader->bind();
+        m_BoundsShader->setUniform1i("uUseObjectData", 0);
+
+        size_t objectOffset = m_ObjectRing.upload(m_ImmediateObjects.data(), sizeof(ObjectUniforms), tested);
+        size_t objectStride = m_ObjectRing.getStride(sizeof(ObjectUniforms));
+        for (size_t i = 0; i < tested; ++i)
+        {
+            if (!m_OcclusionQueries.beginQuery(m_QueryCandidates[i]))
+                continue; // Previous query still in flight
+            m_ObjectRing.bind(objectOffset + i * objectStride, sizeof(ObjectUniforms));
+            m_BoundsMesh->draw();
+            m_OcclusionQueries.endQuery();
+
+            m_Statistics.drawCallCount += m_BoundsMesh->getDrawCallCount();
+            m_Statistics.triangleCount += m_BoundsMesh->getTriangleCount();
+            m_Statistics.vertexCount += m_BoundsMesh->getVertexCount();
+        }
+    }
+
+    void Renderer::updateShadowAtlas(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection,
+                                     const glm::vec3 &cameraPos, const Frustum &cameraFrustum)
+    {
+        m_ShadowAtlas.configure(settings.pointShadowFormat, size_t(std::max(settings.pointShadowBudget, 1)) * 1024 * 1024);
+
+        const auto &lights = scene.getPointLights();
+        m_PointLightCulling.resize(lights.size());
+        m_AtlasRequests.assign(lights.size(), ShadowAtlas::Request());
+        int paraboloidLights = 0;
+        for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+        {
+            const auto &light = lights[lightIndex];
+            if (!m_PointShadows || light->hidden || light->range <= 0.0f)
+                continue;
+
+            glm::vec3 pointLightPos = light->position;
+            glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, light->range);
+
+            // Directions and up vectors must match FACE_FORWARD and FACE_UP in pointshadow.glsl
+            std::array<glm::mat4, 6> shadowTransforms = {
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(1, 0, 0), glm::vec3(0, -1, 0)),  // +X
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0)), // -X
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 1, 0), glm::vec3(0, 0, 1)),   // +Y
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, -1, 0), glm::vec3(0, 0, -1)), // -Y
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 0, 1), glm::vec3(0, -1, 0)),  // +Z
+                shadowProj * glm::lookAt(pointLightPos, pointLightPos + glm::vec3(0, 0, -1), glm::vec3(0, -1, 0))  // -Z
+            };
+
+            // Projected radius relative to half the view height, lights around the camera get the full size
+            float distance = glm::length(light->position - cameraPos);
+            float importance = distance > light->range ? light->range / distance * projection[1][1] : 1.0f;
+            if (!cameraFrustum.intersects(light->position, light->range))
+                importance *= 0.25f;
+
+            // Small and distant lights switch to two hemispheres, the band around the threshold stops them from flipping
+            bool paraboloid = settings.pointShadowMode == PointShadowMode::DualParaboloid;
+            if (settings.pointShadowMode == PointShadowMode::Auto)
+                paraboloid = importance < settings.paraboloidImportance * (m_ShadowAtlas.isParaboloid(lightIndex) ? 1.25f : 0.8f);
+            uint32_t allFaces = paraboloid ? 0x3 : 0x3F;
+
+            PointLightCulling &culling = m_PointLightCulling[lightIndex];
+            culling.position = pointLightPos;
+            culling.paraboloid = paraboloid;
+            culling.range = light->range;
+            culling.cull = settings.frustumCulling;
+            culling.statisticsIndex = lightIndex;
+            culling.shadowMatrices = shadowTransforms;
+            for (int face = 0; face < 6; ++face)
+                culling.faces[face].update(shadowTransforms[face]);
+
+            // Faces the shadow pass would draw into, the same test renderScene applies per mesh
+            uint32_t faceMask = culling.cull ? 0 : allFaces;
+            auto addCaster = [&](const AABB &worldBounds)
+            {
+                glm::vec3 offset = glm::clamp(culling.position, worldBounds.min, worldBounds.max) - culling.position;
+                if (glm::dot(offset, offset) > culling.range * culling.range)
+                    return;
+                if (paraboloid)
+                {
+                    faceMask |= hemisphereMask(culling.position, worldBounds);
+                    return;
+                }
+                for (int face = 0; face < 6; ++face)
+                {
+                    if ((faceMask & (1u << face)) == 0 && culling.faces[face].intersects(worldBounds))
+                        faceMask |= 1u << face;
+                }
+            };
+            for (const auto &mesh : scene.getMeshes())
+            {
+                if (faceMask == allFaces)
+                    break;
+                if (!mesh->hidden)
+                    addCaster(mesh->bounds * mesh->modelMatrix);
+            }
+            for (const InstanceBatch &batch : m_InstanceBatches)
+            {
+                if (batch.mesh->hidden)
+                    continue;
+                for (size_t i = batch.first; i < batch.first + batch.count && faceMask != allFaces; ++i)
+                    addCaster(batch.mesh->bounds * m_InstanceTransforms[i]);
+            }
+
+            m_AtlasRequests[lightIndex] = {importance, faceMask, paraboloid};
+            if (paraboloid && faceMask != 0)
+                paraboloidLights++;
+        }
+
+        m_ShadowAtlas.allocate(m_AtlasRequests);
+        for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+        {
+            if (m_AtlasRequests[lightIndex].faceMask != 0 && m_ShadowAtlas.hasMoved(lightIndex))
+                m_ShadowScheduler.invalidatePointLight(lights[lightIndex].get());
+        }
+
+        m_Statistics.shadowAtlasSize = m_ShadowAtlas.getSize();
+        m_Statistics.shadowAtlasFaces = m_ShadowAtlas.getFaceCount();
+        m_Statistics.shadowAtlasSkippedFaces = m_ShadowAtlas.getSkippedFaceCount();
+        m_Statistics.shadowAtlasDroppedLights = m_ShadowAtlas.getDroppedLightCount();
+        m_Statistics.shadowAtlasParaboloidLights = paraboloidLights;
+    }
+
+    void Renderer::setPointShadowUniforms(Shader &shader)
+    {
+        // Bound even when disabled, the samplers must not share unit 0 with the cascade array
+        auto &state = GLState::getGlobalState();
+        shader.setUniform1i("uPointShadows", m_PointShadows);
+        state.bindTexture(13, GL_TEXTURE_2D, m_ShadowAtlas.getTexture());
+        shader.setUniform1i("uPointShadowAtlas", 13);
+        state.bindTexture(14, GL_TEXTURE_BUFFER, m_ShadowAtlas.getFaceTexture());
+        shader.setUniform1i("uPointShadowFaces", 14);
+    }
+
+    bool Renderer::updateDepthPrepass(const RenderSettings &settings)
+    {
+        if (m_OverdrawQueryPending)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_OverdrawQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(m_OverdrawQuery, GL_QUERY_RESULT, &samples);
+                m_Overdraw = float(samples) / m_OverdrawPixels;
+                m_OverdrawQueryPending = false;
+            }
+        }
+
+        if (settings.depthPrepass != DepthPrepassMode::Auto)
+            return settings.depthPrepass == DepthPrepassMode::On;
+
+        // Without the pre-pass the query counts shaded samples, with it the front to back sorted depth samples,
+        // which are never more, so the two thresholds and the hold keep the decision from flipping every frame
+        if (m_DepthPrepassHold > 0)
+        {
+            m_DepthPrepassHold--;
+        }
+        else if (!m_OverdrawQueryPending)
+        {
+            bool enable = m_AutoDepthPrepass ? m_Overdraw > PREPATH_PREPASS_DISABLE_OVERDRAW : m_Overdraw > PREPATH_PREPASS_ENABLE_OVERDRAW;
+            if (enable != m_AutoDepthPrepass)
+            {
+                m_AutoDepthPrepass = enable;
+                m_DepthPrepassHold = PREPATH_PREPASS_HOLD_FRAMES;
+            }
+        }
+        return m_AutoDepthPrepass;
+    }
+
+    void Renderer::setLightingUniforms(Shader &shader)
+    {
+        auto &state = GLState::getGlobalState();
+        shader.setUniformMat4fArray("uCascadeMatrices", m_CascadeMatrices);
+        for (int i = 0; i < PREPATH_CSM_CASCADES; ++i)
+            shader.setUniform1f("uCascadeSplits[" + std::to_string(i) + "]", m_CascadeSplits[i]);
+
+        if (m_IBLEnabled)
+        {
+            state.bindTexture(7, GL_TEXTURE_CUBE_MAP, m_IBL->getSpecularID());
+            shader.setUniform1i("uSpecularMap", 7);
+            state.bindTexture(8, GL_TEXTURE_2D, m_IBL->getBRDFLutID());
+            shader.setUniform1i("uBRDFLut", 8);
+            shader.setUniform1f("uSpecularMips", float(m_IBL->getSpecularMipCount()));
+            const auto &sh = m_IBL->getIrradianceSH();
+            for (int i = 0; i < 9; ++i)
+                shader.setUniform3f("uIrradianceSH[" + std::to_string(i) + "]", sh[i]);
+        }
+    }
+
+    void Renderer::setupGBuffer(int width, int height)
+    {
+        if (!m_GBufferFBO)
+        {
+            glGenFramebuffers(1, &m_GBufferFBO);
+            glGenFramebuffers(1, &m_LightingFBO);
+            glGenTextures(1, &m_GBufferAlbedo);
+            glGenTextures(1, &m_GBufferNormal);
+            glGenTextures(1, &m_GBufferORM);
+            glGenTextures(1, &m_GBufferDepth);
+            glGenTextures(1, &m_LightingTex);
+        }
+
+        m_GBufferWidth = width;
+        m_GBufferHeight = height;
+        auto &state = GLState::getGlobalState();
+
+        auto allocate = [&](GLuint texture, GLenum internalFormat, GLenum format, GLenum type)
+        {
+            state.bindTexture(0, GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        };
+        allocate(m_GBufferAlbedo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        allocate(m_GBufferNormal, GL_RG16F, GL_RG, GL_FLOAT);
+        allocate(m_GBufferORM, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        allocate(m_GBufferDepth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT);
+        allocate(m_LightingTex, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+
+        state.bindFramebuffer(m_GBufferFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_GBufferAlbedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_GBufferNormal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, m_GBufferORM, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_GBufferDepth, 0);
+        GLenum drawBuffers[3] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(3, drawBuffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            PREPATH_LOG_ERROR("ERROR: G-buffer framebuffer is not complete!");
+        }
+
+        // Lighting has no depth attachment so the resolve passes can sample the G-buffer depth freely
+        state.bindFramebuffer(m_LightingFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_LightingTex, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            PREPATH_LOG_ERROR("ERROR: Deferred lighting framebuffer is not complete!");
+        }
+    }
+
+    void Renderer::renderDeferred(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection,
+                                  const glm::mat4 &view, const Frustum &cameraFrustum)
+    {
+        if (settings.width != m_GBufferWidth || settings.height != m_GBufferHeight)
+            setupGBuffer(settings.width, settings.height);
+        auto &state = GLState::getGlobalState();
+
+        // ---- G-Buffer ----
+        // Only material sampling runs per fragment, overdraw no longer pays for the lighting
+        state.bindFramebuffer(m_GBufferFBO);
+        m_Profiler.beginScope("G-Buffer");
+        renderScene(scene, projection, view, m_CascadeMatrices[0], m_GBufferShader, settings.cam.Position, 0,
+                    settings.frustumCulling ? &cameraFrustum : nullptr);
+        m_Profiler.endScope();
+
+        // Camera matrices, position and light direction come from the frame block
+        auto bindGBuffer = [&](Shader *shader)
+        {
+            const GLuint textures[4] = {m_GBufferAlbedo, m_GBufferNormal, m_GBufferORM, m_GBufferDepth};
+            const char *names[4] = {"uGAlbedo", "uGNormal", "uGORM", "uGDepth"};
+            for (int i = 0; i < 4; ++i)
+            {
+                state.bindTexture(1 + i, GL_TEXTURE_2D, textures[i]);
+                shader->setUniform1i(names[i], 1 + i);
+            }
+        };
+
+        m_Profiler.beginScope("Lighting");
+        state.bindFramebuffer(m_LightingFBO);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // ---- Directional + Ambient ----
+        state.apply(DEFERRED_DIRECTIONAL_STATE);
+        Shader *directional = m_DeferredDirectionalShader->requestVariant(lightingFeatures(scene, m_IBLEnabled));
+        if (!directional)
+            directional = m_DeferredDirectionalShader.get();
+        directional->bind();
+        bindGBuffer(directional);
+        state.bindTexture(0, GL_TEXTURE_2D_ARRAY, m_DepthTex);
+        directional->setUniform1i("uDepthMap", 0);
+        setLightingUniforms(*directional);
+        m_GizmoMesh->draw();
+        m_Statistics.drawCallCount += m_GizmoMesh->getDrawCallCount();
+        m_Statistics.triangleCount += m_GizmoMesh->getTriangleCount();
+        m_Statistics.vertexCount += m_GizmoMesh->getVertexCount();
+
+        // ---- Point Light Volumes ----
+        // Back faces only, so a volume still covers its pixels when the camera is inside it
+        state.apply(DEFERRED_VOLUME_STATE);
+        m_DeferredPointLightShader->bind();
+        bindGBuffer(m_DeferredPointLightShader.get());
+        setPointShadowUniforms(*m_DeferredPointLightShader);
+        int volumes = 0;
+        const auto &lights = scene.getPointLights();
+        for (size_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex)
+        {
+            const auto &light = lights[lightIndex];
+            if (light->hidden || light->range <= 0.0f)
+                continue;
+            if (settings.frustumCulling && !cameraFrustum.intersects(light->position, light->range))
+                continue;
+
+            // The tessellated sphere sits inside the unit sphere, grow it slightly to cover the whole range
+            m_DeferredPointLightShader->setUniform4f("uLightVolume", glm::vec4(light->position, light->range * 1.05f));
+            m_DeferredPointLightShader->setUniform3f("uLightPosition", light->position);
+            m_DeferredPointLightShader->setUniform3f("uLightRadiance", light->color * light->intensity);
+            m_DeferredPointLightShader->setUniform1f("uLightRange", light->range);
+            m_DeferredPointLightShader->setUniform1i("uLightIndex", int(lightIndex));
+            m_SphereMesh->draw();
+            m_Statistics.drawCallCount += m_SphereMesh->getDrawCallCount();
+            m_Statistics.triangleCount += m_SphereMesh->getTriangleCount();
+            m_Statistics.vertexCount += m_SphereMesh->getVertexCount();
+            volumes++;
+        }
+        m_Statistics.lightVolumes = volumes;
+        m_Profiler.endScope();
+
+        // ---- Composite ----
+        GPUScope scope(m_Profiler, "Composite");
+        // Writes the G-buffer depth back so the skybox and bounds test against the scene
+        state.apply(DEFERRED_COMPOSITE_STATE);
+        state.bindFramebuffer(0);
+        m_DeferredCompositeShader->bind();
+        state.bindTexture(0, GL_TEXTURE_2D, m_LightingTex);
+        m_DeferredCompositeShader->setUniform1i("uLighting", 0);
+        state.bindTexture(1, GL_TEXTURE_2D, m_GBufferDepth);
+        m_DeferredCompositeShader->setUniform1i("uGDepth", 1);
+        m_GizmoMesh->draw();
+        m_Statistics.drawCallCount += m_GizmoMesh->getDrawCallCount();
+        m_Statistics.triangleCount += m_GizmoMesh->getTriangleCount();
+        m_Statistics.vertexCount += m_GizmoMesh->getVertexCount();
+    }
+
+    void Renderer::setupFeedbackBuffer(int width, int height)
+    {
+        if (!m_FeedbackFBO)
+        {
+            glGenFramebuffers(1, &m_FeedbackFBO);
+            glGenTextures(1, &m_FeedbackColor);
+            glGenRenderbuffers(1, &m_FeedbackDepth);
+            glGenBuffers(PREPATH_VT_FEEDBACK_READBACKS, m_FeedbackReadbacks.data());
+        }
+
+        m_FeedbackWidth = width;
+        m_FeedbackHeight = height;
+        m_FeedbackData.resize(size_t(width) * height * 4);
+        auto &state = GLState::getGlobalState();
+
+        // Readbacks of the old size are dropped, the next frames request their pages again
+        for (size_t slot = 0; slot < PREPATH_VT_FEEDBACK_READBACKS; ++slot)
+        {
+            if (m_FeedbackFences[slot])
+                glDeleteSync(m_FeedbackFences[slot]);
+            m_FeedbackFences[slot] = nullptr;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_FeedbackReadbacks[slot]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(m_FeedbackData.size()), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        state.bindTexture(0, GL_TEXTURE_2D, m_FeedbackColor);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, m_FeedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+        state.bindFramebuffer(m_FeedbackFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_FeedbackColor, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_FeedbackDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            PREPATH_LOG_ERROR("ERROR: Virtual texture feedback framebuffer is not complete!");
+        }
+    }
+
+    void Renderer::renderVirtualTextureFeedback(const Scene &scene, const glm::mat4 &projection, const glm::mat4 &view, const RenderSettings &settings)
+    {
+        int width = std::max(1, settings.width / PREPATH_VT_FEEDBACK_SCALE);
+        int height = std::max(1, settings.height / PREPATH_VT_FEEDBACK_SCALE);
+        if (width != m_FeedbackWidth || height != m_FeedbackHeight)
+            setupFeedbackBuffer(width, height);
+
+        auto &state = GLState::getGlobalState();
+        state.apply(FEEDBACK_STATE);
+        state.bindFramebuffer(m_FeedbackFBO);
+        state.viewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        m_FeedbackShader->bind();
+        m_FeedbackShader->setUniformMat4f("uView", view);
+        m_FeedbackShader->setUniformMat4f("uProjection", projection);
+        m_FeedbackShader->setUniform1f("uLodBias", -std::log2(float(PREPATH_VT_FEEDBACK_SCALE)));
+        m_FeedbackShader->setUniform1i("uFrame", m_FeedbackFrame++);
+
+        const Material *lastMaterial = nullptr;
+        bool first = true;
+        for (auto mesh : scene.getMeshes())
+        {
+            if (mesh->hidden)
+                continue;
+
+            // Meshes without virtual slots still draw so they occlude, slot arrays only change with the material
+            if (first || mesh->material.get() != lastMaterial)
+            {
+                first = false;
+                lastMaterial = mesh->material.get();
+                const std::shared_ptr<Texture> *slots[5] = {nullptr, nullptr, nullptr, nullptr, nullptr};
+                if (lastMaterial)
+                {
+                    slots[0] = &lastMaterial->albedo;
+                    slots[1] = &lastMaterial->normal;
+                    slots[2] = &lastMaterial->roughness;
+                    slots[3] = &lastMaterial->metal;
+                    slots[4] = &lastMaterial->ao;
+                }
+
+                int ids[5] = {};
+                glm::vec2 pages[5] = {};
+                int mips[5] = {};
+                for (int i = 0; i < 5; ++i)
+                {
+                    const VirtualTexture *virtualTexture = slots[i] && *slots[i] ? (*slots[i])->getVirtual().get() : nullptr;
+                    if (!virtualTexture)
+                        continue;
+                    ids[i] = virtualTexture->getID();
+                    pages[i] = glm::vec2(float(virtualTexture->getPagesX()), float(virtualTexture->getPagesY()));
+                    mips[i] = virtualTexture->getMipCount();
+                }
+                m_FeedbackShader->setUniform1iArray("uVirtualIDs", ids, 5);
+                m_FeedbackShader->setUniform2fArray("uVirtualPages", pages, 5);
+                m_FeedbackShader->setUniform1iArray("uVirtualMips", mips, 5);
+            }
+
+            m_FeedbackShader->setUniformMat4f("uModel", mesh->modelMatrix);
+            mesh->draw();
+        }
+
+        // ---- Readback ----
+        // Finished copies are consumed oldest first, a fence that has not signaled is never waited on
+        for (size_t k = 1; k <= PREPATH_VT_FEEDBACK_READBACKS; ++k)
+        {
+            size_t slot = (m_FeedbackSlot + k) % PREPATH_VT_FEEDBACK_READBACKS;
+            GLsync &fence = m_FeedbackFences[slot];
+            if (!fence)
+                continue;
+            GLenum status = glClientWaitSync(fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync(fence);
+            fence = nullptr;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_FeedbackReadbacks[slot]);
+            const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(m_FeedbackData.size()), GL_MAP_READ_BIT);
+            if (pixels)
+            {
+                std::memcpy(m_FeedbackData.data(), pixels, m_FeedbackData.size());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                VirtualTextureCache::getGlobalCache().requestPages(m_FeedbackData);
+            }
+        }
+
+        // Still in flight after a full ring, its pages are requested again by a later frame
+        m_FeedbackSlot = (m_FeedbackSlot + 1) % PREPATH_VT_FEEDBACK_READBACKS;
+        if (m_FeedbackFences[m_FeedbackSlot])
+            glDeleteSync(m_FeedbackFences[m_FeedbackSlot]);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_FeedbackReadbacks[m_FeedbackSlot]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_FeedbackFences[m_FeedbackSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool Renderer::updateCascades(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        // First split starts at the camera's near plane, recovered from the projection like the clusters do
+        const float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+        const float farPlane = settings.shadowDistance;
+        float aspect = float(settings.width) / settings.height;
+
+        // Light looks along -lightDir from the origin, cascades only differ by their ortho window
+        glm::vec3 lightDir = glm::normalize(scene.lightDir);
+        glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), -lightDir, up);
+        AABB sceneLightSpace = scene.bounds * lightRotation;
+
+        bool changed = false;
+        float splitNear = nearPlane;
+        for (int cascade = 0; cascade < PREPATH_CSM_CASCADES; ++cascade)
+        {
+            // Practical split scheme
+            float p = float(cascade + 1) / PREPATH_CSM_CASCADES;
+            float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+            float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+            float splitFar = PREPATH_CSM_SPLIT_LAMBDA * logSplit + (1.0f - PREPATH_CSM_SPLIT_LAMBDA) * uniformSplit;
+
+            glm::mat4 inverseSlice = glm::inverse(settings.cam.getProjectionMatrix(aspect, splitNear, splitFar) * view);
+            std::array<glm::vec3, 8> corners;
+            glm::vec3 center(0.0f);
+            for (int i = 0; i < 8; ++i)
+            {
+                glm::vec4 corner = inverseSlice * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+                corners[i] = glm::vec3(corner) / corner.w;
+                center += corners[i] / 8.0f;
             }
+
+            // Bounding sphere keeps the window size constant under camera rotation
+            float radius = 0.0f;
+            for (const auto &corner : corners)
+                radius = std::max(radius, glm::length(corner - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            // Snap the window to whole texels so static shadows don't shimmer while moving
+            glm::vec3 centerLightSpace = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+            float texelSize = 2.0f * radius / PREPATH_SHADOWMAP_SIZE;
+            centerLightSpace.x = std::floor(centerLightSpace.x / texelSize) * texelSize;
+            centerLightSpace.y = std::floor(centerLightSpace.y / texelSize) * texelSize;
+
+            // Depth range spans the whole scene so casters between the light and the slice still land in it
+            float minZ = std::min(sceneLightSpace.min.z, centerLightSpace.z - radius);
+            float maxZ = std::max(sceneLightSpace.max.z, centerLightSpace.z + radius);
+            glm::mat4 lightProjection = glm::ortho(centerLightSpace.x - radius, centerLightSpace.x + radius,
+                                                   centerLightSpace.y - radius, centerLightSpace.y + radius,
+                                                   -maxZ, -minZ);
+            glm::mat4 matrix = lightProjection * lightRotation;
+
+            if (std::memcmp(&matrix, &m_CascadeMatrices[cascade], sizeof(glm::mat4)) != 0)
+                changed = true;
+            m_CascadeMatrices[cascade] = matrix;
+            m_CascadeSplits[cascade] = splitFar;
+            splitNear = splitFar;
+        }
+        return changed;
+    }
+
+    unsigned int Renderer::copyCascadeToTexture(int cascade)
+    {
+        auto &state = GLState::getGlobalState();
+        if (!m_CascadePreviewTex)
+        {
+            glGenTextures(1, &m_CascadePreviewTex);
+            state.bindTexture(0, GL_TEXTURE_2D, m_CascadePreviewTex);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE,
+                         0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        GLuint tempFBO;
+        glGenFramebuffers(1, &tempFBO);
+        state.bindFramebuffer(tempFBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_DepthTex, 0, std::clamp(cascade, 0, PREPATH_CSM_CASCADES - 1));
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+        {
+            state.bindTexture(0, GL_TEXTURE_2D, m_CascadePreviewTex);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, PREPATH_SHADOWMAP_SIZE, PREPATH_SHADOWMAP_SIZE);
+        }
+        else
+        {
+            PREPATH_LOG_ERROR("ERROR: Temp FBO for cascade copy is not complete!");
+        }
+
+        state.bindFramebuffer(0);
+        glDeleteFramebuffers(1, &tempFBO);
+        return m_CascadePreviewTex;
+    }
+
+    void Renderer::updateImageBasedLighting(const Scene &scene, const RenderSettings &settings)
+    {
+        m_IBLEnabled = settings.imageBasedLighting && scene.skybox;
+        if (!m_IBLEnabled)
+            return;
+
+        // Prefiltering is expensive, only redo it when the skybox is replaced
+        if (m_IBLSource != scene.skybox)
+        {
+            m_IBLSource = scene.skybox;
+            m_IBL = IBL::generateIBL(scene.skybox);
+            GLState::getGlobalState().invalidate(); // Baking binds its own targets and framebuffers
         }
     }
 
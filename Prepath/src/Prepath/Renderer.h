@@ -5,32 +5,162 @@
 #include <memory>
 #include <mutex>
 #include <format>
+#include <span>
 #include <glad/glad.h>
 
 #include "Context.h"
 #include "Scene.h"
 #include "Camera.h"
 #include "Shader.h"
+#include "VirtualTexture.h"
+#include "IBL.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "ShadowScheduler.h"
+#include "LightClusters.h"
+#include "UniformBuffer.h"
+#include "MeshArena.h"
+#include "GLState.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "GPUProfiler.h"
+#include "ShadowAtlas.h"
+
+#define PREPATH_CSM_CASCADES (4)          // Must match CASCADE_COUNT in default.frag
+#define PREPATH_CSM_SPLIT_LAMBDA (0.75f)  // Blend between logarithmic (1) and uniform (0) splits
+#define PREPATH_PREPASS_ENABLE_OVERDRAW (1.6f)   // Auto depth pre-pass turns on above this many shaded samples per pixel
+#define PREPATH_PREPASS_DISABLE_OVERDRAW (1.15f) // and off again below this many depth samples per pixel in the pre-pass
+#define PREPATH_PREPASS_HOLD_FRAMES (60)         // Frames an auto decision is kept before it is reconsidered
 
 namespace Prepath
 {
+    enum class DepthPrepassMode
+    {
+        Off,
+        On,
+        Auto // On while the measured overdraw of the forward pass is high
+    };
+
+    enum class OcclusionQueryMode
+    {
+        Off,
+        LastFrame,  // Skip meshes whose bounds query came back without samples
+        Conditional // Submit them under glBeginConditionalRender, falls back to LastFrame with multi-draw indirect or a pre-pass
+    };
+
+    // How a point shadow pass reaches the six faces
+    enum class PointShadowPath
+    {
+        Auto,           // VertexLayer where supported, SingleFace otherwise
+        GeometryShader, // One pass, pointlight.geom re-emits each triangle per face (viewport arrays)
+        VertexLayer,    // One pass, one instance per face writing gl_ViewportIndex from the vertex shader
+        SingleFace      // One pass per face with its own culling, works everywhere
+    };
+
+    // Projection of a point light shadow
+    enum class PointShadowMode
+    {
+        Cube,           // Six 90 degree faces
+        DualParaboloid, // Two hemispheres, a third of the passes at a lower and less even resolution
+        Auto            // DualParaboloid for lights below paraboloidImportance
+    };
+
     struct RenderSettings
     {
         int width = 800;
         int height = 600;
         bool wireframe = false;
         bool culling = true;
+        bool frustumCulling = true; // Skip meshes whose world bounds are outside the main or shadow view
+        bool occlusionCulling = false; // Skip camera pass meshes hidden behind the occluders of the CPU depth buffer
+        OcclusionQueryMode occlusionQueries = OcclusionQueryMode::Off; // GPU queries against the camera pass bounds
         bool bounds = false;
+        float shadowDistance = 150.0f; // View distance covered by the directional shadow cascades
+        bool shadowCaching = true;   // Reuse shadow maps whose light and casters did not change
+        int shadowUpdateBudget = 4;  // Dirty point light shadows refreshed per frame, < 0 = unlimited
+        bool pointShadows = true;    // Point light shadows in the shared atlas
+        PointShadowPath pointShadowPath = PointShadowPath::Auto; // Falls back to SingleFace when the choice is unsupported
+        ShadowDepthFormat pointShadowFormat = ShadowDepthFormat::Depth16;
+        int pointShadowBudget = 32;  // Atlas memory in MB, tiles shrink and lights drop out when it is full
+        PointShadowMode pointShadowMode = PointShadowMode::Auto;
+        float paraboloidImportance = 0.25f; // Auto: projected size below which a light renders two paraboloids
+        bool imageBasedLighting = false; // Ambient from the prefiltered skybox instead of a constant
+        bool clusteredLighting = false;  // Shade point lights through the froxel light grid
+        bool deferredShading = false;    // G-buffer pass, then lighting per pixel and point lights as volumes
+        bool multiDrawIndirect = false;  // One glMultiDrawArraysIndirect per pass and texture set when GL 4.3 is available
+        DepthPrepassMode depthPrepass = DepthPrepassMode::Off; // Depth-only pass first, the forward pass then shades with GL_EQUAL
+        bool gpuTiming = false;     // Timestamp queries around every pass, read back a few frames late
+        bool perDrawTiming = false; // Also time single camera pass draws every few frames, multi-draw indirect is skipped on those
         int showTexture = 0; // 0 = normal render, >0 = debug view
         Camera cam;
         RenderSettings();
     };
 
+    struct PointLightStatistics
+    {
+        int drawCallCount = 0;
+        int triangleCount = 0; // Counted once per cubemap face the mesh is emitted to
+        int culledMeshes = 0;
+    };
+
+    // Culling volume of a point light shadow pass: the range sphere plus one 90 degree frustum per cubemap face,
+    // or the two half-spaces above and below the light in dual-paraboloid mode
+    struct PointLightCulling
+    {
+        glm::vec3 position = glm::vec3(0.0f);
+        float range = 0.0f;
+        std::array<Frustum, 6> faces;
+        std::array<glm::mat4, 6> shadowMatrices; // Face view-projections, uploaded with the pass block
+        bool paraboloid = false;    // Faces 0 and 1 are the +Z and -Z hemispheres
+        bool cull = true;           // False still records statistics but draws every mesh to every face
+        int face = -1;              // >= 0 limits the pass to this face
+        size_t statisticsIndex = 0; // Index into RenderStatistics::pointLights
+    };
+
     struct RenderStatistics
     {
         int drawCallCount = 0;
         int vertexCount = 0;
         int triangleCount = 0;
+        int virtualPagesResident = 0;
+        int virtualPagesPending = 0;
+        int virtualPagesUploaded = 0;
+        int stateChanges = 0;        // Texture binds issued by the render queue
+        int stateChangesAvoided = 0; // Skipped because the sort key matched the previous draw or the texture was still bound
+        int uniformBlockBinds = 0;   // Per-draw glBindBufferRange calls of the object block
+        int visibleMeshes = 0;
+        int culledMeshes = 0;
+        int shadowVisibleMeshes = 0;
+        int shadowCulledMeshes = 0;
+        int shadowMapsRefreshed = 0;
+        int shadowMapsReused = 0;
+        int shadowMapsDeferred = 0; // Dirty but over the update budget, still showing the previous map
+        int shadowAtlasSize = 0;          // Side of the point shadow atlas in texels
+        int shadowAtlasFaces = 0;         // Tiles handed out this frame
+        int shadowAtlasSkippedFaces = 0;  // Faces without casters, neither stored nor rendered
+        int shadowAtlasDroppedLights = 0; // Lights with casters that did not fit at the minimum face size
+        int shadowAtlasParaboloidLights = 0; // Lights with casters in dual-paraboloid mode
+        PointShadowPath pointShadowPath = PointShadowPath::Auto; // Path the point shadows used this frame
+        int clusterLights = 0;           // Point lights inserted into the froxel grid
+        int clusterLightIndices = 0;     // Light references summed over all clusters
+        int clusterMaxLights = 0;        // Most lights referenced by a single cluster
+        int lightVolumes = 0;            // Point light volumes drawn by the deferred path
+        int submitCalls = 0;             // Draw calls issued by renderScene, one per batch with multi-draw indirect
+        int stateCallsIssued = 0;        // Binds and fixed-function calls GLState passed on to the driver
+        int stateCallsElided = 0;        // Dropped by GLState because they matched the current state
+        int shaderVariants = 0;          // Permutations of the forward and G-buffer shaders compiled so far
+        int shadersCompiling = 0;        // Pass programs and permutations the driver is still building
+        int visibleInstances = 0;        // Copies from submitInstanced drawn by the camera pass
+        int culledInstances = 0;
+        int occludedMeshes = 0;          // Part of culledMeshes and culledInstances, rejected by the CPU occlusion buffer
+        int occluders = 0;               // Meshes rasterized into the occlusion buffer
+        int queryOccludedMeshes = 0;     // Part of culledMeshes, skipped on their last occlusion query result
+        int occlusionQueries = 0;        // Bounds queries issued this frame
+        int occlusionQueriesPending = 0; // Still in flight from earlier frames
+        int occluderTriangles = 0;
+        float overdraw = 0.0f;           // Samples passing the depth test per pixel in the pass that lays down depth
+        bool depthPrepass = false;       // Forward pass ran behind a depth pre-pass
+        std::vector<PointLightStatistics> pointLights; // Same order as Scene::getPointLights, hidden lights stay zero
     };
 
     class Renderer
@@ -39,27 +169,156 @@ namespace Prepath
         Renderer();
         ~Renderer();
         void renderGizmo(std::shared_ptr<Texture> texture, const glm::vec3 &position, const glm::vec3 &tint = glm::vec3(1.0f));
+        // One draw for all billboards, tints may be empty or hold one color per position
+        void renderGizmos(std::shared_ptr<Texture> texture, std::span<const glm::vec3> positions, std::span<const glm::vec3> tints = {});
         void renderGizmoSphere(const glm::vec3 &position, const float &size, const glm::vec3 &tint = glm::vec3(1.0f));
+        // Queues copies of mesh for the next render(), drawn with one instanced call per pass including the shadow passes.
+        // The mesh's own modelMatrix is ignored, every instance is frustum culled against its transformed bounds.
+        void submitInstanced(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material, std::span<const glm::mat4> transforms);
         void render(const Scene &scene, const RenderSettings &settings);
-        void renderScene(const Scene &scene, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &lightSpace, std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos = glm::vec3(0.0f), int uDebugTexture = 0);
-        unsigned int getDepthTex() { return m_DepthTex; }
+        void renderScene(const Scene &scene, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &lightSpace, std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos = glm::vec3(0.0f), int uDebugTexture = 0, const Frustum *frustum = nullptr, const PointLightCulling *pointLight = nullptr, GLbitfield clearMask = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        unsigned int getDepthTex() { return m_DepthTex; } // 2D array, one layer per cascade
+        unsigned int getPointShadowAtlas() { return m_ShadowAtlas.getTexture(); }
+        // Copies one cascade into a plain 2D depth texture for previews
+        unsigned int copyCascadeToTexture(int cascade);
         RenderStatistics getStatistics() { return m_Statistics; }
+        // Pass hierarchy of the newest frame whose timestamps arrived
+        const std::vector<GPUTiming> &getGPUTimings() const { return m_Profiler.getTimings(); }
+        // Most expensive camera pass draws, empty unless RenderSettings::perDrawTiming is set
+        const std::vector<DrawTiming> &getDrawTimings() const { return m_Profiler.getDrawTimings(); }
+
+    private:
+        void renderVirtualTextureFeedback(const Scene &scene, const glm::mat4 &projection, const glm::mat4 &view, const RenderSettings &settings);
+        void setupFeedbackBuffer(int width, int height);
+        void updateImageBasedLighting(const Scene &scene, const RenderSettings &settings);
+        // Cascade and IBL uniforms used by every pass that shades the directional light
+        void setLightingUniforms(Shader &shader);
+        void setupGBuffer(int width, int height);
+        void renderDeferred(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection, const glm::mat4 &view, const Frustum &cameraFrustum);
+        // Returns true when any cascade projection changed since the last call
+        bool updateCascades(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection, const glm::mat4 &view);
+        // Uploads the blocks to the object data texture buffer on unit 12, shaders read it through uObjectData
+        void uploadObjectData(const std::vector<ObjectUniforms> &objects);
+        // Draws mesh once per block with the bound shader, which reads its transform through object.glsl
+        void drawObjects(const std::shared_ptr<Shader> &shader, const Mesh &mesh, const std::vector<ObjectUniforms> &objects);
+        // Draws the bounds of the camera pass meshes against the finished depth buffer, one query each
+        void issueOcclusionQueries(const glm::mat4 &projection, const glm::vec3 &cameraPos);
+        // Culling volumes, caster faces and atlas tiles of every point light, before the shadow scheduler runs
+        void updateShadowAtlas(const Scene &scene, const RenderSettings &settings, const glm::mat4 &projection, const glm::vec3 &cameraPos, const Frustum &cameraFrustum);
+        // Atlas and face buffer of the shaders that include pointshadow.glsl
+        void setPointShadowUniforms(Shader &shader);
+        // Polls the programs submitted at startup, returns false until every pass program can be bound
+        bool updateShaderWarmup();
+        // Reads back the overdraw query when it is ready and returns whether this frame uses the depth pre-pass
+        bool updateDepthPrepass(const RenderSettings &settings);
+        // Body of renderScene, Traits (see Renderer.cpp) compiles the material work out of depth-only passes
+        template <typename Traits>
+        void renderPass(RenderPass pass, const Scene &scene, const glm::mat4 &projection, const glm::mat4 &view, const glm::mat4 &lightSpace, std::shared_ptr<Shader> shader, const glm::vec3 &uCameraPos, int uDebugTexture, const Frustum *frustum, const PointLightCulling *pointLight, GLbitfield clearMask);
+
+    private:
+        struct InstanceBatch
+        {
+            std::shared_ptr<Mesh> mesh;
+            std::shared_ptr<Material> material;
+            size_t first = 0; // Range in m_InstanceTransforms
+            size_t count = 0;
+        };
+
+        struct InstanceDraw
+        {
+            const InstanceBatch *batch = nullptr;
+            Shader *program = nullptr; // Permutation variant of the batch material
+            size_t firstObject = 0; // Index of the first surviving instance in m_ObjectUniforms
+            int count = 0;
+            int faces = 0; // Cubemap faces summed over the instances, for point light statistics
+        };
 
     private:
         RenderStatistics m_Statistics;
+        RenderQueue m_RenderQueue;
+        ShadowScheduler m_ShadowScheduler;
+        LightClusters m_LightClusters;
+        OcclusionCuller m_OcclusionCuller;
+        bool m_OcclusionCulling = false; // Camera passes of this frame test against m_OcclusionCuller
+        OcclusionQueries m_OcclusionQueries;
+        OcclusionQueryMode m_OcclusionQueryMode = OcclusionQueryMode::Off;
+        std::vector<const Mesh *> m_QueryCandidates; // Meshes of the last camera pass, tested after it
+        GPUProfiler m_Profiler;
+        ShadowAtlas m_ShadowAtlas;
+        bool m_ViewportArrays = false;      // GL 4.1 or ARB_viewport_array, needed by the geometry shader path
+        bool m_VertexViewportIndex = false; // gl_ViewportIndex from the vertex shader, needed by the layered path
+        bool m_PointShadows = false;
+        PointShadowPath m_PointShadowPath = PointShadowPath::SingleFace;
+        std::vector<PointLightCulling> m_PointLightCulling; // Per scene light, rebuilt every frame
+        std::vector<ShadowAtlas::Request> m_AtlasRequests;
+        UniformBuffer m_FrameUniforms{PREPATH_UBO_FRAME, sizeof(FrameUniforms)};
+        UniformRing m_PassRing{PREPATH_UBO_PASS, 256 * 1024};
+        UniformRing m_ObjectRing{PREPATH_UBO_OBJECT};
+        std::vector<ObjectUniforms> m_ObjectUniforms;
+        bool m_ClusteredLighting = false;
+        bool m_MultiDrawIndirect = false;
+        unsigned int m_IndirectBuffer = 0;
+        unsigned int m_ObjectDataBuffer = 0;  // ObjectUniforms per queued draw and instance, read by object.glsl through aDrawID
+        unsigned int m_ObjectDataTexture = 0; // RGBA32I view of m_ObjectDataBuffer
+        std::vector<DrawArraysIndirectCommand> m_IndirectCommands;
+        std::vector<InstanceBatch> m_InstanceBatches;
+        std::vector<glm::mat4> m_InstanceTransforms;
+        std::vector<InstanceDraw> m_InstanceDraws;
+        std::vector<Shader *> m_PassPrograms; // Variants the running pass has set up
+        std::vector<ObjectUniforms> m_ImmediateObjects; // Gizmos and bounds
         std::shared_ptr<Texture> m_WhiteTex;
         std::shared_ptr<Shader> m_Shader;
         std::shared_ptr<Shader> m_DirectionalLightShader;
+        std::shared_ptr<Shader> m_DepthPrepassShader;
         std::shared_ptr<Shader> m_PointLightShader;
+        std::shared_ptr<Shader> m_PointLightFaceShader;
+        std::shared_ptr<Shader> m_PointLightParaboloidShader;
         std::shared_ptr<Shader> m_BoundsShader;
         std::shared_ptr<Shader> m_SkyboxShader;
         std::shared_ptr<Shader> m_GizmoShader;
+        std::shared_ptr<Shader> m_FeedbackShader;
+        std::shared_ptr<Shader> m_GBufferShader;
+        std::shared_ptr<Shader> m_DeferredDirectionalShader;
+        std::shared_ptr<Shader> m_DeferredPointLightShader;
+        std::shared_ptr<Shader> m_DeferredCompositeShader;
         std::shared_ptr<Mesh> m_BoundsMesh;
         std::shared_ptr<Mesh> m_SkyboxMesh;
         std::shared_ptr<Mesh> m_GizmoMesh;
         std::shared_ptr<Mesh> m_SphereMesh;
         unsigned int m_DepthFBO;
         unsigned int m_DepthTex;
+        unsigned int m_CascadePreviewTex = 0;
+        std::vector<glm::mat4> m_CascadeMatrices = std::vector<glm::mat4>(PREPATH_CSM_CASCADES, glm::mat4(1.0f));
+        std::array<float, PREPATH_CSM_CASCADES> m_CascadeSplits{}; // View-space far distance of each cascade
+        unsigned int m_FeedbackFBO = 0;
+        unsigned int m_FeedbackColor = 0;
+        unsigned int m_FeedbackDepth = 0;
+        int m_FeedbackWidth = 0;
+        int m_FeedbackHeight = 0;
+        int m_FeedbackFrame = 0;
+        std::vector<unsigned char> m_FeedbackData;
+        std::array<unsigned int, PREPATH_VT_FEEDBACK_READBACKS> m_FeedbackReadbacks{}; // Pixel pack buffers, oldest after m_FeedbackSlot
+        std::array<GLsync, PREPATH_VT_FEEDBACK_READBACKS> m_FeedbackFences{};          // Null when the slot holds no pending readback
+        size_t m_FeedbackSlot = 0;
+        unsigned int m_GBufferFBO = 0;
+        unsigned int m_GBufferAlbedo = 0; // RGBA8 albedo * tint
+        unsigned int m_GBufferNormal = 0; // RG16F octahedral world-space normal
+        unsigned int m_GBufferORM = 0;    // RGBA8 ao, roughness, metallic
+        unsigned int m_GBufferDepth = 0;
+        unsigned int m_LightingFBO = 0;
+        unsigned int m_LightingTex = 0;   // RGBA16F linear radiance, gamma corrected by the composite pass
+        int m_GBufferWidth = 0;
+        int m_GBufferHeight = 0;
+        std::shared_ptr<IBL> m_IBL;
+        std::shared_ptr<Cubemap> m_IBLSource;
+        bool m_IBLEnabled = false;
+        bool m_ShadersReady = false; // All pass programs linked, set once by updateShaderWarmup
+        unsigned int m_OverdrawQuery = 0; // GL_SAMPLES_PASSED of the pass that lays down depth
+        bool m_OverdrawQueryPending = false;
+        float m_OverdrawPixels = 1.0f;    // Pixels * samples covered by the pending query
+        float m_Overdraw = 0.0f;
+        bool m_AutoDepthPrepass = false;
+        int m_DepthPrepassHold = 0;
         glm::mat4 m_LastView;
         glm::mat4 m_LastProjection;
     };
@@ -1,99 +1,186 @@
 #include "Shader.h"
 #include "Error.h"
+#include "GLState.h"
+#include "Hash.h"
+#include <cstring>
+
+#define PREPATH_SHADER_CACHE_MAGIC (0x42535050) // "PPSB"
+#define PREPATH_SHADER_CACHE_VERSION (2)
 
 namespace Prepath
 {
-    GLuint compileShader(GLenum type, const char *source)
+    namespace
     {
-        GLuint shader = glCreateShader(type);
-        glShaderSource(shader, 1, &source, nullptr);
-        glCompileShader(shader);
-
-        GLint success;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success)
+        bool programBinarySupported()
         {
-            char infoLog[512];
-            glGetShaderInfoLog(shader, 512, nullptr, infoLog);
-            PREPATH_LOG_ERROR("Shader compilation error: {}", infoLog);
+            // Some drivers expose the entry points with zero formats, which means binaries are never returned
+            static const bool supported = []
+            {
+                if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+                    return false;
+                GLint formats = 0;
+                glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+                return formats > 0;
+            }();
+            return supported;
         }
 
-        return shader;
-    }
-
-    GLuint createShaderProgram(const char *vertexSource, const char *fragmentSource)
-    {
-        GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
-        GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-        GLuint program = glCreateProgram();
-        glAttachShader(program, vertex);
-        glAttachShader(program, fragment);
-        glLinkProgram(program);
-
-        GLint success;
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success)
+        // Returns 0 when the file is missing or damaged or the driver rejects the binary
+        GLuint loadProgramBinary(const std::string &path)
         {
-            char infoLog[512];
-            glGetProgramInfoLog(program, 512, nullptr, infoLog);
-            PREPATH_LOG_ERROR("Shader linking error: {}", infoLog);
+            if (!std::filesystem::exists(path))
+                return 0;
+
+            // The size field is checked against the file before anything is allocated, a bad entry is deleted
+            // so the source build below can write a fresh one
+            std::error_code error;
+            uintmax_t fileSize = std::filesystem::file_size(path, error);
+            std::vector<char> binary;
+            uint32_t header[4] = {}; // Magic, version, binary format, binary size
+            {
+                std::ifstream file(path, std::ios::binary);
+                file.read(reinterpret_cast<char *>(header), sizeof(header));
+                if (file && !error && header[0] == PREPATH_SHADER_CACHE_MAGIC && header[1] == PREPATH_SHADER_CACHE_VERSION &&
+                    header[3] > 0 && uintmax_t(header[3]) == fileSize - sizeof(header))
+                {
+                    binary.resize(header[3]);
+                    file.read(binary.data(), std::streamsize(binary.size()));
+                    if (!file)
+                        binary.clear();
+                }
+            }
+            if (binary.empty())
+            {
+                PREPATH_LOG_WARN("Ignoring invalid shader cache: {}", path);
+                std::filesystem::remove(path, error);
+                return 0;
+            }
+
+            GLuint program = glCreateProgram();
+            glProgramBinary(program, GLenum(header[2]), binary.data(), GLsizei(binary.size()));
+            GLint success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                // Usually a driver update, the source build below replaces the file
+                PREPATH_LOG_WARN("Shader cache rejected by the driver, compiling from source: {}", path);
+                glDeleteProgram(program);
+                return 0;
+            }
+            return program;
         }
 
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
-        return program;
-    }
-
-    GLuint createShaderProgram(const char *vertexSource, const char *geometrySource, const char *fragmentSource)
-    {
-        GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
-        GLuint geometry = compileShader(GL_GEOMETRY_SHADER, geometrySource);
-        GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-        GLuint program = glCreateProgram();
-        glAttachShader(program, vertex);
-        glAttachShader(program, geometry);
-        glAttachShader(program, fragment);
-        glLinkProgram(program);
+        void saveProgramBinary(GLuint program, const std::string &path)
+        {
+            GLint linked = 0;
+            GLint length = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+            if (!linked || length <= 0)
+                return;
+
+            std::vector<char> binary(static_cast<size_t>(length));
+            GLenum format = 0;
+            glGetProgramBinary(program, length, &length, &format, binary.data());
+
+            std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+            std::ofstream file(path, std::ios::binary);
+            if (!file)
+            {
+                PREPATH_LOG_WARN("Failed to write shader cache: {}", path);
+                return;
+            }
+            uint32_t header[4] = {PREPATH_SHADER_CACHE_MAGIC, PREPATH_SHADER_CACHE_VERSION, uint32_t(format), uint32_t(length)};
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+            file.write(binary.data(), length);
+        }
 
-        GLint success;
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (!success)
+        bool parallelCompileSupported()
         {
-            char infoLog[512];
-            glGetProgramInfoLog(program, 512, nullptr, infoLog);
-            PREPATH_LOG_ERROR("Shader linking error: {}", infoLog);
+            // Lets the driver use as many compiler threads as it likes, the first call also raises the limit
+            static const bool supported = []
+            {
+                if (GLAD_GL_KHR_parallel_shader_compile)
+                    glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+                else if (GLAD_GL_ARB_parallel_shader_compile)
+                    glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+                else
+                    return false;
+                return true;
+            }();
+            return supported;
         }
 
-        glDeleteShader(vertex);
-        glDeleteShader(geometry);
-        glDeleteShader(fragment);
+        // Status is left to Shader::finish, asking for it here would wait on the compiler
+        GLuint compileShader(GLenum type, const char *source)
+        {
+            GLuint shader = glCreateShader(type);
+            glShaderSource(shader, 1, &source, nullptr);
+            glCompileShader(shader);
+            return shader;
+        }
 
-        return program;
+        // Feature defines go right after #version, which has to stay the first line
+        std::string injectDefines(const std::string &source, uint32_t features)
+        {
+            std::string defines;
+            if (features & PREPATH_SHADER_NORMAL_MAP)
+                defines += "#define NORMAL_MAP\n";
+            if (features & PREPATH_SHADER_ORM_MAPS)
+                defines += "#define ORM_MAPS\n";
+            if (features & PREPATH_SHADER_SKY_LIGHT)
+                defines += "#define SKY_LIGHT\n";
+            if (features & PREPATH_SHADER_IBL)
+                defines += "#define IBL\n";
+            defines += std::format("#define DEBUG_VIEW {}\n", (features & PREPATH_SHADER_DEBUG_MASK) >> PREPATH_SHADER_DEBUG_SHIFT);
+
+            if (source.rfind("#version", 0) != 0)
+                return defines + "#line 1\n" + source;
+            size_t lineEnd = source.find('\n');
+            if (lineEnd == std::string::npos)
+                return source + "\n" + defines;
+            return source.substr(0, lineEnd + 1) + defines + "#line 2\n" + source.substr(lineEnd + 1);
+        }
     }
 
     Shader::Shader() {}
     Shader::~Shader()
     {
+        for (GLuint stage : m_Stages)
+            glDeleteShader(stage);
         if (m_ShaderProgram)
             glDeleteProgram(m_ShaderProgram);
     }
 
     void Shader::bind()
     {
-        glUseProgram(m_ShaderProgram);
+        // Programs bound before they were polled ready are waited on here
+        wait();
+        GLState::getGlobalState().useProgram(m_ShaderProgram);
     }
     std::shared_ptr<Shader> Shader::generateShader(const char *vertexSource,
                                                    const char *fragmentSource)
+    {
+        auto shader = generateShaderAsync(vertexSource, fragmentSource);
+        shader->wait();
+        return shader;
+    }
+
+    std::shared_ptr<Shader> Shader::generateShader(const char *vertexSource, const char *geometrySource, const char *fragmentSource)
+    {
+        auto shader = generateShaderAsync(vertexSource, geometrySource, fragmentSource);
+        shader->wait();
+        return shader;
+    }
+
+    std::shared_ptr<Shader> Shader::generateShaderAsync(const char *vertexSource, const char *fragmentSource)
     {
         auto shader = std::make_shared<Shader>();
         shader->setupShader(vertexSource, fragmentSource);
         return shader;
     }
 
-    std::shared_ptr<Shader> Shader::generateShader(const char *vertexSource, const char *geometrySource, const char *fragmentSource)
+    std::shared_ptr<Shader> Shader::generateShaderAsync(const char *vertexSource, const char *geometrySource, const char *fragmentSource)
     {
         auto shader = std::make_shared<Shader>();
         shader->setupShader(vertexSource, geometrySource, fragmentSource);
@@ -103,12 +190,184 @@ namespace Prepath
     void Shader::setupShader(const char *vertexSource,
                              const char *fragmentSource)
     {
-        m_ShaderProgram = createShaderProgram(vertexSource, fragmentSource);
+        m_VertexSource = vertexSource;
+        m_FragmentSource = fragmentSource;
+        submit();
     }
 
     void Shader::setupShader(const char *vertexSource, const char *geometrySource, const char *fragmentSource)
     {
-        m_ShaderProgram = createShaderProgram(vertexSource, geometrySource, fragmentSource);
+        m_VertexSource = vertexSource;
+        m_GeometrySource = geometrySource;
+        m_FragmentSource = fragmentSource;
+        submit();
+    }
+
+    void Shader::submit()
+    {
+        std::string vertex = injectDefines(m_VertexSource, m_Features);
+        std::string geometry = m_GeometrySource.empty() ? std::string() : injectDefines(m_GeometrySource, m_Features);
+        std::string fragment = injectDefines(m_FragmentSource, m_Features);
+
+        // ---- Binary Cache ----
+        // Keyed by the expanded sources, which carry the feature defines, and by the driver that built the binary
+        m_CachePath.clear();
+        if (programBinarySupported())
+        {
+            uint64_t key = PREPATH_HASH_SEED;
+            const uint32_t params[] = {PREPATH_SHADER_CACHE_VERSION, m_Features};
+            key = hashBytes(key, params, sizeof(params));
+            for (const std::string *source : {&vertex, &geometry, &fragment})
+            {
+                uint64_t size = source->size();
+                key = hashBytes(key, &size, sizeof(size));
+                key = hashBytes(key, source->data(), source->size());
+            }
+            for (GLenum name : {GL_RENDERER, GL_VERSION})
+            {
+                const char *text = reinterpret_cast<const char *>(glGetString(name));
+                if (text)
+                    key = hashBytes(key, text, std::strlen(text));
+            }
+            m_CachePath = PREPATH_GET_CACHE(std::format("shader_{:016x}.bin", key));
+        }
+
+        m_ShaderProgram = m_CachePath.empty() ? 0 : loadProgramBinary(m_CachePath);
+        if (m_ShaderProgram)
+        {
+            m_CachePath.clear();
+            // Block bindings are not part of the binary
+            bindUniformBlocks();
+            return;
+        }
+
+        // ---- Source Build ----
+        // Compile and link are only issued here, status is read in finish() so the driver can overlap programs
+        parallelCompileSupported();
+        m_ShaderProgram = glCreateProgram();
+        if (programBinarySupported())
+            glProgramParameteri(m_ShaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        m_Stages.push_back(compileShader(GL_VERTEX_SHADER, vertex.c_str()));
+        if (!geometry.empty())
+            m_Stages.push_back(compileShader(GL_GEOMETRY_SHADER, geometry.c_str()));
+        m_Stages.push_back(compileShader(GL_FRAGMENT_SHADER, fragment.c_str()));
+        for (GLuint stage : m_Stages)
+            glAttachShader(m_ShaderProgram, stage);
+        glLinkProgram(m_ShaderProgram);
+        m_Pending = true;
+    }
+
+    void Shader::finish()
+    {
+        if (!m_Pending)
+            return;
+        m_Pending = false;
+
+        for (GLuint stage : m_Stages)
+        {
+            GLint success;
+            glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                char infoLog[512];
+                glGetShaderInfoLog(stage, 512, nullptr, infoLog);
+                PREPATH_LOG_ERROR("Shader compilation error: {}", infoLog);
+            }
+            glDeleteShader(stage);
+        }
+        m_Stages.clear();
+
+        GLint success;
+        glGetProgramiv(m_ShaderProgram, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            char infoLog[512];
+            glGetProgramInfoLog(m_ShaderProgram, 512, nullptr, infoLog);
+            PREPATH_LOG_ERROR("Shader linking error: {}", infoLog);
+        }
+        else if (!m_CachePath.empty())
+        {
+            saveProgramBinary(m_ShaderProgram, m_CachePath);
+        }
+        m_CachePath.clear();
+        bindUniformBlocks();
+    }
+
+    bool Shader::isReady()
+    {
+        if (m_Pending && parallelCompileSupported())
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(m_ShaderProgram, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        finish();
+        return true;
+    }
+
+    void Shader::wait()
+    {
+        finish();
+    }
+
+    Shader &Shader::submitVariant(uint32_t features)
+    {
+        m_Permuted = true;
+        if (features == m_Features)
+            return *this;
+        auto it = m_Variants.find(features);
+        if (it != m_Variants.end())
+            return *it->second;
+
+        auto variant = std::make_unique<Shader>();
+        variant->m_VertexSource = m_VertexSource;
+        variant->m_GeometrySource = m_GeometrySource;
+        variant->m_FragmentSource = m_FragmentSource;
+        variant->m_Features = features;
+        variant->m_Permuted = true;
+        variant->submit();
+        PREPATH_LOG_INFO("Building shader variant #{} (features {:#x})", variant->m_ShaderProgram, features);
+        return *m_Variants.emplace(features, std::move(variant)).first->second;
+    }
+
+    Shader *Shader::requestVariant(uint32_t features)
+    {
+        Shader &variant = submitVariant(features);
+        return variant.isReady() ? &variant : nullptr;
+    }
+
+    Shader &Shader::getVariant(uint32_t features)
+    {
+        Shader &variant = submitVariant(features);
+        variant.wait();
+        return variant;
+    }
+
+    size_t Shader::pollVariants()
+    {
+        size_t pending = 0;
+        for (auto &[features, variant] : m_Variants)
+        {
+            if (!variant->isReady())
+                pending++;
+        }
+        return pending;
+    }
+
+    void Shader::bindUniformBlocks()
+    {
+        // GLSL 3.30 has no layout(binding), so the shared blocks are wired up by name
+        bindUniformBlock("FrameBlock", PREPATH_UBO_FRAME);
+        bindUniformBlock("PassBlock", PREPATH_UBO_PASS);
+        bindUniformBlock("ObjectBlock", PREPATH_UBO_OBJECT);
+    }
+
+    void Shader::bindUniformBlock(const std::string &name, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(m_ShaderProgram, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(m_ShaderProgram, index, binding);
     }
 
     GLint Shader::getUniformLocation(const std::string &name) const
@@ -118,7 +377,7 @@ namespace Prepath
             return it->second;
 
         GLint location = glGetUniformLocation(m_ShaderProgram, name.c_str());
-        if (location == -1)
+        if (location == -1 && !m_Permuted)
         {
             PREPATH_LOG_WARN("Warning: uniform '{}' doesn't exist in shader #{}!", name.c_str(), m_ShaderProgram);
         }
@@ -181,4 +440,14 @@ namespace Prepath
     {
         glUniformMatrix4fv(getUniformLocation(name), static_cast<GLsizei>(matrices.size()), GL_FALSE, glm::value_ptr(matrices[0]));
     }
+
+    void Shader::setUniform1iArray(const std::string &name, const int *values, int count)
+    {
+        glUniform1iv(getUniformLocation(name), count, values);
+    }
+
+    void Shader::setUniform2fArray(const std::string &name, const glm::vec2 *values, int count)
+    {
+        glUniform2fv(getUniformLocation(name), count, glm::value_ptr(values[0]));
+    }
 } // namespace Prepath
\ No newline at end of file
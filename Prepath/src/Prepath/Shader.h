@@ -5,6 +5,15 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Context.h"
+#include "UniformBuffer.h"
+
+// Permutation feature bits, each compiled in as a #define (see Shader::getVariant)
+#define PREPATH_SHADER_NORMAL_MAP (1u << 0) // NORMAL_MAP: tangent space normal map, otherwise the vertex normal
+#define PREPATH_SHADER_ORM_MAPS (1u << 1)   // ORM_MAPS: roughness, metallic and AO maps, otherwise the generateMaterial placeholders
+#define PREPATH_SHADER_SKY_LIGHT (1u << 2)  // SKY_LIGHT: Scene::hasSkyLight, directional light shadows, otherwise fully shadowed
+#define PREPATH_SHADER_IBL (1u << 3)        // IBL: image based ambient instead of the flat term
+#define PREPATH_SHADER_DEBUG_SHIFT (4)      // DEBUG_VIEW: RenderSettings::showTexture, 0 = lit
+#define PREPATH_SHADER_DEBUG_MASK (0xFu << PREPATH_SHADER_DEBUG_SHIFT)
 
 namespace Prepath
 {
@@ -19,6 +28,14 @@ namespace Prepath
         static std::shared_ptr<Shader> generateShader(const char *vertexSource, const char *fragmentSource);
         static std::shared_ptr<Shader> generateShader(const char *vertexSource, const char *geometrySource, const char *fragmentSource);
 
+        // ---- Async Methods ----
+        // Only submits compile and link, the program is usable once isReady returns true or after wait()
+        static std::shared_ptr<Shader> generateShaderAsync(const char *vertexSource, const char *fragmentSource);
+        static std::shared_ptr<Shader> generateShaderAsync(const char *vertexSource, const char *geometrySource, const char *fragmentSource);
+        // Polls GL_COMPLETION_STATUS_KHR, without GL_KHR/ARB_parallel_shader_compile it waits for the build instead
+        bool isReady();
+        void wait();
+
         void setUniform1i(const std::string &name, int value);
         void setUniform1f(const std::string &name, float value);
         void setUniform2f(const std::string &name, const glm::vec2 &value);
@@ -30,15 +47,43 @@ namespace Prepath
         void setUniformMat3f(const std::string &name, const glm::mat3 &matrix);
         void setUniformMat4f(const std::string &name, const glm::mat4 &matrix);
         void setUniformMat4fArray(const std::string &name, const std::vector<glm::mat4> &matrices);
+        void setUniform1iArray(const std::string &name, const int *values, int count);
+        void setUniform2fArray(const std::string &name, const glm::vec2 *values, int count);
+        // Points a std140 block at a binding, blocks the program does not use are ignored
+        void bindUniformBlock(const std::string &name, GLuint binding);
+
+        // ---- Permutation Methods ----
+        // Same sources compiled with the PREPATH_SHADER_* features of the mask defined, built on first use and
+        // kept in this shader's variant table. This shader itself is the variant without features.
+        Shader &getVariant(uint32_t features);
+        // Starts building the variant without waiting, for prewarming
+        Shader &submitVariant(uint32_t features);
+        // Ready variant or nullptr while it is still compiling, never waits when isReady does not
+        Shader *requestVariant(uint32_t features);
+        // Finishes the variants whose build completed and returns how many are still compiling
+        size_t pollVariants();
+        uint32_t getFeatures() const { return m_Features; }
+        size_t getVariantCount() const { return m_Variants.size(); }
 
     private:
         GLint getUniformLocation(const std::string &name) const;
         void setupShader(const char *vertexSource, const char *fragmentSource);
         void setupShader(const char *vertexSource, const char *geometrySource, const char *fragmentSource);
+        void submit();
+        void finish();
+        void bindUniformBlocks();
 
     private:
         mutable std::unordered_map<std::string, GLint> m_UniformLocationCache;
-        GLuint m_ShaderProgram;
+        GLuint m_ShaderProgram = 0;
+        std::vector<GLuint> m_Stages; // Shader objects of a build that is still pending
+        bool m_Pending = false;       // Linked but the status has not been read yet
+        std::string m_CachePath;      // Binary cache written once the pending build succeeds
+
+        std::string m_VertexSource, m_GeometrySource, m_FragmentSource; // Geometry empty when unused
+        uint32_t m_Features = 0;
+        bool m_Permuted = false; // Part of a variant table, compiled out features leave uniforms missing
+        std::unordered_map<uint32_t, std::unique_ptr<Shader>> m_Variants;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "ShadowAtlas.h"
+#include "Error.h"
+#include "GLState.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+namespace Prepath
+{
+    namespace
+    {
+        constexpr int MAX_LEVEL = std::countr_zero(unsigned(PREPATH_POINT_SHADOW_MAX_FACE / PREPATH_POINT_SHADOW_MIN_FACE));
+
+        // Minimum size tiles taken by one face of the given level
+        size_t faceUnits(int level)
+        {
+            return size_t(1) << (2 * (MAX_LEVEL - level));
+        }
+
+        uint32_t compactBits(uint32_t value)
+        {
+            value &= 0x55555555u;
+            value = (value | (value >> 1)) & 0x33333333u;
+            value = (value | (value >> 2)) & 0x0F0F0F0Fu;
+            value = (value | (value >> 4)) & 0x00FF00FFu;
+            value = (value | (value >> 8)) & 0x0000FFFFu;
+            return value;
+        }
+    }
+
+    ShadowAtlas::ShadowAtlas()
+    {
+        glGenBuffers(1, &m_FaceBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_FaceBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+        glGenTextures(1, &m_FaceTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, m_FaceTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_FaceBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    ShadowAtlas::~ShadowAtlas()
+    {
+        if (m_Framebuffer)
+            glDeleteFramebuffers(1, &m_Framebuffer);
+        if (m_Texture)
+            glDeleteTextures(1, &m_Texture);
+        glDeleteTextures(1, &m_FaceTexture);
+        glDeleteBuffers(1, &m_FaceBuffer);
+    }
+
+    void ShadowAtlas::configure(ShadowDepthFormat format, size_t budgetBytes)
+    {
+        // 24 bit depth is padded to 32 bits by the drivers
+        size_t texelBytes = format == ShadowDepthFormat::Depth16 ? 2 : 4;
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        int size = PREPATH_POINT_SHADOW_MAX_FACE;
+        while (size * 2 <= maxSize && size_t(size) * 2 * size_t(size) * 2 * texelBytes <= budgetBytes)
+            size *= 2;
+        if (size == m_Size && format == m_Format && m_Texture)
+            return;
+
+        // Unbound through GLState first, a recycled name would otherwise look like it is still bound
+        auto &state = GLState::getGlobalState();
+        if (m_Framebuffer)
+        {
+            state.bindFramebuffer(0);
+            glDeleteFramebuffers(1, &m_Framebuffer);
+        }
+        if (m_Texture)
+        {
+            state.bindTexture(13, GL_TEXTURE_2D, 0);
+            glDeleteTextures(1, &m_Texture);
+        }
+        m_Size = size;
+        m_Format = format;
+        m_Reallocated = true;
+
+        // Created on the unit the renderer samples the atlas from
+        glGenTextures(1, &m_Texture);
+        state.bindTexture(13, GL_TEXTURE_2D, m_Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format == ShadowDepthFormat::Depth16 ? GL_DEPTH_COMPONENT16 : GL_DEPTH_COMPONENT24,
+                     size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &m_Framebuffer);
+        state.bindFramebuffer(m_Framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_Texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            PREPATH_LOG_ERROR("Point shadow atlas framebuffer is not complete!");
+        state.bindFramebuffer(0);
+
+        PREPATH_LOG_INFO("Point shadow atlas: {}x{}, {} MB", size, size, getMemoryUsage() / (1024 * 1024));
+    }
+
+    void ShadowAtlas::allocate(std::span<const Request> requests)
+    {
+        size_t count = requests.size();
+        m_States.resize(count);
+        m_Allocations.resize(count);
+        m_Moved.assign(count, false);
+        m_FaceCount = 0;
+        m_SkippedFaceCount = 0;
+        m_DroppedLightCount = 0;
+
+        // ---- Resolution ----
+        // Each halving of the projected size drops one level, a new level has to hold before the tiles move
+        std::vector<int> levels(count, -1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Request &request = requests[i];
+            LightState &state = m_States[i];
+            if (request.faceMask == 0)
+            {
+                state = LightState();
+                continue;
+            }
+            m_SkippedFaceCount += 6 - std::popcount(request.faceMask);
+
+            int wanted = request.importance >= 1.0f ? 0 : std::clamp(int(std::floor(-std::log2(std::max(request.importance, 1e-6f)))), 0, MAX_LEVEL);
+            if (state.level < 0 || wanted == state.level)
+            {
+                state.level = wanted;
+                state.wantedFrames = 0;
+            }
+            else
+            {
+                state.wantedFrames = wanted == state.wantedLevel ? state.wantedFrames + 1 : 1;
+                state.wantedLevel = wanted;
+                if (state.wantedFrames >= PREPATH_POINT_SHADOW_HOLD_FRAMES)
+                {
+                    state.level = wanted;
+                    state.wantedFrames = 0;
+                }
+            }
+            levels[i] = state.level;
+        }
+
+        // ---- Budget ----
+        // Least important lights shrink first, once all are at the minimum they are dropped
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                         { return requests[a].importance < requests[b].importance; });
+
+        size_t capacity = size_t(m_Size / PREPATH_POINT_SHADOW_MIN_FACE) * size_t(m_Size / PREPATH_POINT_SHADOW_MIN_FACE);
+        size_t used = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (levels[i] >= 0)
+                used += faceUnits(levels[i]) * std::popcount(requests[i].faceMask);
+        }
+        while (used > capacity)
+        {
+            bool shrunk = false;
+            for (size_t i : order)
+            {
+                if (used <= capacity)
+                    break;
+                if (levels[i] < 0 || levels[i] == MAX_LEVEL)
+                    continue;
+                int faces = std::popcount(requests[i].faceMask);
+                used -= faceUnits(levels[i]) * faces;
+                levels[i]++;
+                used += faceUnits(levels[i]) * faces;
+                shrunk = true;
+            }
+            if (shrunk)
+                continue;
+
+            for (size_t i : order)
+            {
+                if (used <= capacity)
+                    break;
+                if (levels[i] < 0)
+                    continue;
+                used -= faceUnits(levels[i]) * std::popcount(requests[i].faceMask);
+                levels[i] = -1;
+                m_DroppedLightCount++;
+            }
+        }
+
+        // ---- Packing ----
+        // Sorted largest first, every tile starts on a multiple of its own area along the curve and stays aligned
+        std::vector<size_t> packing;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (levels[i] >= 0)
+                packing.push_back(i);
+        }
+        std::sort(packing.begin(), packing.end(), [&](size_t a, size_t b)
+                  { return levels[a] != levels[b] ? levels[a] < levels[b] : a < b; });
+
+        std::vector<Allocation> allocations(count);
+        size_t cursor = 0;
+        for (size_t i : packing)
+        {
+            Allocation &allocation = allocations[i];
+            allocation.faceSize = PREPATH_POINT_SHADOW_MAX_FACE >> levels[i];
+            allocation.faceMask = requests[i].faceMask;
+            allocation.paraboloid = requests[i].paraboloid;
+            for (int face = 0; face < 6; ++face)
+            {
+                if ((allocation.faceMask & (1u << face)) == 0)
+                    continue;
+                glm::ivec2 tile(compactBits(uint32_t(cursor)), compactBits(uint32_t(cursor >> 1)));
+                allocation.tiles[face] = tile * PREPATH_POINT_SHADOW_MIN_FACE;
+                cursor += faceUnits(levels[i]);
+                m_FaceCount++;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Allocation &previous = m_Allocations[i];
+            Allocation &allocation = allocations[i];
+            bool same = !m_Reallocated && previous.faceSize == allocation.faceSize && previous.faceMask == allocation.faceMask &&
+                        previous.paraboloid == allocation.paraboloid;
+            for (int face = 0; face < 6 && same; ++face)
+            {
+                if (allocation.faceMask & (1u << face))
+                    same = previous.tiles[face] == allocation.tiles[face];
+            }
+            allocation.rendered = same && previous.rendered;
+            m_Moved[i] = !same;
+            previous = allocation;
+        }
+        m_Reallocated = false;
+    }
+
+    void ShadowAtlas::markRendered(size_t light)
+    {
+        if (light < m_Allocations.size())
+            m_Allocations[light].rendered = true;
+    }
+
+    void ShadowAtlas::upload()
+    {
+        m_FaceData.assign(m_Allocations.size() * 6 * 4, 0.0f);
+        float texel = 1.0f / float(std::max(m_Size, 1));
+        for (size_t i = 0; i < m_Allocations.size(); ++i)
+        {
+            const Allocation &allocation = m_Allocations[i];
+            if (!allocation.rendered)
+                continue;
+            for (int face = 0; face < 6; ++face)
+            {
+                // The mode is repeated in every texel, the cube face lookup then finds it without an extra fetch
+                float *rect = &m_FaceData[(i * 6 + face) * 4];
+                rect[3] = allocation.paraboloid ? 1.0f : 0.0f;
+                if ((allocation.faceMask & (1u << face)) == 0)
+                    continue;
+                rect[0] = float(allocation.tiles[face].x) * texel;
+                rect[1] = float(allocation.tiles[face].y) * texel;
+                rect[2] = float(allocation.faceSize) * texel;
+            }
+        }
+
+        // Orphan the old store, the texture buffer keeps pointing at the buffer object
+        size_t size = m_FaceData.size() * sizeof(float);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_FaceBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(size, size_t(16)), nullptr, GL_STREAM_DRAW);
+        if (size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, m_FaceData.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+}
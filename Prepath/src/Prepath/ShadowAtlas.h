@@ -0,0 +1,97 @@
+#pragma once
+#include <array>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+#define PREPATH_POINT_SHADOW_MAX_FACE (512)   // Face resolution of the most important lights
+#define PREPATH_POINT_SHADOW_MIN_FACE (64)    // Lights that would drop below this lose their shadow
+#define PREPATH_POINT_SHADOW_HOLD_FRAMES (30) // Frames a light has to want another resolution before it moves
+
+namespace Prepath
+{
+    enum class ShadowDepthFormat
+    {
+        Depth16,
+        Depth24
+    };
+
+    // Shared depth atlas of all point light shadows. Every light gets one square tile per cubemap face (or paraboloid
+    // hemisphere) that holds casters, sized by its screen importance, so the memory is fixed by the budget instead of the light count.
+    // Tiles are packed largest first along a Z-order curve, which keeps power of two tiles aligned without a free list.
+    class ShadowAtlas
+    {
+    public:
+        struct Request
+        {
+            float importance = 0.0f; // Projected size on screen, 1 = light covers the view
+            uint32_t faceMask = 0;   // Faces with casters, 0 = no shadow
+            bool paraboloid = false; // Two hemispheres in faces 0 (+Z) and 1 (-Z) instead of six cube faces
+        };
+
+        struct Allocation
+        {
+            int faceSize = 0;
+            uint32_t faceMask = 0;          // Faces with a tile, empty when the light did not fit
+            bool paraboloid = false;
+            std::array<glm::ivec2, 6> tiles{}; // Texel offsets of the tiles in faceMask
+            bool rendered = false;          // Tiles hold this light's depth
+        };
+
+        ShadowAtlas();
+        ~ShadowAtlas();
+
+        ShadowAtlas(const ShadowAtlas &) = delete;
+        ShadowAtlas &operator=(const ShadowAtlas &) = delete;
+
+        // Recreates the texture when format or budget changed, the side is the largest power of two inside the budget
+        void configure(ShadowDepthFormat format, size_t budgetBytes);
+        // Packs the lights of this frame, requests are indexed like Scene::getPointLights
+        void allocate(std::span<const Request> requests);
+        // Tiles changed this frame, the light has to be redrawn before it can be sampled
+        bool hasMoved(size_t light) const { return light < m_Moved.size() && m_Moved[light]; }
+        void markRendered(size_t light);
+        // Writes the face rectangles of rendered lights to the face buffer
+        void upload();
+
+        const Allocation &getAllocation(size_t light) const { return m_Allocations[light]; }
+        // Mode of the last allocation, false for lights that were not packed
+        bool isParaboloid(size_t light) const { return light < m_Allocations.size() && m_Allocations[light].paraboloid; }
+        GLuint getTexture() const { return m_Texture; }
+        GLuint getFramebuffer() const { return m_Framebuffer; }
+        // RGBA32F, 6 texels per light: uv offset, uv size (0 = unshadowed), 1 in w for dual-paraboloid lights
+        GLuint getFaceTexture() const { return m_FaceTexture; }
+        int getSize() const { return m_Size; }
+
+        // ---- Statistics Methods ----
+        int getFaceCount() const { return m_FaceCount; }
+        int getSkippedFaceCount() const { return m_SkippedFaceCount; } // Faces without casters
+        int getDroppedLightCount() const { return m_DroppedLightCount; }
+        size_t getMemoryUsage() const { return size_t(m_Size) * size_t(m_Size) * (m_Format == ShadowDepthFormat::Depth16 ? 2 : 4); }
+
+    private:
+        struct LightState
+        {
+            int level = -1; // Face size is PREPATH_POINT_SHADOW_MAX_FACE >> level
+            int wantedLevel = -1;
+            int wantedFrames = 0;
+        };
+
+        GLuint m_Texture = 0;
+        GLuint m_Framebuffer = 0;
+        GLuint m_FaceBuffer = 0, m_FaceTexture = 0;
+        ShadowDepthFormat m_Format = ShadowDepthFormat::Depth16;
+        int m_Size = 0;
+        bool m_Reallocated = false;
+
+        std::vector<Allocation> m_Allocations;
+        std::vector<LightState> m_States;
+        std::vector<bool> m_Moved;
+        std::vector<float> m_FaceData;
+
+        int m_FaceCount = 0;
+        int m_SkippedFaceCount = 0;
+        int m_DroppedLightCount = 0;
+    };
+}
@@ -0,0 +1,243 @@
+#include "ShadowScheduler.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Prepath
+{
+    namespace
+    {
+        bool sphereIntersects(const AABB &box, const glm::vec3 &center, float radius)
+        {
+            glm::vec3 offset = glm::clamp(center, box.min, box.max) - center;
+            return glm::dot(offset, offset) <= radius * radius;
+        }
+
+        bool sameBounds(const AABB &a, const AABB &b)
+        {
+            return a.min == b.min && a.max == b.max;
+        }
+    }
+
+    void ShadowScheduler::invalidate()
+    {
+        m_Invalidated = true;
+    }
+
+    void ShadowScheduler::invalidatePointLight(const PointLight *light)
+    {
+        auto it = m_Lights.find(light);
+        if (it != m_Lights.end())
+            it->second.dirty = true;
+    }
+
+    void ShadowScheduler::trackInstances(const Mesh *mesh, std::span<const glm::mat4> transforms)
+    {
+        if (mesh && !transforms.empty())
+            m_SubmittedInstances.push_back({mesh, transforms});
+    }
+
+    void ShadowScheduler::collectChangedBounds(const Scene &scene)
+    {
+        m_ChangedBounds.clear();
+        for (const auto &mesh : scene.getMeshes())
+        {
+            auto [it, inserted] = m_Meshes.try_emplace(mesh.get());
+            MeshState &state = it->second;
+            state.frame = m_Frame;
+
+            bool moved = inserted || std::memcmp(&state.model, &mesh->modelMatrix, sizeof(glm::mat4)) != 0;
+            if (!moved && state.hidden == mesh->hidden)
+                continue;
+
+            // Hidden meshes cast nothing, so only their visibility edges matter
+            if (!inserted && !state.hidden)
+                m_ChangedBounds.push_back(state.worldBounds);
+            if (moved)
+            {
+                state.model = mesh->modelMatrix;
+                state.worldBounds = mesh->bounds * mesh->modelMatrix;
+            }
+            state.hidden = mesh->hidden;
+            if (!state.hidden)
+                m_ChangedBounds.push_back(state.worldBounds);
+        }
+
+        // Meshes removed from the scene
+        for (auto it = m_Meshes.begin(); it != m_Meshes.end();)
+        {
+            if (it->second.frame != m_Frame)
+            {
+                if (!it->second.hidden)
+                    m_ChangedBounds.push_back(it->second.worldBounds);
+                it = m_Meshes.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // Instanced batches are resubmitted every frame, a changed transform hash moves the whole batch
+        std::unordered_map<const Mesh *, size_t> batchCounts;
+        for (const SubmittedInstances &submitted : m_SubmittedInstances)
+        {
+            std::vector<InstanceState> &states = m_Instances[submitted.mesh];
+            size_t index = batchCounts[submitted.mesh]++;
+            bool inserted = index >= states.size();
+            if (inserted)
+                states.emplace_back();
+            InstanceState &state = states[index];
+
+            uint64_t count = submitted.transforms.size();
+            uint64_t hash = hashBytes(PREPATH_HASH_SEED, &count, sizeof(count));
+            hash = hashBytes(hash, submitted.transforms.data(), submitted.transforms.size_bytes());
+            if (!inserted && state.hash == hash)
+                continue;
+
+            if (!inserted)
+                m_ChangedBounds.push_back(state.worldBounds);
+            state.hash = hash;
+            state.worldBounds = submitted.mesh->bounds * submitted.transforms[0];
+            for (size_t i = 1; i < submitted.transforms.size(); ++i)
+                state.worldBounds = AABB(state.worldBounds, submitted.mesh->bounds * submitted.transforms[i]);
+            m_ChangedBounds.push_back(state.worldBounds);
+        }
+        m_SubmittedInstances.clear();
+
+        // Batches no longer submitted, always the tail of their mesh's list
+        for (auto it = m_Instances.begin(); it != m_Instances.end();)
+        {
+            auto count = batchCounts.find(it->first);
+            size_t kept = count != batchCounts.end() ? count->second : 0;
+            for (size_t i = kept; i < it->second.size(); ++i)
+                m_ChangedBounds.push_back(it->second[i].worldBounds);
+            it->second.resize(kept);
+            if (kept == 0)
+                it = m_Instances.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void ShadowScheduler::update(const Scene &scene, const Frustum &cameraFrustum, const glm::vec3 &cameraPos, int budget)
+    {
+        m_Frame++;
+        m_RefreshedCount = 0;
+        m_ReusedCount = 0;
+        m_DeferredCount = 0;
+
+        collectChangedBounds(scene);
+        bool invalidated = m_Invalidated;
+        m_Invalidated = false;
+
+        // ---- Directional ----
+        // The directional map covers the whole scene, so any caster change dirties it
+        if (invalidated || !m_ChangedBounds.empty() || scene.lightDir != m_LightDir || !sameBounds(scene.bounds, m_SceneBounds) ||
+            (scene.hasSkyLight && !m_HadSkyLight))
+        {
+            m_DirectionalDirty = true;
+        }
+        m_LightDir = scene.lightDir;
+        m_SceneBounds = scene.bounds;
+        m_HadSkyLight = scene.hasSkyLight;
+
+        m_RefreshDirectional = scene.hasSkyLight && m_DirectionalDirty;
+        if (m_RefreshDirectional)
+        {
+            m_DirectionalDirty = false;
+            m_RefreshedCount++;
+        }
+        else if (scene.hasSkyLight)
+        {
+            m_ReusedCount++;
+        }
+
+        // ---- Point Lights ----
+        const auto &lights = scene.getPointLights();
+        m_RefreshPointLights.assign(lights.size(), false);
+
+        struct Candidate
+        {
+            size_t index;
+            float priority;
+        };
+        std::vector<Candidate> candidates;
+
+        for (size_t i = 0; i < lights.size(); ++i)
+        {
+            const auto &light = lights[i];
+            auto [it, inserted] = m_Lights.try_emplace(light.get());
+            LightState &state = it->second;
+            state.frame = m_Frame;
+
+            if (light->hidden)
+            {
+                state.hidden = true;
+                continue;
+            }
+
+            if (inserted || invalidated || state.hidden || state.position != light->position || state.range != light->range)
+            {
+                state.dirty = true;
+            }
+            else if (!state.dirty)
+            {
+                for (const auto &bounds : m_ChangedBounds)
+                {
+                    if (sphereIntersects(bounds, light->position, light->range))
+                    {
+                        state.dirty = true;
+                        break;
+                    }
+                }
+            }
+            state.hidden = false;
+            state.position = light->position;
+            state.range = light->range;
+
+            if (!state.dirty)
+            {
+                m_ReusedCount++;
+                continue;
+            }
+
+            // Screen importance: lights near or around the camera and inside the view matter most
+            float distance = std::max(glm::length(light->position - cameraPos) - light->range, 0.0f);
+            float importance = light->range / (distance + light->range + 1e-4f);
+            if (!cameraFrustum.intersects(light->position, light->range))
+                importance *= 0.25f;
+
+            // Aging keeps far lights from starving behind near ones
+            float waiting = float(m_Frame - state.lastRefresh);
+            candidates.push_back({i, importance * (1.0f + waiting)});
+        }
+
+        // Forget lights that left the scene
+        for (auto it = m_Lights.begin(); it != m_Lights.end();)
+        {
+            if (it->second.frame != m_Frame)
+                it = m_Lights.erase(it);
+            else
+                ++it;
+        }
+
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                  { return a.priority > b.priority; });
+
+        size_t refreshCount = budget < 0 ? candidates.size() : std::min(candidates.size(), size_t(budget));
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            if (i >= refreshCount)
+            {
+                m_DeferredCount++;
+                continue;
+            }
+            LightState &state = m_Lights[lights[candidates[i].index].get()];
+            state.dirty = false;
+            state.lastRefresh = m_Frame;
+            m_RefreshPointLights[candidates[i].index] = true;
+            m_RefreshedCount++;
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "Scene.h"
+#include "Frustum.h"
+
+namespace Prepath
+{
+    // Decides which shadow maps need re-rendering this frame. Clean maps are reused, dirty point lights
+    // are refreshed under a per-frame budget ordered by screen importance and time spent waiting.
+    class ShadowScheduler
+    {
+    public:
+        // Call once per frame before the shadow passes. budget < 0 refreshes every dirty light.
+        void update(const Scene &scene, const Frustum &cameraFrustum, const glm::vec3 &cameraPos, int budget);
+        // Marks every shadow map dirty, e.g. after the shadow resolution changed
+        void invalidate();
+        // Marks the directional map dirty, e.g. after the cascades moved with the camera
+        void invalidateDirectional() { m_DirectionalDirty = true; }
+        // Marks one point light dirty before update, e.g. after its atlas tiles moved
+        void invalidatePointLight(const PointLight *light);
+        // Adds an instanced batch to the next update, matched to last frame's batches by mesh and submission order.
+        // transforms has to stay alive until then.
+        void trackInstances(const Mesh *mesh, std::span<const glm::mat4> transforms);
+
+        bool shouldRefreshDirectional() const { return m_RefreshDirectional; }
+        bool shouldRefreshPointLight(size_t index) const { return index < m_RefreshPointLights.size() && m_RefreshPointLights[index]; }
+
+        // ---- Statistics Methods ----
+        int getRefreshedCount() const { return m_RefreshedCount; }
+        int getReusedCount() const { return m_ReusedCount; }
+        int getDeferredCount() const { return m_DeferredCount; }
+
+    private:
+        struct MeshState
+        {
+            glm::mat4 model;
+            bool hidden = false;
+            AABB worldBounds;
+            uint64_t frame = 0;
+        };
+
+        struct InstanceState
+        {
+            uint64_t hash = 0; // Over the transforms of the batch
+            AABB worldBounds;  // Union of every instance
+        };
+
+        struct SubmittedInstances
+        {
+            const Mesh *mesh = nullptr;
+            std::span<const glm::mat4> transforms;
+        };
+
+        struct LightState
+        {
+            glm::vec3 position = glm::vec3(0.0f);
+            float range = 0.0f;
+            bool hidden = true;
+            bool dirty = true;
+            uint64_t lastRefresh = 0;
+            uint64_t frame = 0;
+        };
+
+        void collectChangedBounds(const Scene &scene);
+
+        uint64_t m_Frame = 0;
+        bool m_Invalidated = true;
+        bool m_RefreshDirectional = true;
+        bool m_DirectionalDirty = true;
+        bool m_HadSkyLight = false;
+        glm::vec3 m_LightDir = glm::vec3(0.0f);
+        AABB m_SceneBounds;
+
+        std::vector<AABB> m_ChangedBounds; // Old and new world bounds of meshes and instance batches that moved, appeared or disappeared
+        std::vector<bool> m_RefreshPointLights;
+        std::unordered_map<const Mesh *, MeshState> m_Meshes;
+        std::vector<SubmittedInstances> m_SubmittedInstances;
+        std::unordered_map<const Mesh *, std::vector<InstanceState>> m_Instances; // Per mesh in submission order
+        std::unordered_map<const PointLight *, LightState> m_Lights;
+
+        int m_RefreshedCount = 0;
+        int m_ReusedCount = 0;
+        int m_DeferredCount = 0;
+    };
+}
@@ -1,8 +1,152 @@
 #include "Texture.h"
 #include "Error.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PREPATH_TEXTURE_SSE
+#include <emmintrin.h>
+#endif
 
 namespace Prepath
 {
+    namespace
+    {
+        struct alignas(16) Texel
+        {
+            float v[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        };
+
+        // Filter taps for one output coordinate, indices already clamped to the edge
+        struct Contribution
+        {
+            std::vector<int> indices;
+            std::vector<float> weights;
+        };
+
+        float lanczos(float x)
+        {
+            const float lobes = float(PREPATH_TEXTURE_RESIZE_LOBES);
+            x = std::abs(x);
+            if (x < 1e-6f)
+                return 1.0f;
+            if (x >= lobes)
+                return 0.0f;
+            const float pi = 3.14159265358979f;
+            float px = pi * x;
+            return lobes * std::sin(px) * std::sin(px / lobes) / (px * px);
+        }
+
+        std::vector<Contribution> buildContributions(unsigned int srcSize, unsigned int dstSize)
+        {
+            // Widen the kernel by the scale factor when minifying so it low-passes
+            float scale = float(srcSize) / float(dstSize);
+            float filterScale = std::max(scale, 1.0f);
+            float support = PREPATH_TEXTURE_RESIZE_LOBES * filterScale;
+
+            std::vector<Contribution> contributions(dstSize);
+            for (unsigned int i = 0; i < dstSize; ++i)
+            {
+                float center = (i + 0.5f) * scale;
+                int first = int(std::floor(center - support));
+                int last = int(std::ceil(center + support));
+
+                Contribution &c = contributions[i];
+                float total = 0.0f;
+                for (int j = first; j <= last; ++j)
+                {
+                    float weight = lanczos((j + 0.5f - center) / filterScale);
+                    if (weight == 0.0f)
+                        continue;
+                    c.indices.push_back(std::clamp(j, 0, int(srcSize) - 1));
+                    c.weights.push_back(weight);
+                    total += weight;
+                }
+                for (auto &weight : c.weights)
+                    weight /= total;
+            }
+            return contributions;
+        }
+
+        inline void madd(Texel &sum, const Texel &value, float weight)
+        {
+#ifdef PREPATH_TEXTURE_SSE
+            _mm_store_ps(sum.v, _mm_add_ps(_mm_load_ps(sum.v), _mm_mul_ps(_mm_load_ps(value.v), _mm_set1_ps(weight))));
+#else
+            for (int i = 0; i < 4; ++i)
+                sum.v[i] += value.v[i] * weight;
+#endif
+        }
+
+        Texel filter(const Texel *source, size_t stride, const Contribution &c)
+        {
+            Texel sum;
+            for (size_t k = 0; k < c.indices.size(); ++k)
+                madd(sum, source[size_t(c.indices[k]) * stride], c.weights[k]);
+            return sum;
+        }
+
+        // 8-bit sRGB to linear [0, 1], built once
+        const std::array<float, 256> &getSRGBToLinear()
+        {
+            static const std::array<float, 256> table = []
+            {
+                std::array<float, 256> values;
+                for (int i = 0; i < 256; ++i)
+                {
+                    float c = i / 255.0f;
+                    values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return values;
+            }();
+            return table;
+        }
+
+        float linearToSRGB(float c)
+        {
+            c = std::clamp(c, 0.0f, 1.0f);
+            return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        }
+
+        // Texels are filtered as [0, 1] values, colour in linear space and normals in [-1, 1]
+        void decodeTexels(const unsigned char *src, Texel *dst, unsigned int count, int channels, TextureContent content)
+        {
+            const auto &srgbToLinear = getSRGBToLinear();
+            int vectorChannels = content == TextureContent::Data ? 0 : std::min(channels, 3);
+            for (unsigned int x = 0; x < count; ++x)
+                for (int c = 0; c < channels; ++c)
+                {
+                    unsigned char value = src[x * channels + c];
+                    if (c >= vectorChannels)
+                        dst[x].v[c] = value / 255.0f;
+                    else if (content == TextureContent::Color)
+                        dst[x].v[c] = srgbToLinear[value];
+                    else
+                        dst[x].v[c] = value / 127.5f - 1.0f;
+                }
+        }
+
+        void encodeTexel(Texel texel, unsigned char *dst, int channels, TextureContent content)
+        {
+            int vectorChannels = content == TextureContent::Data ? 0 : std::min(channels, 3);
+            if (content == TextureContent::Normal && vectorChannels == 3)
+            {
+                float length = std::sqrt(texel.v[0] * texel.v[0] + texel.v[1] * texel.v[1] + texel.v[2] * texel.v[2]);
+                for (int c = 0; c < 3; ++c)
+                    texel.v[c] = length > 1e-6f ? texel.v[c] / length : (c == 2 ? 1.0f : 0.0f);
+            }
+            for (int c = 0; c < channels; ++c)
+            {
+                float value = texel.v[c];
+                if (c < vectorChannels)
+                    value = content == TextureContent::Color ? linearToSRGB(value) : value * 0.5f + 0.5f;
+                dst[c] = (unsigned char)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+
     Texture::Texture()
     {
         glGenTextures(1, &m_ID);
@@ -41,4 +185,69 @@ namespace Prepath
         return tex;
     }
 
+    std::shared_ptr<Texture> Texture::generateVirtualTexture(const std::string &pageFile)
+    {
+        auto virtualTexture = std::make_shared<VirtualTexture>(pageFile);
+        if (!virtualTexture->isValid())
+            return nullptr;
+
+        auto tex = std::make_shared<Texture>();
+        tex->m_Virtual = virtualTexture;
+        tex->m_Width = virtualTexture->getWidth();
+        tex->m_Height = virtualTexture->getHeight();
+        tex->m_Channels = 4;
+        return tex;
+    }
+
+    void Texture::getQualitySize(unsigned int width, unsigned int height, TextureQuality quality, unsigned int maxDimension,
+                                 unsigned int &outWidth, unsigned int &outHeight)
+    {
+        unsigned int shift = unsigned(quality);
+        outWidth = std::max(1u, width >> shift);
+        outHeight = std::max(1u, height >> shift);
+
+        unsigned int largest = std::max(outWidth, outHeight);
+        if (maxDimension > 0 && largest > maxDimension)
+        {
+            outWidth = std::max(1u, unsigned((uint64_t(outWidth) * maxDimension + largest / 2) / largest));
+            outHeight = std::max(1u, unsigned((uint64_t(outHeight) * maxDimension + largest / 2) / largest));
+        }
+    }
+
+    std::vector<unsigned char> Texture::resize(const unsigned char *data, unsigned int width, unsigned int height, int channels,
+                                               unsigned int newWidth, unsigned int newHeight, TextureContent content)
+    {
+        if (newWidth == width && newHeight == height)
+            return std::vector<unsigned char>(data, data + size_t(width) * height * channels);
+
+        auto columns = buildContributions(width, newWidth);
+        auto rows = buildContributions(height, newHeight);
+
+        // Horizontal pass into a float buffer (height x newWidth), one source row at a time
+        std::vector<Texel> horizontal(size_t(height) * newWidth);
+        ThreadPool::getGlobalPool().parallelFor(height, 16, [&](size_t begin, size_t end)
+                                                {
+            std::vector<Texel> row(width);
+            for (size_t y = begin; y < end; ++y)
+            {
+                decodeTexels(data + y * width * channels, row.data(), width, channels, content);
+
+                Texel *dst = &horizontal[y * newWidth];
+                for (unsigned int x = 0; x < newWidth; ++x)
+                    dst[x] = filter(row.data(), 1, columns[x]);
+            } });
+
+        // Vertical pass straight back to 8-bit
+        std::vector<unsigned char> result(size_t(newWidth) * newHeight * channels);
+        ThreadPool::getGlobalPool().parallelFor(newHeight, 16, [&](size_t begin, size_t end)
+                                                {
+            for (size_t y = begin; y < end; ++y)
+            {
+                unsigned char *dst = &result[y * newWidth * channels];
+                for (unsigned int x = 0; x < newWidth; ++x)
+                    encodeTexel(filter(&horizontal[x], newWidth, rows[y]), dst + x * channels, channels, content);
+            } });
+        return result;
+    }
+
 }
\ No newline at end of file
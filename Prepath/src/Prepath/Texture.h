@@ -3,27 +3,65 @@
 #include <memory>
 #include <mutex>
 #include <format>
+#include <vector>
 #include <glad/glad.h>
 
 #include "Context.h"
+#include "VirtualTexture.h"
+
+#define PREPATH_TEXTURE_RESIZE_LOBES (3) // Lanczos lobes used when downscaling
 
 namespace Prepath
 {
+    // Import-time resolution tiers, each halves both dimensions of the previous one
+    enum class TextureQuality
+    {
+        Full = 0,
+        Half = 1,
+        Quarter = 2
+    };
+
+    // What the 8-bit texels encode, decides the space resize filters them in
+    enum class TextureContent
+    {
+        Data,   // Linear values (roughness, metal, ao), filtered as stored
+        Color,  // sRGB colour, filtered in linear space, alpha stays linear
+        Normal  // Tangent space normal in RGB, renormalized after filtering
+    };
+
     class Texture
     {
     public:
         Texture();
         ~Texture();
         void setData(unsigned char *data, unsigned int width, unsigned int height, int channels);
-        unsigned int getID() { return m_ID; }
+        unsigned int getID() { return m_Virtual ? m_Virtual->getPageTableID() : m_ID; }
+        unsigned int getWidth() const { return m_Width; }
+        unsigned int getHeight() const { return m_Height; }
+
+        // ---- Virtual Texture Methods ----
+        bool isVirtual() const { return m_Virtual != nullptr; }
+        const std::shared_ptr<VirtualTexture> &getVirtual() const { return m_Virtual; }
 
         static std::shared_ptr<Texture> generateTexture(unsigned char *data, unsigned int width, unsigned int height, int channels = 4);
+        static std::shared_ptr<Texture> generateVirtualTexture(const std::string &pageFile);
+
+        // ---- Resize Methods ----
+        // Size after applying a quality tier and an optional max dimension (0 = unlimited), keeps the aspect ratio
+        static void getQualitySize(unsigned int width, unsigned int height, TextureQuality quality, unsigned int maxDimension,
+                                   unsigned int &outWidth, unsigned int &outHeight);
+        // Separable Lanczos resample of 8-bit texels, intended for downscaling. The negative lobes
+        // overshoot next to hard edges, results are clamped to the 8-bit range so that ringing is cut off
+        static std::vector<unsigned char> resize(const unsigned char *data, unsigned int width, unsigned int height, int channels,
+                                                 unsigned int newWidth, unsigned int newHeight,
+                                                 TextureContent content = TextureContent::Data);
 
     private:
+        std::shared_ptr<VirtualTexture> m_Virtual;
         unsigned int m_ID;
-        unsigned int m_Width;
-        unsigned int m_Height;
-        unsigned int m_Channels;
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+        unsigned int m_Channels = 0;
     };
 
 }
\ No newline at end of file
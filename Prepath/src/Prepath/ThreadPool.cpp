@@ -0,0 +1,94 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace Prepath
+{
+    ThreadPool &ThreadPool::getGlobalPool()
+    {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    ThreadPool::ThreadPool()
+    {
+        unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int i = 0; i < workerCount; ++i)
+            m_Workers.emplace_back(&ThreadPool::workerThread, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Running = false;
+        }
+        m_WorkCondition.notify_all();
+        for (auto &worker : m_Workers)
+            worker.join();
+    }
+
+    void ThreadPool::parallelFor(size_t count, size_t chunkSize, const RangeFunction &func)
+    {
+        if (count == 0)
+            return;
+
+        chunkSize = std::max<size_t>(1, chunkSize);
+        if (m_Workers.empty() || count <= chunkSize)
+        {
+            func(0, count);
+            return;
+        }
+
+        std::lock_guard<std::mutex> submitLock(m_SubmitMutex);
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Func = &func;
+            m_Count = count;
+            m_ChunkSize = chunkSize;
+            m_Next = 0;
+            m_Active = unsigned(m_Workers.size());
+            m_Generation++;
+        }
+        m_WorkCondition.notify_all();
+
+        runChunks();
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_DoneCondition.wait(lock, [this]
+                             { return m_Active == 0; });
+        m_Func = nullptr;
+    }
+
+    void ThreadPool::runChunks()
+    {
+        while (true)
+        {
+            size_t begin = m_Next.fetch_add(m_ChunkSize);
+            if (begin >= m_Count)
+                return;
+            (*m_Func)(begin, std::min(begin + m_ChunkSize, m_Count));
+        }
+    }
+
+    void ThreadPool::workerThread()
+    {
+        uint64_t seenGeneration = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_WorkCondition.wait(lock, [&]
+                                     { return !m_Running || m_Generation != seenGeneration; });
+                if (!m_Running)
+                    return;
+                seenGeneration = m_Generation;
+            }
+
+            runChunks();
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (--m_Active == 0)
+                m_DoneCondition.notify_one();
+        }
+    }
+}
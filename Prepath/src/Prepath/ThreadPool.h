@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Prepath
+{
+    class ThreadPool
+    {
+    public:
+        using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+        // ---- Pool Methods ----
+        static ThreadPool &getGlobalPool();
+
+        // Splits [0, count) into chunks and runs them on the workers and the calling thread.
+        // Blocks until all chunks are done. Not reentrant: don't call from inside a job.
+        void parallelFor(size_t count, size_t chunkSize, const RangeFunction &func);
+
+        unsigned int getThreadCount() const { return unsigned(m_Workers.size()) + 1; }
+
+    private:
+        ThreadPool();
+        ~ThreadPool();
+
+        void workerThread();
+        void runChunks();
+
+        std::mutex m_SubmitMutex; // Serializes parallelFor callers
+        std::mutex m_Mutex;
+        std::condition_variable m_WorkCondition;
+        std::condition_variable m_DoneCondition;
+        std::vector<std::thread> m_Workers;
+
+        const RangeFunction *m_Func = nullptr;
+        size_t m_Count = 0;
+        size_t m_ChunkSize = 1;
+        std::atomic<size_t> m_Next = 0;
+        uint64_t m_Generation = 0;
+        unsigned int m_Active = 0;
+        bool m_Running = true;
+    };
+}
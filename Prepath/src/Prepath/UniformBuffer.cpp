@@ -0,0 +1,98 @@
+#include "UniformBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Prepath
+{
+    UniformBuffer::UniformBuffer(GLuint binding, size_t size)
+        : m_Binding(binding), m_Size(size)
+    {
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_Buffer);
+    }
+
+    UniformBuffer::~UniformBuffer()
+    {
+        glDeleteBuffers(1, &m_Buffer);
+    }
+
+    void UniformBuffer::update(const void *data, size_t size)
+    {
+        // Respecifying the store lets the driver hand out new memory instead of waiting on the last frame
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        glBufferData(GL_UNIFORM_BUFFER, m_Size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, std::min(size, m_Size), data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_Buffer);
+    }
+
+    UniformRing::UniformRing(GLuint binding, size_t capacity)
+        : m_Binding(binding), m_Capacity(capacity)
+    {
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        m_Alignment = size_t(std::max(alignment, 1));
+
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        glBufferData(GL_UNIFORM_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        // Draws that read the texture buffer instead never select a range, the block still needs a buffer behind it
+        glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_Buffer);
+    }
+
+    UniformRing::~UniformRing()
+    {
+        glDeleteBuffers(1, &m_Buffer);
+    }
+
+    size_t UniformRing::getStride(size_t elementSize) const
+    {
+        return (elementSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+    }
+
+    size_t UniformRing::upload(const void *data, size_t elementSize, size_t count)
+    {
+        size_t stride = getStride(elementSize);
+        size_t size = stride * count;
+        if (size == 0)
+            return m_Head;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer);
+        if (size > m_Capacity)
+        {
+            m_Capacity = std::max(size, m_Capacity * 2);
+            glBufferData(GL_UNIFORM_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+            m_Head = 0;
+        }
+        else if (m_Head + size > m_Capacity)
+        {
+            // Orphan, draws still reading the old store keep it alive
+            glBufferData(GL_UNIFORM_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+            m_Head = 0;
+        }
+
+        size_t offset = m_Head;
+        auto *dst = static_cast<unsigned char *>(glMapBufferRange(GL_UNIFORM_BUFFER, offset, size,
+                                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+        if (dst)
+        {
+            const auto *src = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < count; ++i)
+                std::memcpy(dst + i * stride, src + i * elementSize, elementSize);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        m_Head += size;
+        return offset;
+    }
+
+    void UniformRing::bind(size_t offset, size_t size) const
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, m_Binding, m_Buffer, offset, size);
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+// Binding points of the blocks in uniforms.glsl, Shader binds blocks with these names on link
+#define PREPATH_UBO_FRAME (0)
+#define PREPATH_UBO_PASS (1)
+#define PREPATH_UBO_OBJECT (2)
+#define PREPATH_UBO_RING_SIZE (4 * 1024 * 1024)
+
+namespace Prepath
+{
+    // ---- std140 Blocks (must match uniforms.glsl) ----
+    struct FrameUniforms
+    {
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::mat4(1.0f);
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        glm::mat4 inverseViewProjection = glm::mat4(1.0f);
+        glm::vec3 cameraPos = glm::vec3(0.0f);
+        float padding0 = 0.0f;
+        glm::vec3 lightDir = glm::vec3(0.0f);
+        float padding1 = 0.0f;
+        glm::vec2 screenSize = glm::vec2(0.0f);
+        glm::vec2 padding2 = glm::vec2(0.0f);
+    };
+    static_assert(sizeof(FrameUniforms) == 304, "FrameUniforms must match the std140 FrameBlock");
+
+    struct PassUniforms
+    {
+        glm::mat4 viewProjection = glm::mat4(1.0f); // Camera, cascade or unused for cubemap passes
+        glm::mat4 shadowMatrices[6];                // Cubemap face view-projections of point shadow passes
+        glm::vec3 eye = glm::vec3(0.0f);            // Camera or light position
+        float range = 0.0f;                         // Point light range
+        int debugTexture = 0;
+        int padding[3] = {0, 0, 0};
+    };
+    static_assert(sizeof(PassUniforms) == 480, "PassUniforms must match the std140 PassBlock");
+
+    struct ObjectUniforms
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        glm::mat4 normalMatrix = glm::mat4(1.0f); // mat3 padded to columns of vec4
+        glm::vec4 tint = glm::vec4(1.0f);
+        int virtualMask = 0;
+        int faceMask = 0x3F;
+        int padding[2] = {0, 0};
+    };
+    static_assert(sizeof(ObjectUniforms) == 160, "ObjectUniforms must match the std140 ObjectBlock");
+
+    // Single block rewritten as a whole and kept bound to its binding point
+    class UniformBuffer
+    {
+    public:
+        UniformBuffer(GLuint binding, size_t size);
+        ~UniformBuffer();
+
+        UniformBuffer(const UniformBuffer &) = delete;
+        UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+        void update(const void *data, size_t size);
+        template <typename T>
+        void update(const T &data) { update(&data, sizeof(T)); }
+
+    private:
+        GLuint m_Buffer = 0;
+        GLuint m_Binding = 0;
+        size_t m_Size = 0;
+    };
+
+    // Streams many blocks into one buffer, each draw then only selects its range with glBindBufferRange.
+    // Writes go to fresh space behind the head without synchronization, the store is orphaned on wrap.
+    class UniformRing
+    {
+    public:
+        UniformRing(GLuint binding, size_t capacity = PREPATH_UBO_RING_SIZE);
+        ~UniformRing();
+
+        UniformRing(const UniformRing &) = delete;
+        UniformRing &operator=(const UniformRing &) = delete;
+
+        // Copies count blocks of elementSize, each padded to getStride, and returns the offset of the first
+        size_t upload(const void *data, size_t elementSize, size_t count);
+        void bind(size_t offset, size_t size) const;
+        // elementSize rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+        size_t getStride(size_t elementSize) const;
+
+    private:
+        GLuint m_Buffer = 0;
+        GLuint m_Binding = 0;
+        size_t m_Capacity = 0;
+        size_t m_Head = 0;
+        size_t m_Alignment = 256;
+    };
+}
@@ -0,0 +1,573 @@
+#include "VirtualTexture.h"
+#include "Error.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#define PREPATH_VT_MAGIC (0x54565050) // "PPVT"
+#define PREPATH_VT_VERSION (1)
+#define PREPATH_VT_HEADER_SIZE (7 * sizeof(uint32_t))
+#define PREPATH_VT_TILE_BYTES (PREPATH_VT_TILE_SIZE * PREPATH_VT_TILE_SIZE * 4)
+
+namespace Prepath
+{
+    static unsigned int nextPowerOfTwo(unsigned int value)
+    {
+        unsigned int result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    static std::vector<unsigned char> resampleBilinear(const unsigned char *src, unsigned int srcWidth, unsigned int srcHeight,
+                                                       unsigned int dstWidth, unsigned int dstHeight)
+    {
+        std::vector<unsigned char> dst(size_t(dstWidth) * dstHeight * 4);
+        for (unsigned int y = 0; y < dstHeight; ++y)
+        {
+            float fy = (y + 0.5f) * srcHeight / dstHeight - 0.5f;
+            int y0 = std::clamp(int(std::floor(fy)), 0, int(srcHeight) - 1);
+            int y1 = std::min(y0 + 1, int(srcHeight) - 1);
+            float ty = std::clamp(fy - y0, 0.0f, 1.0f);
+            for (unsigned int x = 0; x < dstWidth; ++x)
+            {
+                float fx = (x + 0.5f) * srcWidth / dstWidth - 0.5f;
+                int x0 = std::clamp(int(std::floor(fx)), 0, int(srcWidth) - 1);
+                int x1 = std::min(x0 + 1, int(srcWidth) - 1);
+                float tx = std::clamp(fx - x0, 0.0f, 1.0f);
+                for (int c = 0; c < 4; ++c)
+                {
+                    float a = src[(size_t(y0) * srcWidth + x0) * 4 + c] * (1.0f - tx) + src[(size_t(y0) * srcWidth + x1) * 4 + c] * tx;
+                    float b = src[(size_t(y1) * srcWidth + x0) * 4 + c] * (1.0f - tx) + src[(size_t(y1) * srcWidth + x1) * 4 + c] * tx;
+                    dst[(size_t(y) * dstWidth + x) * 4 + c] = (unsigned char)(a * (1.0f - ty) + b * ty + 0.5f);
+                }
+            }
+        }
+        return dst;
+    }
+
+    static std::vector<unsigned char> downsampleBox(const std::vector<unsigned char> &src, unsigned int width, unsigned int height)
+    {
+        unsigned int dstWidth = width / 2;
+        unsigned int dstHeight = height / 2;
+        std::vector<unsigned char> dst(size_t(dstWidth) * dstHeight * 4);
+        for (unsigned int y = 0; y < dstHeight; ++y)
+        {
+            const unsigned char *row0 = &src[size_t(y * 2) * width * 4];
+            const unsigned char *row1 = &src[size_t(y * 2 + 1) * width * 4];
+            for (unsigned int x = 0; x < dstWidth; ++x)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+                    dst[(size_t(y) * dstWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+        return dst;
+    }
+
+    // ---- VirtualTexture ----
+
+    VirtualTexture::VirtualTexture(const std::string &pageFile)
+        : m_PageFile(pageFile)
+    {
+        std::ifstream file(pageFile, std::ios::binary);
+        if (!file)
+        {
+            PREPATH_LOG_ERROR("Failed to open virtual texture page file: {}", pageFile);
+            return;
+        }
+
+        uint32_t header[7];
+        file.read(reinterpret_cast<char *>(header), sizeof(header));
+        if (!file || header[0] != PREPATH_VT_MAGIC || header[1] != PREPATH_VT_VERSION ||
+            header[4] != PREPATH_VT_PAGE_SIZE || header[5] != PREPATH_VT_PAGE_BORDER)
+        {
+            PREPATH_LOG_ERROR("Invalid or outdated virtual texture page file: {}", pageFile);
+            return;
+        }
+
+        m_Width = header[2];
+        m_Height = header[3];
+        m_MipCount = header[6];
+
+        m_ResidentTiles.resize(m_MipCount);
+        for (unsigned int mip = 0; mip < m_MipCount; ++mip)
+            m_ResidentTiles[mip].assign(size_t(getPagesX(mip)) * getPagesY(mip), -1);
+
+        glGenTextures(1, &m_PageTable);
+        glBindTexture(GL_TEXTURE_2D, m_PageTable);
+        for (unsigned int mip = 0; mip < m_MipCount; ++mip)
+        {
+            glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA8, getPagesX(mip), getPagesY(mip), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_MipCount - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        m_Valid = VirtualTextureCache::getGlobalCache().registerTexture(this);
+        if (m_Valid)
+            updatePageTable();
+    }
+
+    VirtualTexture::~VirtualTexture()
+    {
+        if (m_Valid)
+            VirtualTextureCache::getGlobalCache().unregisterTexture(this);
+        if (m_PageTable)
+            glDeleteTextures(1, &m_PageTable);
+    }
+
+    size_t VirtualTexture::getPageOffset(unsigned int mip, unsigned int x, unsigned int y) const
+    {
+        size_t index = 0;
+        for (unsigned int i = 0; i < mip; ++i)
+            index += size_t(getPagesX(i)) * getPagesY(i);
+        index += size_t(y) * getPagesX(mip) + x;
+        return PREPATH_VT_HEADER_SIZE + index * PREPATH_VT_TILE_BYTES;
+    }
+
+    void VirtualTexture::setResident(unsigned int mip, unsigned int x, unsigned int y, int tile)
+    {
+        m_ResidentTiles[mip][size_t(y) * getPagesX(mip) + x] = tile;
+        m_Dirty = true;
+    }
+
+    int VirtualTexture::getResident(unsigned int mip, unsigned int x, unsigned int y) const
+    {
+        return m_ResidentTiles[mip][size_t(y) * getPagesX(mip) + x];
+    }
+
+    void VirtualTexture::updatePageTable()
+    {
+        if (!m_Dirty)
+            return;
+        m_Dirty = false;
+
+        // Non-resident pages point at the closest resident ancestor, so sampling always resolves
+        std::vector<std::vector<uint32_t>> levels(m_MipCount);
+        for (int mip = int(m_MipCount) - 1; mip >= 0; --mip)
+        {
+            unsigned int pagesX = getPagesX(mip);
+            unsigned int pagesY = getPagesY(mip);
+            levels[mip].assign(size_t(pagesX) * pagesY, 0);
+            for (unsigned int y = 0; y < pagesY; ++y)
+            {
+                for (unsigned int x = 0; x < pagesX; ++x)
+                {
+                    uint32_t entry = 0;
+                    int tile = getResident(mip, x, y);
+                    if (tile >= 0)
+                    {
+                        uint32_t tileX = tile % PREPATH_VT_PHYSICAL_TILES;
+                        uint32_t tileY = tile / PREPATH_VT_PHYSICAL_TILES;
+                        entry = tileX | (tileY << 8) | (uint32_t(mip) << 16) | (255u << 24);
+                    }
+                    else if (mip + 1 < int(m_MipCount))
+                    {
+                        unsigned int parentX = std::min(x / 2, getPagesX(mip + 1) - 1);
+                        unsigned int parentY = std::min(y / 2, getPagesY(mip + 1) - 1);
+                        entry = levels[mip + 1][size_t(parentY) * getPagesX(mip + 1) + parentX];
+                    }
+                    levels[mip][size_t(y) * pagesX + x] = entry;
+                }
+            }
+        }
+
+        glBindTexture(GL_TEXTURE_2D, m_PageTable);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (unsigned int mip = 0; mip < m_MipCount; ++mip)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, mip, 0, 0, getPagesX(mip), getPagesY(mip), GL_RGBA, GL_UNSIGNED_BYTE, levels[mip].data());
+        }
+    }
+
+    bool VirtualTexture::writePageFile(const std::string &path, const unsigned char *rgba, unsigned int width, unsigned int height)
+    {
+        // Pad to power of two so every mip splits into whole pages
+        unsigned int paddedWidth = std::max<unsigned int>(PREPATH_VT_PAGE_SIZE, nextPowerOfTwo(width));
+        unsigned int paddedHeight = std::max<unsigned int>(PREPATH_VT_PAGE_SIZE, nextPowerOfTwo(height));
+
+        std::vector<unsigned char> level;
+        if (paddedWidth != width || paddedHeight != height)
+            level = resampleBilinear(rgba, width, height, paddedWidth, paddedHeight);
+        else
+            level.assign(rgba, rgba + size_t(width) * height * 4);
+
+        uint32_t mipCount = 1;
+        while ((std::min(paddedWidth, paddedHeight) >> mipCount) >= PREPATH_VT_PAGE_SIZE)
+            mipCount++;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            PREPATH_LOG_ERROR("Failed to write virtual texture page file: {}", path);
+            return false;
+        }
+
+        uint32_t header[7] = {PREPATH_VT_MAGIC, PREPATH_VT_VERSION, paddedWidth, paddedHeight,
+                              PREPATH_VT_PAGE_SIZE, PREPATH_VT_PAGE_BORDER, mipCount};
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+
+        std::vector<unsigned char> tile(PREPATH_VT_TILE_BYTES);
+        unsigned int levelWidth = paddedWidth;
+        unsigned int levelHeight = paddedHeight;
+        for (uint32_t mip = 0; mip < mipCount; ++mip)
+        {
+            unsigned int pagesX = levelWidth / PREPATH_VT_PAGE_SIZE;
+            unsigned int pagesY = levelHeight / PREPATH_VT_PAGE_SIZE;
+            for (unsigned int pageY = 0; pageY < pagesY; ++pageY)
+            {
+                for (unsigned int pageX = 0; pageX < pagesX; ++pageX)
+                {
+                    // Borders wrap around like GL_REPEAT
+                    for (int y = 0; y < PREPATH_VT_TILE_SIZE; ++y)
+                    {
+                        int srcY = int(pageY * PREPATH_VT_PAGE_SIZE) + y - PREPATH_VT_PAGE_BORDER;
+                        srcY = (srcY % int(levelHeight) + int(levelHeight)) % int(levelHeight);
+                        for (int x = 0; x < PREPATH_VT_TILE_SIZE; ++x)
+                        {
+                            int srcX = int(pageX * PREPATH_VT_PAGE_SIZE) + x - PREPATH_VT_PAGE_BORDER;
+                            srcX = (srcX % int(levelWidth) + int(levelWidth)) % int(levelWidth);
+                            std::memcpy(&tile[(size_t(y) * PREPATH_VT_TILE_SIZE + x) * 4],
+                                        &level[(size_t(srcY) * levelWidth + srcX) * 4], 4);
+                        }
+                    }
+                    file.write(reinterpret_cast<const char *>(tile.data()), tile.size());
+                }
+            }
+
+            if (mip + 1 < mipCount)
+            {
+                level = downsampleBox(level, levelWidth, levelHeight);
+                levelWidth /= 2;
+                levelHeight /= 2;
+            }
+        }
+
+        return bool(file);
+    }
+
+    // ---- VirtualTextureCache ----
+
+    VirtualTextureCache &VirtualTextureCache::getGlobalCache()
+    {
+        static VirtualTextureCache instance;
+        return instance;
+    }
+
+    VirtualTextureCache::VirtualTextureCache()
+    {
+        m_Tiles.resize(PREPATH_VT_PHYSICAL_TILES * PREPATH_VT_PHYSICAL_TILES);
+    }
+
+    VirtualTextureCache::~VirtualTextureCache()
+    {
+        // The GL context is gone by now, the physical texture is only deleted by release()
+        stopWorkers();
+    }
+
+    // Loaders only exist once a texture registered, processes that never stream pay nothing
+    void VirtualTextureCache::startWorkers()
+    {
+        if (!m_Workers.empty() || !m_Running)
+            return;
+        unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+        for (unsigned int i = 0; i < workerCount; ++i)
+            m_Workers.emplace_back(&VirtualTextureCache::loaderThread, this);
+    }
+
+    void VirtualTextureCache::stopWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_Running = false;
+        }
+        m_QueueCondition.notify_all();
+        for (auto &worker : m_Workers)
+            worker.join();
+        m_Workers.clear();
+    }
+
+    void VirtualTextureCache::release()
+    {
+        stopWorkers();
+        if (m_PhysicalTexture)
+            glDeleteTextures(1, &m_PhysicalTexture);
+        m_PhysicalTexture = 0;
+    }
+
+    void VirtualTextureCache::setupPhysicalTexture()
+    {
+        glGenTextures(1, &m_PhysicalTexture);
+        glBindTexture(GL_TEXTURE_2D, m_PhysicalTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                     PREPATH_VT_PHYSICAL_TILES * PREPATH_VT_TILE_SIZE, PREPATH_VT_PHYSICAL_TILES * PREPATH_VT_TILE_SIZE,
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    bool VirtualTextureCache::registerTexture(VirtualTexture *texture)
+    {
+        if (!m_PhysicalTexture)
+            setupPhysicalTexture();
+
+        // The coarsest mip stays resident so every page has a fallback. Its tiles are reserved here and
+        // never handed to streamed pages, a texture whose coarsest mip would cut into the streaming tiles is not registered.
+        unsigned int coarsest = texture->m_MipCount - 1;
+        int pinnedPages = int(texture->getPagesX(coarsest) * texture->getPagesY(coarsest));
+        if (m_PinnedCount + pinnedPages > int(m_Tiles.size()) - PREPATH_VT_STREAMING_TILES)
+        {
+            PREPATH_LOG_ERROR("Virtual texture cache has no room for the coarsest mip of {}, it will not stream", texture->m_PageFile);
+            return false;
+        }
+
+        auto slot = std::find(m_Textures.begin(), m_Textures.end(), nullptr);
+        if (slot == m_Textures.end())
+        {
+            if (m_Textures.size() >= PREPATH_VT_MAX_TEXTURES)
+            {
+                PREPATH_LOG_ERROR("Too many virtual textures (max {}), {} will not stream", PREPATH_VT_MAX_TEXTURES, texture->m_PageFile);
+                return false;
+            }
+            slot = m_Textures.insert(m_Textures.end(), nullptr);
+        }
+        *slot = texture;
+        texture->m_ID = unsigned(slot - m_Textures.begin()) + 1;
+        m_TextureCount++;
+
+        for (unsigned int y = 0; y < texture->getPagesY(coarsest); ++y)
+        {
+            for (unsigned int x = 0; x < texture->getPagesX(coarsest); ++x)
+            {
+                PageKey key{texture->m_ID, coarsest, x, y};
+                int tileIndex = allocateTile(true);
+                Tile &tile = m_Tiles[tileIndex];
+                tile.pinned = true;
+                tile.key = key;
+                m_PinnedPages[key.hash()] = tileIndex;
+                m_PinnedCount++;
+                queuePage(key);
+            }
+        }
+        startWorkers();
+        return true;
+    }
+
+    void VirtualTextureCache::unregisterTexture(VirtualTexture *texture)
+    {
+        if (texture->m_ID == 0)
+            return;
+
+        for (auto &tile : m_Tiles)
+        {
+            if ((tile.used || tile.pinned) && tile.key.texture == texture->m_ID)
+            {
+                if (tile.used)
+                {
+                    m_ResidentPages.erase(tile.key.hash());
+                    m_ResidentCount--;
+                }
+                if (tile.pinned)
+                {
+                    m_PinnedPages.erase(tile.key.hash());
+                    m_PinnedCount--;
+                }
+                tile = Tile();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            std::erase_if(m_Requests, [&](const PageRequest &request)
+                          { return request.key.texture == texture->m_ID; });
+        }
+        std::erase_if(m_PendingPages, [&](uint64_t hash)
+                      { return (hash >> 48) == texture->m_ID; });
+
+        m_Textures[texture->m_ID - 1] = nullptr;
+        texture->m_ID = 0;
+        m_TextureCount--;
+    }
+
+    void VirtualTextureCache::queuePage(const PageKey &key)
+    {
+        uint64_t hash = key.hash();
+        if (m_ResidentPages.count(hash) || !m_PendingPages.insert(hash).second)
+            return;
+
+        VirtualTexture *texture = m_Textures[key.texture - 1];
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_Requests.push_back({key, texture->m_PageFile, texture->getPageOffset(key.mip, key.x, key.y)});
+        }
+        m_QueueCondition.notify_one();
+    }
+
+    // Reservations may also evict pages touched this frame, registerTexture keeps PREPATH_VT_STREAMING_TILES unpinned
+    int VirtualTextureCache::allocateTile(bool reserve)
+    {
+        int best = -1;
+        for (int i = 0; i < int(m_Tiles.size()); ++i)
+        {
+            const Tile &tile = m_Tiles[i];
+            if (tile.pinned)
+                continue;
+            if (!tile.used)
+                return i;
+            if (!reserve && tile.lastUsed >= m_Frame)
+                continue;
+            if (best < 0 || tile.lastUsed < m_Tiles[best].lastUsed)
+                best = i;
+        }
+
+        if (best >= 0)
+        {
+            // Evict the least recently used page
+            Tile &tile = m_Tiles[best];
+            m_ResidentPages.erase(tile.key.hash());
+            if (VirtualTexture *owner = m_Textures[tile.key.texture - 1])
+                owner->setResident(tile.key.mip, tile.key.x, tile.key.y, -1);
+            tile = Tile();
+            m_ResidentCount--;
+        }
+        return best;
+    }
+
+    void VirtualTextureCache::update()
+    {
+        m_Frame++;
+        m_UploadedLastFrame = 0;
+
+        std::vector<LoadedPage> loaded;
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            size_t count = std::min<size_t>(m_Loaded.size(), PREPATH_VT_UPLOADS_PER_FRAME);
+            loaded.assign(std::make_move_iterator(m_Loaded.begin()), std::make_move_iterator(m_Loaded.begin() + count));
+            m_Loaded.erase(m_Loaded.begin(), m_Loaded.begin() + count);
+        }
+
+        if (!loaded.empty())
+        {
+            glBindTexture(GL_TEXTURE_2D, m_PhysicalTexture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+
+        for (auto &page : loaded)
+        {
+            uint64_t hash = page.key.hash();
+            if (!m_PendingPages.erase(hash) || page.data.empty())
+                continue; // Owner was unregistered or the read failed
+
+            VirtualTexture *texture = m_Textures[page.key.texture - 1];
+            auto pinned = m_PinnedPages.find(hash);
+            int tileIndex = pinned != m_PinnedPages.end() ? pinned->second : allocateTile(false);
+            if (tileIndex < 0)
+                continue; // Every tile was touched this frame, the page is requested again by later feedback
+
+            Tile &tile = m_Tiles[tileIndex];
+            tile.used = true;
+            tile.key = page.key;
+            tile.lastUsed = m_Frame;
+
+            glTexSubImage2D(GL_TEXTURE_2D, 0,
+                            (tileIndex % PREPATH_VT_PHYSICAL_TILES) * PREPATH_VT_TILE_SIZE,
+                            (tileIndex / PREPATH_VT_PHYSICAL_TILES) * PREPATH_VT_TILE_SIZE,
+                            PREPATH_VT_TILE_SIZE, PREPATH_VT_TILE_SIZE,
+                            GL_RGBA, GL_UNSIGNED_BYTE, page.data.data());
+
+            m_ResidentPages[hash] = tileIndex;
+            texture->setResident(page.key.mip, page.key.x, page.key.y, tileIndex);
+            m_ResidentCount++;
+            m_UploadedLastFrame++;
+        }
+
+        for (auto texture : m_Textures)
+        {
+            if (texture)
+                texture->updatePageTable();
+        }
+    }
+
+    void VirtualTextureCache::requestPages(const std::vector<unsigned char> &feedback)
+    {
+        std::unordered_set<uint32_t> unique;
+        for (size_t i = 0; i + 3 < feedback.size(); i += 4)
+        {
+            if (feedback[i + 3] == 0)
+                continue;
+            uint32_t packed;
+            std::memcpy(&packed, &feedback[i], 4);
+            unique.insert(packed);
+        }
+
+        for (uint32_t packed : unique)
+        {
+            unsigned int x = packed & 0xFF;
+            unsigned int y = (packed >> 8) & 0xFF;
+            unsigned int mip = (packed >> 16) & 0xFF;
+            unsigned int id = (packed >> 24) & 0xFF;
+            if (id == 0 || id > m_Textures.size() || !m_Textures[id - 1])
+                continue;
+
+            VirtualTexture *texture = m_Textures[id - 1];
+            mip = std::min(mip, texture->m_MipCount - 1);
+            x = std::min(x, texture->getPagesX(mip) - 1);
+            y = std::min(y, texture->getPagesY(mip) - 1);
+
+            // Touch the page and its ancestors so fallbacks are not evicted while refining
+            for (unsigned int level = mip; level < texture->m_MipCount; ++level)
+            {
+                PageKey key{id, level, x >> (level - mip), y >> (level - mip)};
+                auto it = m_ResidentPages.find(key.hash());
+                if (it != m_ResidentPages.end())
+                    m_Tiles[it->second].lastUsed = m_Frame;
+                else
+                    queuePage(key);
+            }
+        }
+    }
+
+    void VirtualTextureCache::loaderThread()
+    {
+        std::unordered_map<std::string, std::ifstream> files;
+        while (true)
+        {
+            PageRequest request;
+            {
+                std::unique_lock<std::mutex> lock(m_QueueMutex);
+                m_QueueCondition.wait(lock, [this]
+                                      { return !m_Running || !m_Requests.empty(); });
+                if (!m_Running)
+                    return;
+                request = std::move(m_Requests.front());
+                m_Requests.pop_front();
+            }
+
+            auto &file = files[request.file];
+            if (!file.is_open())
+                file.open(request.file, std::ios::binary);
+
+            LoadedPage page{request.key, std::vector<unsigned char>(PREPATH_VT_TILE_BYTES)};
+            file.clear();
+            file.seekg(request.offset);
+            file.read(reinterpret_cast<char *>(page.data.data()), page.data.size());
+            if (!file)
+            {
+                PREPATH_LOG_ERROR("Failed to read virtual texture page from {}", request.file);
+                page.data.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_Loaded.push_back(std::move(page));
+        }
+    }
+}
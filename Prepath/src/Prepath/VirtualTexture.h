@@ -0,0 +1,158 @@
+#pragma once
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <format>
+#include <glad/glad.h>
+
+#include "Context.h"
+
+// Must match the constants in default.frag / feedback.frag
+#define PREPATH_VT_PAGE_SIZE (128)
+#define PREPATH_VT_PAGE_BORDER (4)
+#define PREPATH_VT_TILE_SIZE (PREPATH_VT_PAGE_SIZE + 2 * PREPATH_VT_PAGE_BORDER)
+#define PREPATH_VT_PHYSICAL_TILES (32)     // Tiles per side of the physical cache
+#define PREPATH_VT_STREAMING_TILES (64)    // Physical tiles never pinned, finer pages always have room to stream
+#define PREPATH_VT_FEEDBACK_SCALE (8)      // Feedback buffer is 1/N of the screen
+#define PREPATH_VT_FEEDBACK_READBACKS (3)  // Pixel pack buffers in flight, feedback arrives up to N - 1 frames late
+#define PREPATH_VT_UPLOADS_PER_FRAME (64)  // Page uploads per update()
+#define PREPATH_VT_MAX_TEXTURES (255)      // Feedback stores the id in 8 bits
+
+namespace Prepath
+{
+    class VirtualTexture
+    {
+    public:
+        VirtualTexture(const std::string &pageFile);
+        ~VirtualTexture();
+
+        VirtualTexture(const VirtualTexture &) = delete;
+        VirtualTexture &operator=(const VirtualTexture &) = delete;
+
+        bool isValid() const { return m_Valid; }
+        unsigned int getID() const { return m_ID; }
+        unsigned int getPageTableID() const { return m_PageTable; }
+        unsigned int getWidth() const { return m_Width; }
+        unsigned int getHeight() const { return m_Height; }
+        unsigned int getMipCount() const { return m_MipCount; }
+        unsigned int getPagesX(unsigned int mip = 0) const { return std::max(1u, (m_Width / PREPATH_VT_PAGE_SIZE) >> mip); }
+        unsigned int getPagesY(unsigned int mip = 0) const { return std::max(1u, (m_Height / PREPATH_VT_PAGE_SIZE) >> mip); }
+        const std::string &getPageFile() const { return m_PageFile; }
+        size_t getPageOffset(unsigned int mip, unsigned int x, unsigned int y) const;
+
+        // ---- Page File Methods ----
+        // Writes a tiled page file (padded to power of two, full mip chain down to one page row/column)
+        static bool writePageFile(const std::string &path, const unsigned char *rgba, unsigned int width, unsigned int height);
+
+    private:
+        void setResident(unsigned int mip, unsigned int x, unsigned int y, int tile);
+        int getResident(unsigned int mip, unsigned int x, unsigned int y) const;
+        void updatePageTable();
+
+        bool m_Valid = false;
+        bool m_Dirty = true;
+        unsigned int m_ID = 0;
+        unsigned int m_PageTable = 0;
+        unsigned int m_Width = 0;
+        unsigned int m_Height = 0;
+        unsigned int m_MipCount = 0;
+        std::string m_PageFile;
+        std::vector<std::vector<int>> m_ResidentTiles; // Per mip, -1 = not resident
+
+        friend class VirtualTextureCache;
+    };
+
+    class VirtualTextureCache
+    {
+    public:
+        // ---- Cache Methods ----
+        static VirtualTextureCache &getGlobalCache();
+
+        // Fails when the texture ids or the tiles for its pinned coarsest mip are used up
+        bool registerTexture(VirtualTexture *texture);
+        void unregisterTexture(VirtualTexture *texture);
+        bool hasTextures() const { return m_TextureCount > 0; }
+        unsigned int getPhysicalTextureID() const { return m_PhysicalTexture; }
+        // Stops the loaders and deletes the physical texture, called by Context::shutdown
+        void release();
+
+        // Uploads loaded pages and refreshes page tables, call once per frame before rendering
+        void update();
+        // Decodes a feedback buffer (RGBA8: page x, page y, mip, texture id) and queues missing pages
+        void requestPages(const std::vector<unsigned char> &feedback);
+
+        // ---- Statistics Methods ----
+        int getResidentPageCount() const { return m_ResidentCount; }
+        int getPendingPageCount() const { return int(m_PendingPages.size()); }
+        int getUploadedPageCount() const { return m_UploadedLastFrame; }
+
+    private:
+        struct PageKey
+        {
+            unsigned int texture;
+            unsigned int mip;
+            unsigned int x;
+            unsigned int y;
+            uint64_t hash() const { return (uint64_t(texture) << 48) | (uint64_t(mip) << 40) | (uint64_t(y) << 20) | uint64_t(x); }
+        };
+
+        struct PageRequest
+        {
+            PageKey key;
+            std::string file;
+            size_t offset;
+        };
+
+        struct LoadedPage
+        {
+            PageKey key;
+            std::vector<unsigned char> data;
+        };
+
+        struct Tile
+        {
+            bool used = false;
+            bool pinned = false; // Reserved for a coarsest mip page from registration on, even before it is loaded
+            PageKey key{};
+            uint64_t lastUsed = 0;
+        };
+
+        VirtualTextureCache();
+        ~VirtualTextureCache();
+
+        void setupPhysicalTexture();
+        void queuePage(const PageKey &key);
+        int allocateTile(bool reserve);
+        void startWorkers();
+        void stopWorkers();
+        void loaderThread();
+
+        GLuint m_PhysicalTexture = 0;
+        uint64_t m_Frame = 0;
+        int m_TextureCount = 0;
+        int m_ResidentCount = 0;
+        int m_UploadedLastFrame = 0;
+
+        std::vector<VirtualTexture *> m_Textures; // Index = id - 1
+        std::vector<Tile> m_Tiles;
+        std::unordered_map<uint64_t, int> m_ResidentPages;
+        std::unordered_set<uint64_t> m_PendingPages;
+        std::unordered_map<uint64_t, int> m_PinnedPages; // Page hash to its reserved tile
+        int m_PinnedCount = 0;
+
+        std::mutex m_QueueMutex;
+        std::condition_variable m_QueueCondition;
+        std::deque<PageRequest> m_Requests;
+        std::vector<LoadedPage> m_Loaded;
+        std::vector<std::thread> m_Workers;
+        bool m_Running = true;
+    };
+
+}
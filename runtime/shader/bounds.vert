@@ -3,12 +3,8 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+#include "object.glsl"
 
 void main() {
-    mat4 uMVP = uProjection * uView * uModel;
-
-    gl_Position = uMVP * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    gl_Position = uViewProjection * loadObject().model * vec4(aPos, 1.0);
+}
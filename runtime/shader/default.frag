@@ -1,148 +1,100 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec3 uTint;
-uniform vec3 uLightDir;
-uniform vec3 uCameraPos;
-
-uniform sampler2D uDepthMap;
-uniform sampler2D uAlbedoMap;
-uniform sampler2D uNormalMap;
-uniform sampler2D uRoughnessMap;
-uniform sampler2D uMetallicMap;
-uniform sampler2D uAOMap;
-
-uniform bool uSkyLight;
-
-uniform int uDebugTexture; // 0 = normal render, >0 = debug view
+#include "uniforms.glsl"
+#include "shadow.glsl"
+#include "material.glsl"
+#include "ibl.glsl"
+#include "pointshadow.glsl"
+
+// Clustered point lights (must match PREPATH_CLUSTER_* in LightClusters.h)
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+uniform bool uClusteredLighting;
+uniform samplerBuffer uLightData;     // 2 texels per light: position + range, color * intensity + scene index
+uniform usamplerBuffer uClusterGrid;  // Per cluster: offset into uLightIndices, light count
+uniform usamplerBuffer uLightIndices;
+uniform float uClusterNear;
+uniform float uClusterFar;
 
 in vec3 WorldPos;
 in vec2 TexCoord;
-in vec4 WorldPosLightSpace;
 in mat3 TBN;
 flat in int vTriangleID;
+flat in vec4 vTint;
 
 // ----------------------------------------------------------------------------
-// Shadow Calculation with PCF
-float ShadowCalculationPCF(vec4 fragPosLightSpace) {
-  if(uSkyLight) {
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    if(projCoords.z > 1.0)
-      return 0.0;
-
-    float currentDepth = projCoords.z;
-    float bias = 0.005; // Simple fixed bias
-
-    float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(uDepthMap, 0);
-    for(int x = -1; x <= 1; ++x) {
-      for(int y = -1; y <= 1; ++y) {
-        float pcfDepth = texture(uDepthMap, projCoords.xy + vec2(x, y) * texelSize).r;
-        shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
-      }
-    }
-    return shadow / 9.0;
-  } else {
-    return 1.0; // SHADOW EVERYWHERE
-  }
-}
-
-// ----------------------------------------------------------------------------
-// PBR helper functions
-float DistributionGGX(vec3 N, vec3 H, float roughness) {
-  float a = roughness * roughness;
-  float a2 = a * a;
-  float NdotH = max(dot(N, H), 0.0);
-  float NdotH2 = NdotH * NdotH;
-
-  float num = a2;
-  float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-  denom = 3.14159 * denom * denom;
-
-  return num / denom;
-}
-
-float GeometrySchlickGGX(float NdotV, float roughness) {
-  float r = (roughness + 1.0);
-  float k = (r * r) / 8.0;
-
-  float num = NdotV;
-  float denom = NdotV * (1.0 - k) + k;
-
-  return num / denom;
+// Clustered Point Lights
+int clusterIndex(vec3 worldPos) {
+  float depth = -(uView * vec4(worldPos, 1.0)).z;
+  int slice = int(floor(log(max(depth, uClusterNear) / uClusterNear) * float(CLUSTER_Z) / log(uClusterFar / uClusterNear)));
+  ivec2 tile = ivec2(gl_FragCoord.xy / uScreenSize * vec2(CLUSTER_X, CLUSTER_Y));
+  tile = clamp(tile, ivec2(0), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+  return (clamp(slice, 0, CLUSTER_Z - 1) * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
 }
 
-float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
-  float NdotV = max(dot(N, V), 0.0);
-  float NdotL = max(dot(N, L), 0.0);
-  float ggx2 = GeometrySchlickGGX(NdotV, roughness);
-  float ggx1 = GeometrySchlickGGX(NdotL, roughness);
-  return ggx1 * ggx2;
-}
-
-vec3 FresnelSchlick(float cosTheta, vec3 F0) {
-  return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
-}
-
-// ----------------------------------------------------------------------------
-// Normal Mapping
-vec3 getNormalFromMap() {
-  vec3 tangentNormal = texture(uNormalMap, TexCoord).rgb;
-  tangentNormal = tangentNormal * 2.0 - 1.0; // [0,1] → [-1,1]
-  return normalize(TBN * tangentNormal);
+vec3 clusteredPointLights(vec3 worldPos, vec3 N, vec3 V, vec3 albedo, vec3 F0, float roughness, float metallic) {
+  uvec2 cluster = texelFetch(uClusterGrid, clusterIndex(worldPos)).rg;
+  vec3 Lo = vec3(0.0);
+  for(uint i = 0u; i < cluster.y; ++i) {
+    int light = int(texelFetch(uLightIndices, int(cluster.x + i)).r);
+    vec4 positionRange = texelFetch(uLightData, light * 2);
+    vec4 radianceIndex = texelFetch(uLightData, light * 2 + 1);
+
+    vec3 toLight = positionRange.xyz - worldPos;
+    float distance = length(toLight);
+    if(distance >= positionRange.w)
+      continue;
+
+    vec3 L = toLight / max(distance, 1e-4);
+    float shadow = PointShadow(int(radianceIndex.w), worldPos, positionRange.xyz, positionRange.w);
+    Lo += CookTorrance(N, V, L, albedo, F0, roughness, metallic) * radianceIndex.rgb * PointLightAttenuation(distance, positionRange.w) * (1.0 - shadow);
+  }
+  return Lo;
 }
 
 // ----------------------------------------------------------------------------
 void main() {
-    // Debug modes
-  if(uDebugTexture == 1) {
-    FragColor = vec4(TexCoord, 0.0, 1.0);
-    return;
-  }
-  if(uDebugTexture == 2) {
-    FragColor = vec4(texture(uAlbedoMap, TexCoord).rgb, 1.0);
-    return;
-  }
-  if(uDebugTexture == 3) {
-    vec3 normal = getNormalFromMap();
-    FragColor = vec4(normal * 0.5 + 0.5, 1.0);
-    return;
-  }
-  if(uDebugTexture == 4) {
-    FragColor = vec4(vec3(texture(uRoughnessMap, TexCoord).g), 1.0);
-    return;
-  }
-  if(uDebugTexture == 5) {
-    FragColor = vec4(vec3(texture(uMetallicMap, TexCoord).b), 1.0);
-    return;
-  }
-  if(uDebugTexture == 6) {
-    FragColor = vec4(vec3(texture(uAOMap, TexCoord).r), 1.0);
-    return;
-  }
-  if(uDebugTexture == 7) {
-    float shadow = ShadowCalculationPCF(WorldPosLightSpace);
-    FragColor = vec4(vec3(1 - shadow), 1.0);
-    return;
-  }
-  if(uDebugTexture == 8) {
-    int id = vTriangleID;
-    float r = float((id * 37) % 255) / 255.0;
-    float g = float((id * 59) % 255) / 255.0;
-    float b = float((id * 83) % 255) / 255.0;
-    FragColor = vec4(r, g, b, 1.0);
-    return;
-  }
-
+    // Debug modes, DEBUG_VIEW is compiled into the variant (PREPATH_SHADER_DEBUG_* in Shader.h)
+#if DEBUG_VIEW == 1
+  FragColor = vec4(TexCoord, 0.0, 1.0);
+#elif DEBUG_VIEW == 2
+  FragColor = vec4(sampleMaterial(uAlbedoMap, SLOT_ALBEDO, TexCoord).rgb, 1.0);
+#elif DEBUG_VIEW == 3
+  vec3 normal = sampleNormal(TBN, TexCoord);
+  FragColor = vec4(normal * 0.5 + 0.5, 1.0);
+#elif DEBUG_VIEW == 4
+  FragColor = vec4(vec3(sampleORM(TexCoord).x), 1.0);
+#elif DEBUG_VIEW == 5
+  FragColor = vec4(vec3(sampleORM(TexCoord).y), 1.0);
+#elif DEBUG_VIEW == 6
+  FragColor = vec4(vec3(sampleORM(TexCoord).z), 1.0);
+#elif DEBUG_VIEW == 7
+  float shadow = ShadowCalculationPCF(WorldPos);
+  FragColor = vec4(vec3(1 - shadow), 1.0);
+#elif DEBUG_VIEW == 8
+  int id = vTriangleID;
+  float r = float((id * 37) % 255) / 255.0;
+  float g = float((id * 59) % 255) / 255.0;
+  float b = float((id * 83) % 255) / 255.0;
+  FragColor = vec4(r, g, b, 1.0);
+#elif DEBUG_VIEW == 9
+  const vec3 cascadeColors[5] = vec3[](vec3(1.0, 0.2, 0.2), vec3(0.2, 1.0, 0.2), vec3(0.2, 0.2, 1.0), vec3(1.0, 1.0, 0.2), vec3(0.3));
+  FragColor = vec4(cascadeColors[selectCascade(WorldPos)], 1.0);
+#elif DEBUG_VIEW == 10
+  float count = uClusteredLighting ? float(texelFetch(uClusterGrid, clusterIndex(WorldPos)).g) : 0.0;
+  FragColor = vec4(mix(vec3(0.0, 0.0, 0.3), vec3(1.0, 0.2, 0.0), clamp(count / 16.0, 0.0, 1.0)), 1.0);
+#else
     // ----------------------------------------------------------------------------
     // PBR Lighting
-  vec3 albedo = texture(uAlbedoMap, TexCoord).rgb * uTint;
-  float roughness = texture(uRoughnessMap, TexCoord).g;
-  float metallic = texture(uMetallicMap, TexCoord).b;
-  float ao = texture(uAOMap, TexCoord).r;
+  vec3 albedo = sampleMaterial(uAlbedoMap, SLOT_ALBEDO, TexCoord).rgb * vTint.rgb;
+  vec3 orm = sampleORM(TexCoord);
+  float roughness = orm.x;
+  float metallic = orm.y;
+  float ao = orm.z;
 
-  vec3 N = getNormalFromMap();
+  vec3 N = sampleNormal(TBN, TexCoord);
   vec3 V = normalize(uCameraPos - WorldPos);
   vec3 L = normalize(uLightDir);
   vec3 H = normalize(V + L);
@@ -162,12 +114,19 @@ void main() {
   vec3 diffuse = kD * albedo / 3.14159;
 
   float NdotL = max(dot(N, L), 0.0);
-  float shadow = ShadowCalculationPCF(WorldPosLightSpace);
+  float shadow = ShadowCalculationPCF(WorldPos);
 
   vec3 Lo = (diffuse + specular) * NdotL * (1.0 - shadow);
+  if(uClusteredLighting)
+    Lo += clusteredPointLights(WorldPos, N, V, albedo, F0, roughness, metallic);
+#ifdef IBL
+  vec3 ambient = ambientIBL(N, V, albedo, F0, roughness, metallic, ao);
+#else
   vec3 ambient = 0.03 * albedo * ao;
+#endif
 
   vec3 color = ambient + Lo;
   color = pow(color, vec3(1.0 / 2.2));
   FragColor = vec4(color, 1.0);
+#endif
 }
@@ -6,31 +6,34 @@ layout(location = 3) in vec3 aTangent;
 layout(location = 4) in vec3 aBitangent;
 layout(location = 5) in int aTriangleID;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
-uniform mat4 uLightSpace;
-uniform mat3 uNormalMatrix;
+#include "object.glsl"
 
 out vec3 WorldPos;
 out vec2 TexCoord;
-out vec4 WorldPosLightSpace;
 out mat3 TBN;
 flat out int vTriangleID;
+flat out vec4 vTint;
+flat out int vVirtualMask;
+
+// Matches prepass.vert bit for bit so the depth pre-pass can be followed by a GL_EQUAL test
+invariant gl_Position;
 
 void main() {
-    mat4 uMVP = uProjection * uView * uModel;
-    gl_Position = uMVP * vec4(aPos, 1.0);
+    Object object = loadObject();
+    vec4 worldPos = object.model * vec4(aPos, 1.0);
+    gl_Position = uPassViewProjection * worldPos;
 
-    WorldPos = vec3(uModel * vec4(aPos, 1.0));
+    WorldPos = worldPos.xyz;
     TexCoord = aTexCoord;
-    WorldPosLightSpace = uLightSpace * vec4(WorldPos, 1.0);
 
     // Construct TBN matrix
-    vec3 T = normalize(uNormalMatrix * aTangent);
-    vec3 B = normalize(uNormalMatrix * aBitangent);
-    vec3 N = normalize(uNormalMatrix * aNormal);
+    mat3 normalMatrix = mat3(object.normalMatrix);
+    vec3 T = normalize(normalMatrix * aTangent);
+    vec3 B = normalize(normalMatrix * aBitangent);
+    vec3 N = normalize(normalMatrix * aNormal);
     TBN = mat3(T, B, N);
 
     vTriangleID = aTriangleID;
+    vTint = object.tint;
+    vVirtualMask = object.virtualMask;
 }
@@ -0,0 +1,10 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+out vec2 TexCoord;
+
+// Fullscreen pass drawn with the unit gizmo quad
+void main() {
+    TexCoord = aPos.xy + 0.5;
+    gl_Position = vec4(aPos.xy * 2.0, 0.0, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D uLighting;
+uniform sampler2D uGDepth;
+
+in vec2 TexCoord;
+
+// Gamma corrects the lighting buffer and restores scene depth for the skybox and overlays
+void main() {
+  FragColor = vec4(pow(texture(uLighting, TexCoord).rgb, vec3(1.0 / 2.2)), 1.0);
+  gl_FragDepth = texture(uGDepth, TexCoord).r;
+}
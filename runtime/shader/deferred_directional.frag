@@ -0,0 +1,37 @@
+#version 330 core
+out vec4 FragColor;
+
+#include "shadow.glsl"
+#include "ibl.glsl"
+#include "gbuffer.glsl"
+
+in vec2 TexCoord;
+
+// Directional light and ambient, written once per covered pixel into the lighting buffer
+void main() {
+  float depth = texture(uGDepth, TexCoord).r;
+  if(depth >= 1.0)
+    discard;
+
+  vec3 worldPos = reconstructWorldPos(TexCoord, depth);
+  vec3 albedo = texture(uGAlbedo, TexCoord).rgb;
+  vec3 N = decodeNormal(texture(uGNormal, TexCoord).rg);
+  vec3 orm = texture(uGORM, TexCoord).rgb;
+  float ao = orm.r;
+  float roughness = orm.g;
+  float metallic = orm.b;
+
+  vec3 V = normalize(uCameraPos - worldPos);
+  vec3 L = normalize(uLightDir);
+  vec3 F0 = mix(vec3(0.04), albedo, metallic);
+
+  float shadow = ShadowCalculationPCF(worldPos);
+  vec3 Lo = CookTorrance(N, V, L, albedo, F0, roughness, metallic) * (1.0 - shadow);
+#ifdef IBL
+  vec3 ambient = ambientIBL(N, V, albedo, F0, roughness, metallic, ao);
+#else
+  vec3 ambient = 0.03 * albedo * ao;
+#endif
+
+  FragColor = vec4(ambient + Lo, 1.0);
+}
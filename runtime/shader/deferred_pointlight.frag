@@ -0,0 +1,39 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform vec3 uLightPosition;
+uniform vec3 uLightRadiance; // color * intensity
+uniform float uLightRange;
+uniform int uLightIndex; // Scene index, selects the shadow tiles
+
+#include "pbr.glsl"
+#include "gbuffer.glsl"
+#include "pointshadow.glsl"
+
+// One light volume, additively blended into the lighting buffer
+void main() {
+  vec2 uv = gl_FragCoord.xy / uScreenSize;
+  float depth = texture(uGDepth, uv).r;
+  if(depth >= 1.0)
+    discard;
+
+  vec3 worldPos = reconstructWorldPos(uv, depth);
+  vec3 toLight = uLightPosition - worldPos;
+  float distance = length(toLight);
+  if(distance >= uLightRange)
+    discard;
+
+  vec3 albedo = texture(uGAlbedo, uv).rgb;
+  vec3 N = decodeNormal(texture(uGNormal, uv).rg);
+  vec3 orm = texture(uGORM, uv).rgb;
+  float roughness = orm.g;
+  float metallic = orm.b;
+
+  vec3 V = normalize(uCameraPos - worldPos);
+  vec3 L = toLight / max(distance, 1e-4);
+  vec3 F0 = mix(vec3(0.04), albedo, metallic);
+
+  float shadow = PointShadow(uLightIndex, worldPos, uLightPosition, uLightRange);
+  vec3 Lo = CookTorrance(N, V, L, albedo, F0, roughness, metallic) * uLightRadiance * PointLightAttenuation(distance, uLightRange) * (1.0 - shadow);
+  FragColor = vec4(Lo, 1.0);
+}
@@ -0,0 +1,10 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+#include "uniforms.glsl"
+
+uniform vec4 uLightVolume; // xyz center, w radius
+
+void main() {
+    gl_Position = uViewProjection * vec4(aPos * uLightVolume.w + uLightVolume.xyz, 1.0);
+}
@@ -3,14 +3,8 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
-uniform mat4 uLightSpace;
-uniform mat3 uNormalMatrix;
+#include "object.glsl"
 
 void main() {
-    mat4 uMVP = uLightSpace * uModel;
-
-    gl_Position = uMVP * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    gl_Position = uPassViewProjection * loadObject().model * vec4(aPos, 1.0);
+}
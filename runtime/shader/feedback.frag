@@ -0,0 +1,45 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform int uVirtualIDs[5];    // 0 = slot is not virtual
+uniform vec2 uVirtualPages[5]; // Page count at mip 0
+uniform int uVirtualMips[5];
+uniform float uLodBias;        // -log2(feedback scale)
+uniform int uFrame;
+
+// Must match PREPATH_VT_PAGE_SIZE in VirtualTexture.h
+const float VT_PAGE_SIZE = 128.0;
+
+void main() {
+  vec2 dx = dFdx(TexCoord);
+  vec2 dy = dFdy(TexCoord);
+
+  // Rotate through the material slots per pixel and frame so every virtual slot gets reported
+  int start = (int(gl_FragCoord.x) + int(gl_FragCoord.y) * 3 + uFrame) % 5;
+  int slot = -1;
+  for(int i = 0; i < 5; ++i) {
+    int candidate = (start + i) % 5;
+    if(uVirtualIDs[candidate] != 0) {
+      slot = candidate;
+      break;
+    }
+  }
+
+  // Still write depth so hidden surfaces don't request pages
+  if(slot < 0) {
+    FragColor = vec4(0.0);
+    return;
+  }
+
+  vec2 scale = uVirtualPages[slot] * VT_PAGE_SIZE;
+  vec2 sx = dx * scale;
+  vec2 sy = dy * scale;
+  float lod = 0.5 * log2(max(dot(sx, sx), dot(sy, sy))) + uLodBias;
+  lod = clamp(floor(lod), 0.0, float(uVirtualMips[slot] - 1));
+
+  vec2 pages = max(floor(uVirtualPages[slot] / exp2(lod)), vec2(1.0));
+  vec2 page = min(floor(fract(TexCoord) * pages), pages - 1.0);
+  FragColor = vec4(page.x, page.y, lod, float(uVirtualIDs[slot])) / 255.0;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec2 gNormal;
+layout(location = 2) out vec4 gORM;
+
+#include "material.glsl"
+#include "gbuffer.glsl"
+
+in vec3 WorldPos;
+in vec2 TexCoord;
+in mat3 TBN;
+flat in int vTriangleID;
+flat in vec4 vTint;
+
+void main() {
+  gAlbedo = vec4(sampleMaterial(uAlbedoMap, SLOT_ALBEDO, TexCoord).rgb * vTint.rgb, 1.0);
+  gNormal = encodeNormal(sampleNormal(TBN, TexCoord));
+  vec3 orm = sampleORM(TexCoord);
+  gORM = vec4(orm.z, orm.x, orm.y, 1.0);
+}
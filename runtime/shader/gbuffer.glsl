@@ -0,0 +1,29 @@
+// G-buffer layout shared by the deferred passes (must match Renderer::setupGBuffer)
+#include "uniforms.glsl"
+
+uniform sampler2D uGAlbedo; // RGBA8: albedo * tint
+uniform sampler2D uGNormal; // RG16F: octahedral world-space normal
+uniform sampler2D uGORM;    // RGBA8: ao, roughness, metallic
+uniform sampler2D uGDepth;  // DEPTH24
+
+vec2 octWrap(vec2 v) {
+  return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n) {
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  return n.z >= 0.0 ? n.xy : octWrap(n.xy);
+}
+
+vec3 decodeNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if(n.z < 0.0)
+    n.xy = octWrap(n.xy);
+  return normalize(n);
+}
+
+vec3 reconstructWorldPos(vec2 uv, float depth) {
+  vec4 clip = vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+  vec4 world = uInverseViewProjection * clip;
+  return world.xyz / world.w;
+}
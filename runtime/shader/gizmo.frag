@@ -2,11 +2,11 @@
 out vec4 FragColor;
 
 uniform sampler2D uTexture;
-uniform vec3 uTint;
 
 in vec2 TexCoords;
+flat in vec3 vTint;
 
 void main() {
     vec4 texColor = texture(uTexture, TexCoords);
-    FragColor = vec4(texColor.rgb * uTint, texColor.a);
+    FragColor = vec4(texColor.rgb * vTint, texColor.a);
 }
@@ -3,15 +3,14 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+#include "object.glsl"
 
 out vec2 TexCoords;
+flat out vec3 vTint;
 
 void main() {
-    mat4 uMVP = uProjection * uView * uModel;
-
-    gl_Position = uMVP * vec4(aPos, 1.0);
+    Object object = loadObject();
+    gl_Position = uViewProjection * object.model * vec4(aPos, 1.0);
     TexCoords = aTexCoord;
-}
\ No newline at end of file
+    vTint = object.tint.rgb;
+}
@@ -0,0 +1,34 @@
+// Image Based Lighting (must match the SH basis in IBL.cpp)
+#include "pbr.glsl"
+
+uniform samplerCube uSpecularMap;
+uniform sampler2D uBRDFLut;
+
+uniform vec3 uIrradianceSH[9]; // Cosine convolved, divided by pi
+uniform float uSpecularMips;
+
+vec3 irradianceSH(vec3 n) {
+  return uIrradianceSH[0] * 0.282095 +
+    uIrradianceSH[1] * (0.488603 * n.y) +
+    uIrradianceSH[2] * (0.488603 * n.z) +
+    uIrradianceSH[3] * (0.488603 * n.x) +
+    uIrradianceSH[4] * (1.092548 * n.x * n.y) +
+    uIrradianceSH[5] * (1.092548 * n.y * n.z) +
+    uIrradianceSH[6] * (0.315392 * (3.0 * n.z * n.z - 1.0)) +
+    uIrradianceSH[7] * (1.092548 * n.x * n.z) +
+    uIrradianceSH[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+}
+
+vec3 ambientIBL(vec3 N, vec3 V, vec3 albedo, vec3 F0, float roughness, float metallic, float ao) {
+  float NdotV = max(dot(N, V), 0.0);
+  vec3 F = FresnelSchlickRoughness(NdotV, F0, roughness);
+  vec3 kD = (1.0 - F) * (1.0 - metallic);
+  vec3 diffuse = max(irradianceSH(N), vec3(0.0)) * albedo;
+
+  vec3 R = reflect(-V, N);
+  vec3 prefiltered = textureLod(uSpecularMap, R, roughness * (uSpecularMips - 1.0)).rgb;
+  vec2 brdf = texture(uBRDFLut, vec2(NdotV, roughness)).rg;
+  vec3 specular = prefiltered * (F * brdf.x + brdf.y);
+
+  return (kD * diffuse + specular) * ao;
+}
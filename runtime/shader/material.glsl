@@ -0,0 +1,69 @@
+// Material textures, virtual texturing (must match PREPATH_VT_* in VirtualTexture.h)
+// NORMAL_MAP and ORM_MAPS come from the shader variant (PREPATH_SHADER_* in Shader.h), without them the
+// generateMaterial defaults are used as constants and the maps are never sampled.
+#include "uniforms.glsl"
+
+uniform sampler2D uAlbedoMap;
+uniform sampler2D uNormalMap;
+uniform sampler2D uRoughnessMap;
+uniform sampler2D uMetallicMap;
+uniform sampler2D uAOMap;
+uniform sampler2D uPhysicalCache;
+flat in int vVirtualMask; // Bit per material slot that holds a page table instead of texels
+
+const float VT_PAGE_SIZE = 128.0;
+const float VT_PAGE_BORDER = 4.0;
+const float VT_TILE_SIZE = VT_PAGE_SIZE + 2.0 * VT_PAGE_BORDER;
+
+const int SLOT_ALBEDO = 0;
+const int SLOT_NORMAL = 1;
+const int SLOT_ROUGHNESS = 2;
+const int SLOT_METALLIC = 3;
+const int SLOT_AO = 4;
+
+vec4 sampleVirtual(sampler2D pageTable, vec2 uv) {
+  vec2 texel = uv * vec2(textureSize(pageTable, 0)) * VT_PAGE_SIZE;
+  vec2 dx = dFdx(texel);
+  vec2 dy = dFdy(texel);
+  float lod = max(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0);
+
+  // Page table entry: tile x, tile y, resident mip, valid
+  vec2 wrapped = fract(uv);
+  vec4 entry = floor(textureLod(pageTable, wrapped, floor(lod)) * 255.0 + 0.5);
+  if(entry.a < 1.0)
+    return vec4(0.5);
+
+  vec2 pages = vec2(textureSize(pageTable, int(entry.b)));
+  vec2 inPage = fract(wrapped * pages) * VT_PAGE_SIZE;
+  vec2 physical = entry.rg * VT_TILE_SIZE + VT_PAGE_BORDER + inPage;
+  return textureLod(uPhysicalCache, physical / vec2(textureSize(uPhysicalCache, 0)), 0.0);
+}
+
+vec4 sampleMaterial(sampler2D map, int slot, vec2 uv) {
+  if((vVirtualMask & (1 << slot)) != 0)
+    return sampleVirtual(map, uv);
+  return texture(map, uv);
+}
+
+// World space normal, the interpolated vertex normal without a normal map
+vec3 sampleNormal(mat3 tbn, vec2 uv) {
+#ifdef NORMAL_MAP
+  vec3 tangentNormal = sampleMaterial(uNormalMap, SLOT_NORMAL, uv).rgb;
+  tangentNormal = tangentNormal * 2.0 - 1.0; // [0,1] → [-1,1]
+  return normalize(tbn * tangentNormal);
+#else
+  return normalize(tbn[2]);
+#endif
+}
+
+// Roughness, metallic, AO. The single channel placeholders read 0 from .g and .b, so without the maps
+// the surface is smooth, dielectric and unoccluded as when they were sampled.
+vec3 sampleORM(vec2 uv) {
+#ifdef ORM_MAPS
+  return vec3(sampleMaterial(uRoughnessMap, SLOT_ROUGHNESS, uv).g,
+              sampleMaterial(uMetallicMap, SLOT_METALLIC, uv).b,
+              sampleMaterial(uAOMap, SLOT_AO, uv).r);
+#else
+  return vec3(0.0, 0.0, 1.0);
+#endif
+}
@@ -0,0 +1,43 @@
+// Per-draw object data (must match ObjectUniforms in UniformBuffer.h)
+// Single draws read the ObjectBlock. Indirect and instanced draws fetch their entry from uObjectData
+// through aDrawID, a per-instance attribute that the command's base instance offsets, plus uObjectBase.
+#include "uniforms.glsl"
+
+const int OBJECT_TEXELS = 10;
+uniform bool uUseObjectData;
+uniform int uObjectBase;             // First entry of an instanced draw
+uniform isamplerBuffer uObjectData; // RGBA32I so the float bits pass through unconverted
+layout(location = 6) in int aDrawID;
+int gObjectInstance = 0; // Instances sharing one entry subtract their own index, see pointlight_face.vert
+
+struct Object {
+  mat4 model;
+  mat4 normalMatrix;
+  vec4 tint;
+  int virtualMask;
+  int faceMask;
+};
+
+vec4 fetchObject(int texel) {
+  return intBitsToFloat(texelFetch(uObjectData, (uObjectBase + aDrawID - gObjectInstance) * OBJECT_TEXELS + texel));
+}
+
+Object loadObject() {
+  Object object;
+  if(!uUseObjectData) {
+    object.model = uModel;
+    object.normalMatrix = uNormalMatrix;
+    object.tint = uTint;
+    object.virtualMask = uVirtualMask;
+    object.faceMask = uFaceMask;
+    return object;
+  }
+
+  object.model = mat4(fetchObject(0), fetchObject(1), fetchObject(2), fetchObject(3));
+  object.normalMatrix = mat4(fetchObject(4), fetchObject(5), fetchObject(6), fetchObject(7));
+  object.tint = fetchObject(8);
+  ivec4 masks = texelFetch(uObjectData, (uObjectBase + aDrawID - gObjectInstance) * OBJECT_TEXELS + 9);
+  object.virtualMask = masks.x;
+  object.faceMask = masks.y;
+  return object;
+}
@@ -0,0 +1,56 @@
+// PBR helper functions shared by the forward and deferred shaders
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+  float a = roughness * roughness;
+  float a2 = a * a;
+  float NdotH = max(dot(N, H), 0.0);
+  float NdotH2 = NdotH * NdotH;
+
+  float num = a2;
+  float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+  denom = 3.14159 * denom * denom;
+
+  return num / denom;
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+  float r = (roughness + 1.0);
+  float k = (r * r) / 8.0;
+
+  float num = NdotV;
+  float denom = NdotV * (1.0 - k) + k;
+
+  return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+  float NdotV = max(dot(N, V), 0.0);
+  float NdotL = max(dot(N, L), 0.0);
+  float ggx2 = GeometrySchlickGGX(NdotV, roughness);
+  float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+  return ggx1 * ggx2;
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0) {
+  return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 FresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
+  return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// Cook-Torrance diffuse + specular for one light, already multiplied by N.L
+vec3 CookTorrance(vec3 N, vec3 V, vec3 L, vec3 albedo, vec3 F0, float roughness, float metallic) {
+  vec3 H = normalize(V + L);
+  float NdotL = max(dot(N, L), 0.0);
+  vec3 F = FresnelSchlick(max(dot(H, V), 0.0), F0);
+  vec3 specular = DistributionGGX(N, H, roughness) * GeometrySmith(N, V, L, roughness) * F /
+    (4.0 * max(dot(N, V), 0.0) * NdotL + 0.001);
+  vec3 kD = (1.0 - F) * (1.0 - metallic);
+  return (kD * albedo / 3.14159 + specular) * NdotL;
+}
+
+// Inverse square falloff windowed to reach zero at the light range
+float PointLightAttenuation(float distance, float range) {
+  float window = clamp(1.0 - pow(distance / range, 4.0), 0.0, 1.0);
+  return window * window / (distance * distance + 1.0);
+}
@@ -1,11 +1,10 @@
 #version 330 core
 in vec4 FragPos;
 
-uniform vec3 uCameraPos;
-uniform float uRange;
+#include "uniforms.glsl"
 
 void main() {
-    float lightDistance = length(FragPos.xyz - uCameraPos);
+    float lightDistance = length(FragPos.xyz - uPassEye);
 
-    gl_FragDepth = clamp(lightDistance / uRange, 0.0, 1.0);
+    gl_FragDepth = clamp(lightDistance / uPassRange, 0.0, 1.0);
 }
\ No newline at end of file
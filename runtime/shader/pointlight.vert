@@ -1,10 +1,13 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
 
-uniform mat4 uModel;
+#include "object.glsl"
 
 out vec4 WorldPos;
+flat out int vFaceMask;
 
 void main() {
-    WorldPos = uModel * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    Object object = loadObject();
+    WorldPos = object.model * vec4(aPos, 1.0);
+    vFaceMask = object.faceMask;
+}
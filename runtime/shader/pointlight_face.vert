@@ -0,0 +1,42 @@
+#version 330 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_viewport_index : enable
+layout(location = 0) in vec3 aPos;
+
+#include "object.glsl"
+
+// Point shadow faces as instances instead of geometry shader amplification
+uniform int uInstanceFaces; // 0: instance n draws the n-th face in the mask, 6: six instances per object
+uniform bool uLayered;      // Route the face to its viewport, otherwise the pass draws a single face
+
+out vec4 FragPos;
+
+void main() {
+  int face = 0;
+  if(uInstanceFaces == 6) {
+    face = gl_InstanceID % 6;
+    gObjectInstance = gl_InstanceID - gl_InstanceID / 6;
+  } else {
+    gObjectInstance = gl_InstanceID;
+  }
+
+  Object object = loadObject();
+  if(uInstanceFaces == 6) {
+    if((object.faceMask & (1 << face)) == 0) {
+      gl_Position = vec4(2.0, 2.0, 2.0, 1.0); // Outside the clip volume, the whole triangle is dropped
+      return;
+    }
+  } else {
+    for(int remaining = gl_InstanceID; face < 6; ++face) {
+      if((object.faceMask & (1 << face)) != 0 && remaining-- == 0)
+        break;
+    }
+  }
+
+  FragPos = object.model * vec4(aPos, 1.0);
+  gl_Position = uShadowMatrices[face] * FragPos;
+#if defined(GL_ARB_shader_viewport_layer_array) || defined(GL_AMD_vertex_shader_viewport_index)
+  if(uLayered)
+    gl_ViewportIndex = face;
+#endif
+}
\ No newline at end of file
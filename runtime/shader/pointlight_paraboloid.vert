@@ -0,0 +1,25 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+#include "object.glsl"
+
+// Dual-paraboloid point shadow, one hemisphere per pass (must match PointShadow in pointshadow.glsl).
+// Face 0 looks down +Z, face 1 down -Z turned around Y, the pass culls each object to one of them.
+out vec4 FragPos;
+out float gl_ClipDistance[1];
+
+void main() {
+  Object object = loadObject();
+  FragPos = object.model * vec4(aPos, 1.0);
+
+  vec3 toVertex = FragPos.xyz - uPassEye;
+  float flip = (object.faceMask & 2) != 0 ? -1.0 : 1.0;
+  vec3 local = vec3(toVertex.x * flip, toVertex.y, toVertex.z * flip);
+  float len = length(local);
+  vec3 dir = local / max(len, 1e-5);
+
+  // Depth only orders the fragments, pointlight.frag writes the real distance
+  gl_Position = vec4(dir.xy / (1.0 + dir.z), len / uPassRange * 2.0 - 1.0, 1.0);
+  // Reaches a little past the seam so triangles crossing it still cover both edges
+  gl_ClipDistance[0] = dir.z + 0.1;
+}
\ No newline at end of file
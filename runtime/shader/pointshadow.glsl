@@ -0,0 +1,53 @@
+// Point light shadows from the shared atlas (must match ShadowAtlas and the face matrices in Renderer)
+uniform bool uPointShadows;
+uniform sampler2D uPointShadowAtlas;   // Distance to the light / range per tile
+uniform samplerBuffer uPointShadowFaces; // 6 texels per light: tile uv offset, uv size (0 = unshadowed), paraboloid flag
+
+const float POINT_SHADOW_BIAS = 0.01;
+// glm::lookAt directions and up vectors of the six faces
+const vec3 FACE_FORWARD[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 FACE_UP[6] = vec3[](vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0));
+
+// 1 = fully shadowed, like ShadowCalculationPCF
+float PointShadow(int light, vec3 worldPos, vec3 lightPos, float range) {
+  if(!uPointShadows)
+    return 0.0;
+
+  vec3 toFragment = worldPos - lightPos;
+  vec3 axis = abs(toFragment);
+  int face = axis.x >= axis.y && axis.x >= axis.z ? (toFragment.x > 0.0 ? 0 : 1) : (axis.y >= axis.z ? (toFragment.y > 0.0 ? 2 : 3) : (toFragment.z > 0.0 ? 4 : 5));
+  vec4 tile = texelFetch(uPointShadowFaces, light * 6 + face);
+
+  vec2 ndc;
+  if(tile.w > 0.5) {
+    // Dual-paraboloid light, the same projection as pointlight_paraboloid.vert
+    int hemisphere = toFragment.z >= 0.0 ? 0 : 1;
+    tile = texelFetch(uPointShadowFaces, light * 6 + hemisphere);
+    float flip = hemisphere == 0 ? 1.0 : -1.0;
+    vec3 dir = normalize(vec3(toFragment.x * flip, toFragment.y, toFragment.z * flip));
+    ndc = dir.xy / (1.0 + dir.z);
+  } else {
+    // Same projection as the 90 degree face matrix
+    vec3 forward = FACE_FORWARD[face];
+    vec3 side = normalize(cross(forward, FACE_UP[face]));
+    vec3 up = cross(side, forward);
+    ndc = vec2(dot(side, toFragment), dot(up, toFragment)) / dot(forward, toFragment);
+  }
+  if(tile.z <= 0.0)
+    return 0.0; // No casters in this face, or not rendered yet
+  vec2 uv = tile.xy + (ndc * 0.5 + 0.5) * tile.z;
+
+  // 2x2 PCF kept inside the tile so neighbouring faces never bleed in
+  float currentDepth = length(toFragment) / range - POINT_SHADOW_BIAS;
+  vec2 texelSize = 1.0 / vec2(textureSize(uPointShadowAtlas, 0));
+  vec2 tileMin = tile.xy + texelSize * 0.5;
+  vec2 tileMax = tile.xy + tile.z - texelSize * 0.5;
+  float shadow = 0.0;
+  for(int x = 0; x < 2; ++x) {
+    for(int y = 0; y < 2; ++y) {
+      vec2 sampleUV = clamp(uv + (vec2(x, y) - 0.5) * texelSize, tileMin, tileMax);
+      shadow += currentDepth > texture(uPointShadowAtlas, sampleUV).r ? 1.0 : 0.0;
+    }
+  }
+  return shadow / 4.0;
+}
\ No newline at end of file
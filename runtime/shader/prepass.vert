@@ -0,0 +1,12 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+#include "object.glsl"
+
+// Must compute gl_Position exactly like default.vert, the forward pass tests against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main() {
+    vec4 worldPos = loadObject().model * vec4(aPos, 1.0);
+    gl_Position = uPassViewProjection * worldPos;
+}
@@ -0,0 +1,47 @@
+// Directional light shadows
+#include "uniforms.glsl"
+
+// Cascaded shadow maps (must match PREPATH_CSM_CASCADES in Renderer.h)
+const int CASCADE_COUNT = 4;
+uniform sampler2DArray uDepthMap;
+uniform mat4 uCascadeMatrices[CASCADE_COUNT];
+uniform float uCascadeSplits[CASCADE_COUNT]; // View-space far distance per cascade
+
+int selectCascade(vec3 worldPos) {
+  float depth = -(uView * vec4(worldPos, 1.0)).z;
+  for(int i = 0; i < CASCADE_COUNT; ++i) {
+    if(depth < uCascadeSplits[i])
+      return i;
+  }
+  return CASCADE_COUNT;
+}
+
+// SKY_LIGHT is compiled into the variant (PREPATH_SHADER_SKY_LIGHT in Shader.h)
+float ShadowCalculationPCF(vec3 worldPos) {
+#ifdef SKY_LIGHT
+  int cascade = selectCascade(worldPos);
+  if(cascade >= CASCADE_COUNT)
+    return 0.0; // Beyond the shadow distance
+
+  vec4 fragPosLightSpace = uCascadeMatrices[cascade] * vec4(worldPos, 1.0);
+  vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+  projCoords = projCoords * 0.5 + 0.5;
+  if(projCoords.z > 1.0)
+    return 0.0;
+
+  float currentDepth = projCoords.z;
+  float bias = 0.005; // Simple fixed bias
+
+  float shadow = 0.0;
+  vec2 texelSize = 1.0 / vec2(textureSize(uDepthMap, 0).xy);
+  for(int x = -1; x <= 1; ++x) {
+    for(int y = -1; y <= 1; ++y) {
+      float pcfDepth = texture(uDepthMap, vec3(projCoords.xy + vec2(x, y) * texelSize, float(cascade))).r;
+      shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
+    }
+  }
+  return shadow / 9.0;
+#else
+  return 1.0; // SHADOW EVERYWHERE
+#endif
+}
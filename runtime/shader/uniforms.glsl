@@ -0,0 +1,26 @@
+// Shared std140 blocks (must match UniformBuffer.h), bound by name in Shader
+layout(std140) uniform FrameBlock {
+  mat4 uView;
+  mat4 uProjection;
+  mat4 uViewProjection;
+  mat4 uInverseViewProjection;
+  vec3 uCameraPos;
+  vec3 uLightDir;
+  vec2 uScreenSize;
+};
+
+layout(std140) uniform PassBlock {
+  mat4 uPassViewProjection; // Camera, cascade or unused for cubemap passes
+  mat4 uShadowMatrices[6];  // Cubemap face view-projections of point shadow passes
+  vec3 uPassEye;            // Camera or light position
+  float uPassRange;         // Point light range
+  int uDebugTexture;        // 0 = normal render, >0 = debug view
+};
+
+layout(std140) uniform ObjectBlock {
+  mat4 uModel;
+  mat4 uNormalMatrix; // mat3 padded to columns of vec4
+  vec4 uTint;
+  int uVirtualMask;   // Bit per material slot that holds a page table instead of texels
+  int uFaceMask;      // Bit per cubemap face the mesh bounds touch
+};